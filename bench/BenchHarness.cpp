@@ -0,0 +1,138 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "BenchHarness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace bench {
+
+std::vector<Benchmark>& registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+void add(Benchmark benchmark) {
+    registry().push_back(std::move(benchmark));
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result measure(const Benchmark& benchmark, double minSeconds) {
+    // Warm caches and lazy state, then grow the iteration count until a batch lasts long enough
+    benchmark.run();
+    int64_t iterations = 1;
+    double real = 0.0;
+    double cpu = 0.0;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        std::clock_t cpuStart = std::clock();
+        for (int64_t i = 0; i < iterations; ++i) {
+            benchmark.run();
+        }
+        real = secondsSince(start);
+        cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        if (real >= minSeconds || iterations >= (int64_t{1} << 40)) {
+            break;
+        }
+        // Aim a little past the target, never more than 10x per step
+        double scale = real > 0.0 ? minSeconds * 1.4 / real : 10.0;
+        iterations = static_cast<int64_t>(iterations * std::min(std::max(scale, 2.0), 10.0));
+    }
+
+    Result result;
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.realNs = real * 1e9 / iterations;
+    result.cpuNs = cpu * 1e9 / iterations;
+    if (benchmark.itemsPerIteration > 0) {
+        result.itemsPerSecond = benchmark.itemsPerIteration * iterations / real;
+    }
+    if (benchmark.framesPerIteration > 0 && benchmark.sampleRate > 0.0) {
+        result.realtimeFactor = benchmark.framesPerIteration / benchmark.sampleRate * 1e9 / result.realNs;
+        result.voicesPerCore = benchmark.voices * result.realtimeFactor;
+    }
+    return result;
+}
+
+std::vector<Result> runAll(const Options& options) {
+    std::vector<Result> results;
+    std::cout << std::left << std::setw(48) << "Benchmark" << std::right << std::setw(14) << "Time (ns)"
+              << std::setw(14) << "CPU (ns)" << std::setw(14) << "Iterations" << std::setw(14) << "items/s"
+              << std::setw(12) << "x realtime" << std::setw(14) << "voices/core" << std::endl;
+    for (const Benchmark& benchmark : registry()) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        Result result = measure(benchmark, options.minSeconds);
+        std::cout << std::left << std::setw(48) << result.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << result.realNs << std::setw(14) << result.cpuNs << std::setw(14)
+                  << result.iterations << std::setprecision(0) << std::setw(14) << result.itemsPerSecond
+                  << std::setprecision(1) << std::setw(12) << result.realtimeFactor << std::setprecision(0)
+                  << std::setw(14) << result.voicesPerCore << std::endl;
+        results.push_back(result);
+    }
+    return results;
+}
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    file << "{\n  \"context\": {\n"
+         << "    \"date\": \"" << date << "\",\n"
+         << "    \"executable\": \"synth_bench\",\n"
+         << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+#ifdef NDEBUG
+         << "    \"library_build_type\": \"release\"\n"
+#else
+         << "    \"library_build_type\": \"debug\"\n"
+#endif
+         << "  },\n  \"benchmarks\": [";
+    file << std::setprecision(10);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        file << (i == 0 ? "\n" : ",\n")
+             << "    {\n"
+             << "      \"name\": \"" << jsonEscape(result.name) << "\",\n"
+             << "      \"run_name\": \"" << jsonEscape(result.name) << "\",\n"
+             << "      \"run_type\": \"iteration\",\n"
+             << "      \"iterations\": " << result.iterations << ",\n"
+             << "      \"real_time\": " << result.realNs << ",\n"
+             << "      \"cpu_time\": " << result.cpuNs << ",\n"
+             << "      \"time_unit\": \"ns\",\n"
+             << "      \"items_per_second\": " << result.itemsPerSecond << ",\n"
+             << "      \"realtime_factor\": " << result.realtimeFactor << ",\n"
+             << "      \"voices_per_core\": " << result.voicesPerCore << "\n"
+             << "    }";
+    }
+    file << "\n  ]\n}\n";
+    return true;
+}
+
+}
@@ -0,0 +1,72 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// Minimal microbenchmark runner in the spirit of Google Benchmark: each benchmark is a named
+// function run for a calibrated number of iterations, and results can be written in Google
+// Benchmark's JSON layout so its compare tooling and our dashboards read them unchanged.
+
+#ifndef BENCHHARNESS_H
+#define BENCHHARNESS_H
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Keeps the compiler from discarding a computation whose result is otherwise unused
+template <typename T>
+inline void doNotOptimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast<const volatile char*>(&value);
+#endif
+}
+
+struct Benchmark {
+    std::string name;
+    // Runs one iteration
+    std::function<void()> run;
+    // Items (audio frames, voice-frames, ...) processed per iteration, for items_per_second
+    int64_t itemsPerIteration = 0;
+    // Audio frames per iteration at sampleRate, to report the real-time factor; 0 when not audio
+    int64_t framesPerIteration = 0;
+    double sampleRate = 0.0;
+    // Voices rendered per iteration, to report how many one core sustains in real time; 0 when not voices
+    int voices = 0;
+};
+
+struct Result {
+    std::string name;
+    int64_t iterations = 0;
+    double realNs = 0.0;   // per iteration
+    double cpuNs = 0.0;    // per iteration
+    double itemsPerSecond = 0.0;
+    double realtimeFactor = 0.0;
+    double voicesPerCore = 0.0;
+};
+
+struct Options {
+    std::string filter;          // substring of the benchmark names to run, empty = all
+    double minSeconds = 0.2;     // measured time per benchmark
+    std::string jsonPath;        // write Google Benchmark JSON here when not empty
+};
+
+std::vector<Benchmark>& registry();
+
+void add(Benchmark benchmark);
+
+std::vector<Result> runAll(const Options& options);
+
+bool writeJson(const std::string& path, const std::vector<Result>& results);
+
+}
+
+#endif //BENCHHARNESS_H
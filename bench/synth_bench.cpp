@@ -0,0 +1,674 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// DSP microbenchmarks: every kernel of the voice chain in isolation, then the whole engine.
+//   synth_bench [--filter <substring>] [--min-time <seconds>] [--json <file>]
+// The JSON follows Google Benchmark's layout, e.g. for tools/compare.py from that project.
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../include/audio/AudioEngine.h"
+#include "../include/audio/DspArena.h"
+#include "../include/audio/Envelope.h"
+#include "../include/audio/Filter.h"
+#include "../include/audio/FmBank.h"
+#include "../include/audio/Lfo.h"
+#include "../include/audio/ModMatrix.h"
+#include "../include/audio/OfflineRenderer.h"
+#include "../include/audio/Oscillator.h"
+#include "../include/audio/Pitch.h"
+#include "../include/audio/SampleData.h"
+#include "../include/audio/UnisonOscillator.h"
+#include "../include/audio/VoiceKernels.h"
+#include "BenchHarness.h"
+
+namespace {
+
+constexpr int BENCH_SAMPLE_RATE = 48000;
+constexpr int KERNEL_BLOCK = 256;
+
+// Benchmarks own their state through shared_ptr captures, the registry outlives main's scope
+struct StereoBuffer {
+    explicit StereoBuffer(int frames, float value = 0.0f) : samples(frames * 2, value) {}
+    float* data() { return samples.data(); }
+    std::vector<float> samples;
+};
+
+bench::Benchmark kernel(std::string name, std::function<void()> run) {
+    bench::Benchmark benchmark;
+    benchmark.name = std::move(name);
+    benchmark.run = std::move(run);
+    benchmark.itemsPerIteration = KERNEL_BLOCK;
+    benchmark.framesPerIteration = KERNEL_BLOCK;
+    benchmark.sampleRate = BENCH_SAMPLE_RATE;
+    return benchmark;
+}
+
+void registerOscillators() {
+    const std::pair<const char*, WaveformType> waveforms[] = {
+        {"triangle", WaveformType::TRIANGLE}, {"saw", WaveformType::SAW}, {"noise", WaveformType::NOISE}};
+    for (const auto& [name, waveform] : waveforms) {
+        auto oscillator = std::make_shared<Oscillator>();
+        auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+        oscillator->prepare(BENCH_SAMPLE_RATE);
+        oscillator->setSeed(1);
+        WaveformType type = waveform;
+        bench::add(kernel(std::string("Oscillator/") + name + "/block:256", [=] {
+            oscillator->generateBuffer(buffer->data(), KERNEL_BLOCK, type, 440.0f);
+            bench::doNotOptimize(buffer->samples[0]);
+        }));
+    }
+}
+
+// Unison saw with N copies in SIMD lanes, against N scalar oscillators summed. Items are copy-samples,
+// so items/s is the throughput per unison voice.
+void registerUnison() {
+    for (int copies : {2, 4, 8, 16}) {
+        auto unison = std::make_shared<UnisonOscillator>();
+        auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+        unison->prepare(BENCH_SAMPLE_RATE);
+        unison->setShape(copies, 0.15f, 0.5f);
+        bench::Benchmark benchmark = kernel("Unison/saw/copies:" + std::to_string(copies), [=] {
+            unison->generateBuffer(buffer->data(), KERNEL_BLOCK, WaveformType::SAW, 110.0f, 110.0f);
+            bench::doNotOptimize(buffer->samples[0]);
+        });
+        benchmark.itemsPerIteration = static_cast<int64_t>(KERNEL_BLOCK) * copies;
+        bench::add(benchmark);
+    }
+
+    constexpr int NAIVE_COPIES = 16;
+    auto oscillators = std::make_shared<std::vector<Oscillator>>(NAIVE_COPIES);
+    auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+    auto mix = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+    for (Oscillator& oscillator : *oscillators) {
+        oscillator.prepare(BENCH_SAMPLE_RATE);
+    }
+    bench::Benchmark benchmark = kernel("Unison/saw/scalar_copies:16", [=] {
+        std::fill(mix->samples.begin(), mix->samples.end(), 0.0f);
+        for (int k = 0; k < NAIVE_COPIES; ++k) {
+            float frequency = 110.0f * std::exp2(0.15f * (2.0f * k / (NAIVE_COPIES - 1) - 1.0f) / 12.0f);
+            (*oscillators)[k].generateBuffer(buffer->data(), KERNEL_BLOCK, WaveformType::SAW, frequency);
+            for (size_t s = 0; s < mix->samples.size(); ++s) {
+                mix->samples[s] += buffer->samples[s];
+            }
+        }
+        bench::doNotOptimize(mix->samples[0]);
+    });
+    benchmark.itemsPerIteration = static_cast<int64_t>(KERNEL_BLOCK) * NAIVE_COPIES;
+    bench::add(benchmark);
+}
+
+// The voice's oscillator stage for a few patch configurations: the kernel compiled for the combination
+// against the generic path (one generateBuffer per enabled oscillator with its waveform switch, then a sum)
+void registerVoiceKernels() {
+    struct Configuration {
+        const char* name;
+        bool enabled[3];
+        WaveformType waveforms[3];
+    };
+    const Configuration configurations[] = {
+        {"saw", {true, false, false}, {WaveformType::SAW, WaveformType::SAW, WaveformType::SAW}},
+        {"triangle_saw", {true, true, false}, {WaveformType::TRIANGLE, WaveformType::SAW, WaveformType::SAW}},
+        {"triangle_saw_saw", {true, true, true}, {WaveformType::TRIANGLE, WaveformType::SAW, WaveformType::SAW}},
+    };
+    const float frequencies[3] = {220.0f, 330.0f, 441.0f};
+    for (const Configuration& configuration : configurations) {
+        auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+        auto state = std::make_shared<VoiceKernelState>();
+        for (int i = 0; i < 3; ++i) {
+            state->phases[i] = 0.0f;
+            state->increments[i] = frequencies[i] / BENCH_SAMPLE_RATE;
+            state->incrementSteps[i] = 0.0f;
+        }
+        VoiceKernel voiceKernel = findVoiceKernel(configuration.enabled, configuration.waveforms);
+        bench::add(kernel(std::string("VoiceKernel/specialized/") + configuration.name, [=] {
+            // Steady pitch: the increments stay put between blocks
+            voiceKernel(*state, buffer->data(), KERNEL_BLOCK);
+            bench::doNotOptimize(buffer->samples[0]);
+        }));
+
+        auto oscillators = std::make_shared<std::array<Oscillator, 3>>();
+        auto oscBuffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+        for (Oscillator& oscillator : *oscillators) {
+            oscillator.prepare(BENCH_SAMPLE_RATE);
+        }
+        Configuration generic = configuration;
+        bench::add(kernel(std::string("VoiceKernel/generic/") + configuration.name, [=] {
+            std::fill(buffer->samples.begin(), buffer->samples.end(), 0.0f);
+            for (int i = 0; i < 3; ++i) {
+                if (!generic.enabled[i]) {
+                    continue;
+                }
+                (*oscillators)[i].generateBuffer(oscBuffer->data(), KERNEL_BLOCK, generic.waveforms[i],
+                                                 frequencies[i]);
+                for (size_t s = 0; s < buffer->samples.size(); ++s) {
+                    buffer->samples[s] += oscBuffer->samples[s];
+                }
+            }
+            bench::doNotOptimize(buffer->samples[0]);
+        }));
+    }
+}
+
+// Semitones to Hz, done per oscillator and control block by every voice
+void registerPitch() {
+    auto pitches = std::make_shared<StereoBuffer>(KERNEL_BLOCK / 2);
+    for (int i = 0; i < KERNEL_BLOCK; ++i) {
+        pitches->samples[i] = static_cast<float>(i % 97) * 0.37f - 18.0f;
+    }
+    bench::add(kernel("Pitch/semitonesToFrequency", [=] {
+        float sum = 0.0f;
+        for (float semitones : pitches->samples) {
+            sum += semitonesToFrequency(semitones);
+        }
+        bench::doNotOptimize(sum);
+    }));
+}
+
+void registerEnvelopes() {
+    // Rates this slow leave the envelope in the same state however long the benchmark runs
+    const float forever = 1.0e6f;
+    struct StateSetup {
+        const char* name;
+        float attack;
+        bool on;
+        bool off;
+    };
+    const StateSetup states[] = {
+        {"idle", forever, false, false},
+        {"attack", forever, true, false},
+        {"sustain", 0.0f, true, false},
+        {"release", 0.0f, true, true},
+    };
+    for (const StateSetup& setup : states) {
+        auto envelope = std::make_shared<Envelope>();
+        auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK, 1.0f);
+        envelope->prepare(BENCH_SAMPLE_RATE);
+        envelope->setAttackTime(setup.attack);
+        envelope->setReleaseTime(forever);
+        if (setup.on) {
+            envelope->noteOn();
+            envelope->processBuffer(buffer->data(), 1);
+        }
+        if (setup.off) {
+            envelope->noteOff();
+        }
+        bench::add(kernel(std::string("Envelope/") + setup.name + "/block:256", [=] {
+            envelope->processBuffer(buffer->data(), KERNEL_BLOCK);
+            bench::doNotOptimize(buffer->samples[0]);
+        }));
+    }
+}
+
+void registerFilters() {
+    for (bool lfo : {false, true}) {
+        auto filter = std::make_shared<Filter>();
+        auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+        filter->prepare(BENCH_SAMPLE_RATE);
+        Oscillator source;
+        source.prepare(BENCH_SAMPLE_RATE);
+        source.setSeed(1);
+        source.generateBuffer(buffer->data(), KERNEL_BLOCK, WaveformType::NOISE, 0.0f);
+        // With the LFO, the cutoff glides between control-rate LFO values as in a voice
+        auto modulator = std::make_shared<Lfo>();
+        const float depth = lfo ? 0.5f * FILTER_LFO_DEPTH_HZ : 0.0f;
+        bench::add(kernel(std::string("Filter/") + (lfo ? "lfo" : "static") + "/block:256", [=] {
+            const LfoSettings sine{LfoShape::SINE, 5.0f, false};
+            for (int frame = 0; frame < KERNEL_BLOCK; frame += CONTROL_BLOCK_FRAMES) {
+                float from = 2000.0f + modulator->getValue() * depth;
+                float to = 2000.0f + modulator->advance(sine, CONTROL_BLOCK_FRAMES, BENCH_SAMPLE_RATE) * depth;
+                filter->processBuffer(buffer->data() + frame * 2, CONTROL_BLOCK_FRAMES, from, to, 0.5f);
+            }
+            bench::doNotOptimize(buffer->samples[0]);
+        }));
+    }
+}
+
+// The two loops of AudioEngine::renderBlock around the kernels: oscillator accumulation and output gain
+void registerMixLoops() {
+    auto source = std::make_shared<StereoBuffer>(KERNEL_BLOCK, 0.25f);
+    auto mix = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+    bench::add(kernel("Mix/accumulate/block:256", [=] {
+        for (int i = 0; i < KERNEL_BLOCK * 2; ++i) {
+            mix->samples[i] += source->samples[i];
+        }
+        bench::doNotOptimize(mix->samples[0]);
+    }));
+    bench::add(kernel("Mix/gain/block:256", [=] {
+        float volume = 0.5f;
+        for (int i = 0; i < KERNEL_BLOCK * 2; ++i) {
+            mix->samples[i] = source->samples[i] * volume;
+        }
+        bench::doNotOptimize(mix->samples[0]);
+    }));
+}
+
+// One engine holding N notes, polyphony set to N
+void registerEngine() {
+    for (int voices : {1, 4, 16}) {
+        for (int block : {32, 64, 256, 1024}) {
+            auto params = std::make_shared<SynthetizerConfig>();
+            params->osc1_enabled.store(true);
+            params->osc2_enabled.store(true);
+            params->osc3_enabled.store(true);
+            params->filter_auto_amount.store(0.3f);
+            params->filter_resonance.store(0.5f);
+            params->polyphony.store(voices);
+
+            auto engine = std::make_shared<AudioEngine>(params);
+            engine->prepare(BENCH_SAMPLE_RATE, block);
+            engine->setNoiseSeed(1);
+            for (int v = 0; v < voices; ++v) {
+                engine->noteOn(v);
+            }
+            auto output = std::make_shared<StereoBuffer>(block);
+
+            bench::Benchmark benchmark;
+            benchmark.name = "processAudio/voices:" + std::to_string(voices) + "/block:" + std::to_string(block);
+            benchmark.run = [=] {
+                engine->processAudio(output->data(), block);
+                bench::doNotOptimize(output->samples[0]);
+            };
+            benchmark.itemsPerIteration = static_cast<int64_t>(block) * voices;
+            benchmark.framesPerIteration = block;
+            benchmark.sampleRate = BENCH_SAMPLE_RATE;
+            benchmark.voices = voices;
+            bench::add(std::move(benchmark));
+        }
+    }
+}
+
+// Dense MPE: 16 notes, one per channel, each bent, pressed and moved in timbre several times per block.
+// Compare with processAudio/voices:16 at the same block size for the cost of the expression stream.
+void registerMpe() {
+    const int voices = 16;
+    for (int block : {64, 256}) {
+        for (int messagesPerVoice : {1, 3, 12}) {
+            auto params = std::make_shared<SynthetizerConfig>();
+            params->osc1_enabled.store(true);
+            params->osc2_enabled.store(true);
+            params->osc3_enabled.store(true);
+            params->filter_resonance.store(0.5f);
+            params->polyphony.store(voices);
+            params->bend_range.store(48.0f);
+            params->pressure_to_cutoff.store(2.0f);
+            params->timbre_to_cutoff.store(1.0f);
+
+            auto engine = std::make_shared<AudioEngine>(params);
+            engine->prepare(BENCH_SAMPLE_RATE, block);
+            engine->setNoiseSeed(1);
+            for (int v = 0; v < voices; ++v) {
+                engine->noteOn(v, 1.0f, v);
+            }
+            auto output = std::make_shared<StereoBuffer>(block);
+
+            // Spread over the block in frame order, cycling through bend, pressure and CC74
+            const int eventCount = voices * messagesPerVoice;
+            auto events = std::make_shared<std::vector<MidiEvent>>(eventCount);
+            auto iteration = std::make_shared<int>(0);
+
+            bench::Benchmark benchmark;
+            benchmark.name = "mpe/voices:16/block:" + std::to_string(block) + "/events_per_sec:"
+                           + std::to_string(eventCount * BENCH_SAMPLE_RATE / block);
+            benchmark.run = [=] {
+                // New values every block, so every voice is always gliding
+                int value = (*iteration)++ * 7;
+                for (int e = 0; e < eventCount; ++e) {
+                    MidiEvent& event = (*events)[e];
+                    uint8_t channel = static_cast<uint8_t>(e % voices);
+                    uint8_t level = static_cast<uint8_t>((value + e * 5) & 0x7F);
+                    event.frame = static_cast<uint32_t>(e * block / eventCount);
+                    switch ((e / voices) % 3) {
+                        case 0: event.size = 3; event.data[0] = 0xE0 | channel; event.data[1] = 0; event.data[2] = level; break;
+                        case 1: event.size = 2; event.data[0] = 0xD0 | channel; event.data[1] = level; break;
+                        default: event.size = 3; event.data[0] = 0xB0 | channel; event.data[1] = 74; event.data[2] = level; break;
+                    }
+                }
+                engine->processAudio(output->data(), block, events->data(), events->size());
+                bench::doNotOptimize(output->samples[0]);
+            };
+            benchmark.itemsPerIteration = eventCount;
+            benchmark.framesPerIteration = block;
+            benchmark.sampleRate = BENCH_SAMPLE_RATE;
+            benchmark.voices = voices;
+            bench::add(std::move(benchmark));
+        }
+    }
+}
+
+// One LFO per shape over a block at control rate (items: control-block values), then the engine with
+// LFO 1 on the cutoff of 16 voices, computed once for all of them or once per voice
+void registerLfos() {
+    for (int shape = 0; shape < LFO_SHAPE_COUNT; ++shape) {
+        auto lfo = std::make_shared<Lfo>();
+        LfoSettings settings{static_cast<LfoShape>(shape), 5.0f, false};
+        // "sample & hold" -> "sample_hold"
+        std::string name;
+        for (const char* c = lfoShapeName(settings.shape); *c; ++c) {
+            if (std::isalnum(static_cast<unsigned char>(*c))) {
+                name += *c;
+            } else if (name.back() != '_') {
+                name += '_';
+            }
+        }
+        bench::Benchmark benchmark = kernel("Lfo/" + name + "/block:256", [=] {
+            float sum = 0.0f;
+            for (int frame = 0; frame < KERNEL_BLOCK; frame += CONTROL_BLOCK_FRAMES) {
+                sum += lfo->advance(settings, CONTROL_BLOCK_FRAMES, BENCH_SAMPLE_RATE);
+            }
+            bench::doNotOptimize(sum);
+        });
+        benchmark.itemsPerIteration = KERNEL_BLOCK / CONTROL_BLOCK_FRAMES;
+        bench::add(std::move(benchmark));
+    }
+
+    const int voices = 16;
+    const int block = 256;
+    for (bool perVoice : {false, true}) {
+        auto params = std::make_shared<SynthetizerConfig>();
+        params->osc1_enabled.store(true);
+        params->osc2_enabled.store(true);
+        params->osc3_enabled.store(true);
+        params->filter_resonance.store(0.5f);
+        params->filter_auto_amount.store(0.3f);
+        params->lfo1_per_voice.store(perVoice);
+        params->polyphony.store(voices);
+
+        auto engine = std::make_shared<AudioEngine>(params);
+        engine->prepare(BENCH_SAMPLE_RATE, block);
+        engine->setNoiseSeed(1);
+        for (int v = 0; v < voices; ++v) {
+            engine->noteOn(v);
+        }
+        auto output = std::make_shared<StereoBuffer>(block);
+
+        bench::Benchmark benchmark;
+        benchmark.name = std::string("Lfo/processAudio/voices:16/block:256/") + (perVoice ? "per_voice" : "global");
+        benchmark.run = [=] {
+            engine->processAudio(output->data(), block);
+            bench::doNotOptimize(output->samples[0]);
+        };
+        benchmark.itemsPerIteration = static_cast<int64_t>(block) * voices;
+        benchmark.framesPerIteration = block;
+        benchmark.sampleRate = BENCH_SAMPLE_RATE;
+        benchmark.voices = voices;
+        bench::add(std::move(benchmark));
+    }
+}
+
+// Fills the first slots of the patch's matrix with distinct routings
+void setModSlots(SynthetizerConfig& params, int slots) {
+    const ModSource sources[] = {ModSource::LFO1, ModSource::ENVELOPE, ModSource::VELOCITY, ModSource::LFO2,
+                                 ModSource::PRESSURE, ModSource::TIMBRE, ModSource::MOD_WHEEL, ModSource::BEND};
+    const ModDestination destinations[] = {ModDestination::PITCH, ModDestination::CUTOFF, ModDestination::AMPLITUDE,
+                                           ModDestination::PAN, ModDestination::CUTOFF, ModDestination::RESONANCE,
+                                           ModDestination::PITCH, ModDestination::AMPLITUDE};
+    for (int slot = 0; slot < MOD_SLOTS; ++slot) {
+        params.mod_source[slot].store(slot < slots ? static_cast<int>(sources[slot]) : 0);
+        params.mod_destination[slot].store(slot < slots ? static_cast<int>(destinations[slot]) : 0);
+        params.mod_amount[slot].store(0.25f);
+    }
+}
+
+// The matrix alone (items: slot x voice evaluations), then the engine with 16 voices and N slots in use.
+// slots:0 renders each voice in one call per block, any slot switches to one call per control block.
+void registerModMatrix() {
+    for (int slots : {1, 4, 8}) {
+        auto params = std::make_shared<SynthetizerConfig>();
+        setModSlots(*params, slots);
+        auto matrix = std::make_shared<ModMatrix>();
+        matrix->setRoutings(*params);
+        for (int source = 1; source < MOD_SOURCE_COUNT; ++source) {
+            std::fill_n(matrix->sourceRow(static_cast<ModSource>(source)), MOD_VOICE_LANES, 0.5f);
+        }
+        bench::Benchmark benchmark = kernel("modmatrix/evaluate/slots:" + std::to_string(slots), [=] {
+            matrix->evaluate();
+            bench::doNotOptimize(matrix->getVoice(0).pitch);
+        });
+        benchmark.itemsPerIteration = static_cast<int64_t>(slots) * MAX_VOICES;
+        benchmark.framesPerIteration = CONTROL_BLOCK_FRAMES;
+        bench::add(std::move(benchmark));
+    }
+
+    const int voices = 16;
+    const int block = 256;
+    for (int slots : {0, 1, 4, 8}) {
+        auto params = std::make_shared<SynthetizerConfig>();
+        params->osc1_enabled.store(true);
+        params->osc2_enabled.store(true);
+        params->osc3_enabled.store(true);
+        params->filter_resonance.store(0.5f);
+        params->polyphony.store(voices);
+        setModSlots(*params, slots);
+
+        auto engine = std::make_shared<AudioEngine>(params);
+        engine->prepare(BENCH_SAMPLE_RATE, block);
+        engine->setNoiseSeed(1);
+        for (int v = 0; v < voices; ++v) {
+            engine->noteOn(v);
+        }
+        auto output = std::make_shared<StereoBuffer>(block);
+
+        bench::Benchmark benchmark;
+        benchmark.name = "modmatrix/processAudio/voices:16/block:256/slots:" + std::to_string(slots);
+        benchmark.run = [=] {
+            engine->processAudio(output->data(), block);
+            bench::doNotOptimize(output->samples[0]);
+        };
+        benchmark.itemsPerIteration = static_cast<int64_t>(block) * voices;
+        benchmark.framesPerIteration = block;
+        benchmark.sampleRate = BENCH_SAMPLE_RATE;
+        benchmark.voices = voices;
+        bench::add(std::move(benchmark));
+    }
+}
+
+// FM operators of 64 voices in SIMD lanes for the 2, 4 and 6 operator algorithms (items: operator-samples),
+// a scalar std::sin loop of the 6 operator stack for reference, and the engine with 16 FM voices.
+// voices/core is the real-time voice count of one core.
+// An FM bank and the arena holding its state
+struct FmBankState {
+    DspArena arena;
+    FmBank bank;
+};
+
+void registerFm() {
+    constexpr int voices = 64;
+    const std::pair<const char*, FmAlgorithm> algorithms[] = {
+        {"two_op", FmAlgorithm::TWO_OP}, {"four_op_stack", FmAlgorithm::FOUR_OP_STACK},
+        {"six_op_stack", FmAlgorithm::SIX_OP_STACK}, {"six_op_pairs", FmAlgorithm::SIX_OP_PAIRS}};
+    for (const auto& [name, algorithm] : algorithms) {
+        auto fm = std::make_shared<FmBankState>();
+        auto active = std::make_shared<std::array<bool, voices>>();
+        active->fill(true);
+        fm->arena.beginLayout();
+        fm->bank.allocate(fm->arena, voices, KERNEL_BLOCK);
+        fm->arena.commit();
+        fm->bank.allocate(fm->arena, voices, KERNEL_BLOCK);
+        fm->bank.prepare(BENCH_SAMPLE_RATE);
+        FmSettings settings;
+        settings.algorithm = algorithm;
+        for (int op = 0; op < FM_OPERATORS; ++op) {
+            settings.ratios[op] = static_cast<float>(op + 1);
+            settings.levels[op] = 0.5f;
+        }
+        for (int v = 0; v < voices; ++v) {
+            fm->bank.reset(v);
+            fm->bank.setFrequency(v, 110.0f * std::exp2(v / 12.0f));
+        }
+        bench::Benchmark benchmark = kernel(std::string("Fm/") + name + "/voices:64", [=] {
+            fm->bank.render(settings, KERNEL_BLOCK, active->data());
+            bench::doNotOptimize(fm->bank.getOutput(0)[0]);
+        });
+        benchmark.itemsPerIteration = static_cast<int64_t>(KERNEL_BLOCK) * voices * fmOperatorCount(algorithm);
+        benchmark.voices = voices;
+        bench::add(std::move(benchmark));
+    }
+
+    auto phases = std::make_shared<std::vector<float>>(voices * FM_OPERATORS, 0.0f);
+    auto output = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+    bench::Benchmark scalar = kernel("Fm/six_op_stack/scalar_voices:64", [=] {
+        for (int v = 0; v < voices; ++v) {
+            float* phase = phases->data() + v * FM_OPERATORS;
+            const float increment = 110.0f * std::exp2(v / 12.0f) / BENCH_SAMPLE_RATE;
+            for (int i = 0; i < KERNEL_BLOCK; ++i) {
+                float modulation = 0.0f;
+                for (int op = FM_OPERATORS - 1; op >= 0; --op) {
+                    modulation = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * (phase[op] + modulation));
+                    phase[op] += increment * static_cast<float>(op + 1);
+                    phase[op] -= std::floor(phase[op]);
+                }
+                output->samples[i] = modulation;
+            }
+        }
+        bench::doNotOptimize(output->samples[0]);
+    });
+    scalar.itemsPerIteration = static_cast<int64_t>(KERNEL_BLOCK) * voices * FM_OPERATORS;
+    scalar.voices = voices;
+    bench::add(std::move(scalar));
+
+    const int engineVoices = 16;
+    const int block = 256;
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->fm_algorithm.store(static_cast<int>(FmAlgorithm::SIX_OP_STACK));
+    params->polyphony.store(engineVoices);
+    auto engine = std::make_shared<AudioEngine>(params);
+    engine->prepare(BENCH_SAMPLE_RATE, block);
+    for (int v = 0; v < engineVoices; ++v) {
+        engine->noteOn(v);
+    }
+    auto engineOutput = std::make_shared<StereoBuffer>(block);
+    bench::Benchmark benchmark;
+    benchmark.name = "fm/processAudio/voices:16/block:256/six_op_stack";
+    benchmark.run = [=] {
+        engine->processAudio(engineOutput->data(), block);
+        bench::doNotOptimize(engineOutput->samples[0]);
+    };
+    benchmark.itemsPerIteration = static_cast<int64_t>(block) * engineVoices;
+    benchmark.framesPerIteration = block;
+    benchmark.sampleRate = BENCH_SAMPLE_RATE;
+    benchmark.voices = engineVoices;
+    bench::add(std::move(benchmark));
+}
+
+// Sample playback from memory-mapped files: 64 one-shot voices at the sample's pitch and transposed,
+// for float WAV and 16-bit raw sources. voices/core is the real-time voice count of one core.
+void registerSampler() {
+    const int seconds = 10;
+    const int frames = BENCH_SAMPLE_RATE * seconds;
+    std::vector<float> stereo(frames * 2);
+    std::vector<int16_t> mono(frames);
+    for (int i = 0; i < frames; ++i) {
+        float value = 0.5f * std::sin(2.0 * M_PI * 261.63 * i / BENCH_SAMPLE_RATE);
+        stereo[i * 2] = value;
+        stereo[i * 2 + 1] = -value;
+        mono[i] = static_cast<int16_t>(value * 32767.0f);
+    }
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string wavPath = (directory / "synth_bench_sample.wav").string();
+    const std::string rawPath = (directory / "synth_bench_sample.raw").string();
+    writeWav(wavPath, stereo, BENCH_SAMPLE_RATE);
+    std::ofstream(rawPath, std::ios::binary).write(reinterpret_cast<const char*>(mono.data()), frames * 2);
+
+    RawSampleInfo rawInfo;
+    rawInfo.format = SampleFormat::INT16;
+    rawInfo.sampleRate = BENCH_SAMPLE_RATE;
+    const std::pair<const char*, std::shared_ptr<SampleData>> sources[] = {
+        {"float32_stereo", SampleData::loadWav(wavPath)},
+        {"int16_mono", SampleData::loadRaw(rawPath, rawInfo)},
+    };
+
+    const int voices = 64;
+    for (const auto& [name, sample] : sources) {
+        if (!sample) {
+            continue;
+        }
+        // Whole file resident, this measures interpolation rather than disk reads
+        sample->prefault(seconds);
+        for (float semitones : {0.0f, 7.0f}) {
+            auto oscillators = std::make_shared<std::vector<Oscillator>>(voices);
+            for (Oscillator& oscillator : *oscillators) {
+                oscillator.prepare(BENCH_SAMPLE_RATE);
+                oscillator.setSample(sample.get());
+            }
+            auto buffer = std::make_shared<StereoBuffer>(KERNEL_BLOCK);
+            float frequency = 261.63f * std::pow(2.0f, semitones / 12.0f);
+
+            bench::Benchmark benchmark;
+            benchmark.name = std::string("Sampler/") + name + "/voices:64/transpose:" + std::to_string(int(semitones));
+            // Captures the sample so the mapping outlives the registration scope
+            benchmark.run = [=, keep = sample] {
+                for (Oscillator& oscillator : *oscillators) {
+                    if (!oscillator.isSamplePlaying()) {
+                        oscillator.retrigger();
+                    }
+                    oscillator.generateBuffer(buffer->data(), KERNEL_BLOCK, WaveformType::SAMPLE, frequency);
+                }
+                bench::doNotOptimize(buffer->samples[0]);
+            };
+            benchmark.itemsPerIteration = static_cast<int64_t>(KERNEL_BLOCK) * voices;
+            benchmark.framesPerIteration = KERNEL_BLOCK;
+            benchmark.sampleRate = BENCH_SAMPLE_RATE;
+            benchmark.voices = voices;
+            bench::add(std::move(benchmark));
+        }
+    }
+}
+
+int usage() {
+    std::cerr << "usage: synth_bench [--filter <substring>] [--min-time <seconds>] [--json <file>]" << std::endl;
+    return EXIT_FAILURE;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--filter") {
+            options.filter = argv[i + 1];
+        } else if (arg == "--min-time") {
+            options.minSeconds = std::stod(argv[i + 1]);
+        } else if (arg == "--json") {
+            options.jsonPath = argv[i + 1];
+        } else {
+            return usage();
+        }
+    }
+    if (argc % 2 == 0) {
+        return usage();
+    }
+
+    registerOscillators();
+    registerUnison();
+    registerVoiceKernels();
+    registerPitch();
+    registerEnvelopes();
+    registerFilters();
+    registerLfos();
+    registerMixLoops();
+    registerEngine();
+    registerMpe();
+    registerModMatrix();
+    registerFm();
+    registerSampler();
+
+    std::vector<bench::Result> results = bench::runAll(options);
+    if (!options.jsonPath.empty() && !bench::writeJson(options.jsonPath, results)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
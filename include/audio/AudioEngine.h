@@ -6,45 +6,164 @@
 #include <array>
 #include <algorithm>
 #include <cmath>
-#include <portaudio.h>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
 
-#include "Oscillator.h"
-#include "Envelope.h"
-#include "Filter.h"
+#include "DspArena.h"
+#include "MidiEvent.h"
+#include "MidiFile.h"
+#include "MidiInputQueue.h"
+#include "ModMatrix.h"
 #include "SynthetizerConfig.h"
+#include "Voice.h"
+#include "AudioTap.h"
+#include "FmBank.h"
+#include "LevelMeter.h"
+#include "Lfo.h"
+#include "Oversampler.h"
+#include "SampleData.h"
+#include "SampleStreamer.h"
 
+// MIDI note played as noteNumber 0 (A3 = 220 Hz, the keyboard's first key)
+constexpr int MIDI_NOTE_BASE = 57;
+
+// The synth_core render entry point shared by every audio backend.
+// Drivers only call prepare() while stopped, then processMidi() and processAudio() from their audio thread.
 class AudioEngine {
 
 public:
      AudioEngine(std::shared_ptr<SynthetizerConfig> p);
-    ~AudioEngine();
 
-    void initialize();
-    void shutdown();
+    // Sizes every DSP buffer to maxBlockSize frames, all in one arena, and gives the sample rate to the
+    // DSP objects. Never called from the audio thread, the stream must be stopped.
+    void prepare(int sampleRate, int maxBlockSize);
 
     void processAudio(float* outputBuffer, int numFrames);
-    void noteOn(int noteNumber);
+    // Renders the block in spans between events, each event applied exactly at its frame.
+    // events must be sorted by frame; frames past the block are applied at its end.
+    // The MIDI file player's and live input's events are merged in. Expression messages (bend, pressure,
+    // CC74) only take effect on the control block grid, so dense MPE streams do not split the render.
+    void processAudio(float* outputBuffer, int numFrames, const MidiEvent* events, size_t eventCount);
+    // Handles one raw MIDI message (note on/off, all notes off, pitch bend, channel and key pressure,
+    // CC74 timbre, CC1 mod wheel, reset controllers), applied from the start of the next block. Bend, pressure and
+    // timbre follow the message's channel, so MPE controllers move each note on its own.
+    void processMidi(const uint8_t* data, size_t size);
+    // Plays a MIDI file from the next block on, merged with the other input; set before the stream starts
+    void setMidiPlayer(std::shared_ptr<MidiPlayer> player);
+    // Live MIDI from an input thread, played one block late at its arrival offset; set before the stream starts
+    void setMidiInput(std::shared_ptr<MidiInputQueue> input);
+    // Host transport state, e.g. from JACK, published for tempo-synced modules
+    void setTransportState(bool rolling, float bpm);
+    // Output copy for the UI analyzers, set before the stream starts
+    void setAudioTap(std::shared_ptr<AudioTap> tap);
+    // Output meters, and optionally the loudness thread fed with the output; set before the stream starts
+    void setMeters(std::shared_ptr<OutputMeters> meters, std::shared_ptr<LoudnessMeter> loudness = nullptr);
+
+    // velocity in [0, 1] scales the voice output. Takes a free voice, or once the patch's polyphony
+    // is reached steals the oldest voice, preferring ones already released. The voice starts with
+    // the MIDI channel's current bend, pressure and timbre.
+    void noteOn(int noteNumber, float velocity = 1.0f, int channel = 0);
+    void noteOff(int noteNumber, int channel = 0);
+    // Releases every held note
     void noteOff();
+    // Seeds the noise generators (oscillator i of voice v gets seed + 3v + i) and the random LFO shapes,
+    // renders become reproducible
+    void setNoiseSeed(uint32_t seed);
+    // Sample for the oscillators set to WaveformType::SAMPLE, set before the stream starts.
+    // With a streamer, each oscillator of each voice streams it through its own ring rather than reading the mapping.
+    void setSample(std::shared_ptr<const SampleData> sample, std::shared_ptr<SampleStreamer> streamer = nullptr);
+
+    // Load statistics since prepare(), read once rendering has stopped
+    int getPeakVoices() const { return peakVoices; }
+    // Bytes of DSP buffers, and whether they are locked in RAM
+    size_t getArenaSize() const { return arena.size(); }
+    bool isArenaLocked() const { return arena.isLocked(); }
+    long long getVoiceSteals() const { return voiceSteals; }
 private:
-    // PortAudio
-    PaStream* stream;
+    int sampleRate = DEFAULT_SAMPLE_RATE;
+    int maxBlockSize = 0;
+    int lastNoteNumber = -1;
+    // Every buffer of the engine, its voices, FM operators and oversampler, taken in prepare()
+    DspArena arena;
+
+    std::array<Voice, MAX_VOICES> voices;
+    // Last bend, pressure and timbre per MIDI channel, given to the notes that start on it
+    std::array<VoiceExpression, 16> channelExpression{};
+    // CC1 per MIDI channel in [0, 1], the matrix's MOD_WHEEL source
+    std::array<float, 16> channelModWheel{};
 
-    std::array<Oscillator, 3> oscillators;
-    Envelope envelope;
-    Filter filter;
+    ModMatrix modMatrix;
+    // LFOs shared by all voices (the per-voice ones live in Voice), and the patch's LFO settings of this block
+    std::array<Lfo, NUM_LFOS> globalLfos;
+    std::array<LfoSettings, NUM_LFOS> lfoSettings{};
+    // FM operators of all voices, rendered together before the voices add them to their oscillators
+    FmBank fmBank;
+    FmSettings fmSettings;
+    std::array<bool, MOD_VOICE_LANES> fmActive{};
+    uint64_t noteCounter = 0;
+    int peakVoices = 0;
+    long long voiceSteals = 0;
     std::shared_ptr<SynthetizerConfig> params;
+    // Keeps the mapping alive while the oscillators read from it
+    std::shared_ptr<const SampleData> sample;
+    std::shared_ptr<SampleStreamer> streamer;
+
+    // Sum of the voices, stereo interleaved at the oversampled rate (maxBlockSize * MAX_OVERSAMPLING * 2 samples)
+    std::span<float> mixBuffer;
+    // Voice chain output back at the base rate
+    std::span<float> voiceBuffer;
+
+    int oversampling = 1;
+    Oversampler oversampler;
+
+    std::shared_ptr<AudioTap> audioTap;
+    // Mono samples averaged per tap sample, keeps the tap at or below AUDIO_TAP_MAX_RATE
+    int tapDecimation = 1;
+    int tapCounter = 0;
+    float tapAccumulator = 0.0f;
+    std::span<float> tapBuffer;
 
-    std::array<float, FRAMES_PER_BUFFER * 2> osc1Buffer;
-    std::array<float, FRAMES_PER_BUFFER * 2> osc2Buffer;
-    std::array<float, FRAMES_PER_BUFFER * 2> osc3Buffer;
-    std::array<float, FRAMES_PER_BUFFER * 2> mixBuffer;
+    std::shared_ptr<MidiPlayer> midiPlayer;
+    std::span<MidiEvent> playerEvents;
+    std::shared_ptr<MidiInputQueue> midiInput;
+    std::span<MidiEvent> inputEvents;
+    // Bend, pressure and timbre events waiting for the control block boundary at or after their frame,
+    // counted from the start of the next renderBlock()
+    std::span<MidiEvent> pendingExpression;
+    size_t pendingCount = 0;
 
-    static int audioCallback(const void* inputBuffer, void* outputBuffer,
-                           unsigned long framesPerBuffer,
-                           const PaStreamCallbackTimeInfo* timeInfo,
-                           PaStreamCallbackFlags statusFlags,
-                           void* userData);
+    LevelMeter levelMeter;
+    std::shared_ptr<OutputMeters> meters;
+    std::shared_ptr<LoudnessMeter> loudnessMeter;
 
+    // Takes every buffer from the arena, the same calls in both of prepare()'s passes
+    void allocateState();
+    // Renders any number of frames in chunks of at most maxBlockSize
+    void renderFrames(float* outputBuffer, int numFrames);
+    // Renders at most maxBlockSize frames
+    void renderBlock(float* outputBuffer, int numFrames);
+    // Runs the oscillators, envelope and filter at sampleRate * factor
+    void setOversampling(int factor);
+    // Releases the voices at or above the polyphony limit
+    void limitPolyphony(int polyphony);
+    // Fills the matrix's source rows from the voices and evaluates it, for the control block starting now
+    void evaluateModulation(int numFrames);
+    // Gives each sounding voice's pitch (plus the matrix's, when modulated) to the FM operators and
+    // renders chainFrames of them
+    void renderFm(int chainFrames, bool modulated);
+    // Pitch bend, pressure or timbre: applied on the control block grid rather than at its frame
+    static bool isExpressionEvent(const MidiEvent& event);
+    // Queues an expression event due frame frames into the next renderBlock()
+    void queueExpression(const MidiEvent& event, int frame);
+    // Applies the queued events due at or before frame
+    void applyExpression(int frame);
+    // First control block boundary after frame where a queued event is due, at most numFrames
+    int nextExpressionBoundary(int frame, int numFrames) const;
+    // Sends the channel's expression to the voices playing on it
+    void updateChannelExpression(int channel);
+    void writeTap(const float* outputBuffer, int numFrames);
+    void updateMeters(const float* outputBuffer, int numFrames);
 };
 #endif //AUDIOENGINE_H
\ No newline at end of file
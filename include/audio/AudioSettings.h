@@ -0,0 +1,48 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef AUDIOSETTINGS_H
+#define AUDIOSETTINGS_H
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "SynthetizerConfig.h"
+
+enum class RealtimePolicy { NONE, FIFO, RR };
+
+// Scheduling requested for the audio thread, applied on a best-effort basis
+struct RealtimeOptions {
+    RealtimePolicy policy = RealtimePolicy::NONE;
+    int priority = 70;
+    // CPUs the audio thread may run on, empty = no pinning
+    std::vector<int> cpus;
+    // mlockall() once the DSP memory is allocated, so it is never paged out
+    bool lockMemory = false;
+};
+
+// Stream configuration selected at startup (or when the device changes)
+struct AudioSettings {
+    // Audio driver: "portaudio", "jack" (native client, Linux builds with JACK only)
+    // or "null" (no device, for benchmarks and CI machines)
+    std::string backend = "portaudio";
+    // Null backend only: render blocks back to back instead of on the real-time clock
+    bool freeRun = false;
+
+    int sampleRate = DEFAULT_SAMPLE_RATE;
+    // Block size requested from the host, DSP buffers are sized to this value
+    int framesPerBuffer = DEFAULT_FRAMES_PER_BUFFER;
+
+    // Output device index as listed by --list-devices, -1 = default device of the host API
+    int deviceIndex = -1;
+    // Host API name (e.g. "ALSA", "JACK"), matched case-insensitively, empty = system default
+    std::string hostApi;
+    // Requested output latency in seconds, 0 = the device's low-latency value
+    double suggestedLatency = 0.0;
+
+    RealtimeOptions realtime;
+};
+
+#endif //AUDIOSETTINGS_H
@@ -0,0 +1,26 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef AUDIOTAP_H
+#define AUDIOTAP_H
+#pragma once
+
+#include <atomic>
+
+#include "SpscRing.h"
+#include "SynthetizerConfig.h"
+
+// Mono copy of the engine output for the oscilloscope and spectrum analyzer.
+// Filled by AudioEngine::processAudio, drained by the UI thread.
+struct AudioTap {
+    // About 0.3 s at 48 kHz, the UI drains it every frame
+    SpscRing<float> ring{16384};
+    // Rate of the samples in the ring, after decimation
+    std::atomic<float> sampleRate{static_cast<float>(DEFAULT_SAMPLE_RATE)};
+};
+
+// The tap never runs faster than this, higher engine rates are decimated
+constexpr int AUDIO_TAP_MAX_RATE = 48000;
+
+#endif //AUDIOTAP_H
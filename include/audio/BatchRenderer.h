@@ -0,0 +1,45 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OfflineRenderer.h"
+
+struct BatchJob {
+    std::string patchPath;
+    RenderRequest request;
+    std::string outputPath;
+};
+
+struct BatchResult {
+    bool ok = false;
+    uint64_t hash = 0;
+    double audioSeconds = 0.0;
+};
+
+struct BatchReport {
+    int jobs = 0;
+    int failed = 0;
+    int threads = 0;
+    double audioSeconds = 0.0;
+    double wallSeconds = 0.0;
+};
+
+// Reads a job list, one render per line: "<patch file> <midi note> <velocity 0-127> [note s] [tail s]".
+// Patch paths are relative to the job file, each render goes to its own WAV in outputDir.
+std::vector<BatchJob> loadBatchJobs(const std::string& jobFile, const std::string& outputDir);
+
+// Renders every job on numThreads workers pulling from a shared queue (0 = all cores).
+// Jobs are independent engines with fixed seeds, so the output does not depend on the thread count.
+// Also writes index.txt (file, patch, note, velocity, hash) next to the WAVs.
+BatchReport runBatch(const std::vector<BatchJob>& jobs, const RenderFormat& format, int numThreads,
+                     const std::string& outputDir, std::vector<BatchResult>& results);
+
+#endif //BATCHRENDERER_H
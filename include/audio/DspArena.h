@@ -0,0 +1,60 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef DSPARENA_H
+#define DSPARENA_H
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+// Allocations start on their own cache line, so no two buffers share one
+constexpr size_t DSP_ARENA_ALIGNMENT = 64;
+
+// One block of memory for all the buffers of the DSP objects, taken once in prepare() and handed out
+// in the order it is called, which is the order the render reads them. The owner allocates in two
+// passes over the same calls: the first only adds up the sizes, commit() then maps that much (locked
+// in RAM when allowed, so the audio thread never waits on a page fault there) and the second pass
+// gets the memory. Only for types without a destructor, released as a whole.
+class DspArena {
+public:
+    DspArena() = default;
+    ~DspArena();
+    DspArena(const DspArena&) = delete;
+    DspArena& operator=(const DspArena&) = delete;
+
+    // Frees the memory, the next allocations only count their size
+    void beginLayout();
+    // Maps the size counted since beginLayout(); the next allocations, the same again, get memory
+    void commit();
+
+    // count value-initialized (zeroed) T, empty while counting
+    template <typename T>
+    std::span<T> allocate(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "the arena never runs destructors");
+        T* first = static_cast<T*>(take(count * sizeof(T)));
+        if (!first) {
+            return {};
+        }
+        std::uninitialized_value_construct_n(first, count);
+        return {first, count};
+    }
+
+    size_t size() const { return capacity; }
+    // False when the pages could not be locked (they are still touched once at commit)
+    bool isLocked() const { return lockedPages; }
+
+private:
+    std::byte* memory = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    bool lockedPages = false;
+
+    void* take(size_t bytes);
+    void release();
+};
+
+#endif //DSPARENA_H
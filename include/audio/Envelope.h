@@ -14,6 +14,11 @@ enum class State {
 
 class Envelope {
 public:
+    // Must be called before processing, and again whenever the sample rate changes
+    void prepare(float sampleRate);
+    // Changes the rate without resetting the envelope, for an oversampling switch during a note
+    void setSampleRate(float sampleRate);
+
     void setAttackTime(float attackTime);
     void setDecayTime(float decayTime);
     void setReleaseTime(float releaseTime);
@@ -22,9 +27,12 @@ public:
     void noteOff();
 
     void processBuffer(float* buffer, int numFrames);
+    float getValue() const { return value; }
+    bool isActive() const { return state != State::IDLE; }
 private:
     State state = State::IDLE;
     float value = 0.0f;
+    float sampleRate = DEFAULT_SAMPLE_RATE;
 
     float attackRate = 0.0f;
     float sustainLevel = 1.0f;
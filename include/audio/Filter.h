@@ -6,17 +6,26 @@
 #define FILTER_H
 #pragma once
 
+#include "SynthetizerConfig.h"
+
 class Filter {
 
 
 public:
-    void processBuffer(float* buffer, int numFrames, float baseCutoff,
-                       float autoAmount, float autoFreq, float resonance);
+    // Resets the filter history and forces new coefficients for the given sample rate
+    void prepare(float sampleRate);
+
+    void processBuffer(float* buffer, int numFrames, float cutoff, float resonance);
+    // Same, with the cutoff gliding linearly from startCutoff to endCutoff over the buffer,
+    // e.g. between two control-rate LFO values
+    void processBuffer(float* buffer, int numFrames, float startCutoff, float endCutoff, float resonance);
 private:
     float a0, a1, a2, b1, b2;
     float x1_L = 0.0f, x2_L = 0.0f, y1_L = 0.0f, y2_L = 0.0f;
     float x1_R = 0.0f, x2_R = 0.0f, y1_R = 0.0f, y2_R = 0.0f;
-    float lfoPhase = 0.0f;
+    float lastCutoff = -1.0f;
+    float lastResonance = -1.0f;
+    float sampleRate = DEFAULT_SAMPLE_RATE;
 
     void updateCoefficients(float cutoff, float resonance);
 };
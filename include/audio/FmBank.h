@@ -0,0 +1,82 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef FMBANK_H
+#define FMBANK_H
+#pragma once
+
+#include <array>
+#include <span>
+
+#include "DspArena.h"
+#include "SynthetizerConfig.h"
+
+// How the operators modulate each other, written modulator > carrier with operators numbered from 1.
+// A modulator always has a higher number than the operators it modulates. Saved in patches, new
+// algorithms go at the end.
+enum class FmAlgorithm {
+    OFF,
+    TWO_OP,              // 2>1
+    FOUR_OP_STACK,       // 4>3>2>1
+    FOUR_OP_PAIRS,       // 2>1, 4>3
+    FOUR_OP_BRANCH,      // 2+3+4>1
+    SIX_OP_STACK,        // 6>5>4>3>2>1
+    SIX_OP_TWO_STACKS,   // 3>2>1, 6>5>4
+    SIX_OP_PAIRS,        // 2>1, 4>3, 6>5
+    COUNT
+};
+constexpr int FM_ALGORITHM_COUNT = static_cast<int>(FmAlgorithm::COUNT);
+// Phase deviation in cycles of a modulator at level 1 (about 6.3 radians)
+constexpr float FM_INDEX_CYCLES = 1.0f;
+
+const char* fmAlgorithmName(FmAlgorithm algorithm);
+// Operators the algorithm uses, 0 for OFF
+int fmOperatorCount(FmAlgorithm algorithm);
+
+// The patch's FM settings for one block
+struct FmSettings {
+    FmAlgorithm algorithm = FmAlgorithm::OFF;
+    std::array<float, FM_OPERATORS> ratios{};
+    std::array<float, FM_OPERATORS> levels{};
+};
+
+FmSettings readFmSettings(const SynthetizerConfig& params);
+
+// Sine operators of every voice modulating each other's phase at audio rate. Voices are SIMD lanes:
+// each frame runs one operator for four voices per instruction, and each algorithm is its own template
+// instantiation, so the modulation routing is resolved at compile time and the loop has no branches.
+// Output is mono per voice, for the voice to add to its oscillators.
+class FmBank {
+public:
+    // State for voices lanes and maxFrames of output each; never called from the audio thread
+    void allocate(DspArena& arena, int voices, int maxFrames);
+    // Clears the state of every lane, once allocated
+    void prepare(float sampleRate);
+    void setSampleRate(float sampleRate);
+    // Note on: operators back to phase 0, the next frequency is taken without a glide
+    void reset(int voice);
+    // Note frequency in Hz for the next render; the voice glides to it linearly from the last one
+    void setFrequency(int voice, float frequency);
+    // Renders numFrames of every group of four voices with at least one active voice
+    void render(const FmSettings& settings, int numFrames, const bool* active);
+    const float* getOutput(int voice) const { return outputs.data() + voice * maxFrames; }
+
+private:
+    float sampleRate = DEFAULT_SAMPLE_RATE;
+    int lanes = 0;
+    int maxFrames = 0;
+    // Operator phases in cycles, [group][operator][lane of 4]
+    std::span<float> phases;
+    // Phase increment of the note per lane at the start and end of the next render
+    std::span<float> startIncrements;
+    std::span<float> endIncrements;
+    std::span<bool> glide;
+    // [voice][frame]
+    std::span<float> outputs;
+
+    template <FmAlgorithm Algorithm>
+    void renderAlgorithm(const FmSettings& settings, int numFrames, const bool* active);
+};
+
+#endif //FMBANK_H
@@ -0,0 +1,116 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef LEVELMETER_H
+#define LEVELMETER_H
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#include "SpscRing.h"
+#include "SynthetizerConfig.h"
+
+// Published by the audio thread (and the loudness thread) with relaxed atomics,
+// read by the UI and by the headless stats. Levels are linear, loudness in LUFS.
+struct OutputMeters {
+    // Block peak with a 20 dB/s fall
+    std::atomic<float> peakLeft{0.0f};
+    std::atomic<float> peakRight{0.0f};
+    // RMS over about 300 ms
+    std::atomic<float> rmsLeft{0.0f};
+    std::atomic<float> rmsRight{0.0f};
+
+    // Envelope level of each voice, 0 when idle
+    std::array<std::atomic<float>, MAX_VOICES> voiceLevels{};
+
+    // Output samples outside [-1, 1] since start, and a flag the UI clears
+    std::atomic<unsigned long long> clippedSamples{0};
+    std::atomic<bool> clipping{false};
+
+    // ITU-R BS.1770, only updated while a LoudnessMeter runs
+    std::atomic<float> momentaryLufs{-std::numeric_limits<float>::infinity()};
+    std::atomic<float> shortTermLufs{-std::numeric_limits<float>::infinity()};
+    std::atomic<float> integratedLufs{-std::numeric_limits<float>::infinity()};
+};
+
+// Peak/RMS/clip measurement of the output, runs on the audio thread at the end of each block
+class LevelMeter {
+public:
+    void prepare(int sampleRate);
+    // Measures a stereo interleaved block and publishes the results
+    void process(const float* buffer, int numFrames, OutputMeters& meters);
+
+private:
+    float sampleRate = 44100.0f;
+    float peakLeft = 0.0f;
+    float peakRight = 0.0f;
+    float meanSquareLeft = 0.0f;
+    float meanSquareRight = 0.0f;
+};
+
+// Biquad in direct form I, double precision as the K-weighting poles sit very close to 1
+struct LoudnessBiquad {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
+
+    double process(double x) {
+        double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        x2 = x1;
+        x1 = x;
+        y2 = y1;
+        y1 = y;
+        return y;
+    }
+};
+
+// BS.1770 momentary, short-term and gated integrated loudness, computed on its own thread.
+// The audio thread only copies its output into a lock-free ring with push().
+class LoudnessMeter {
+public:
+    explicit LoudnessMeter(std::shared_ptr<OutputMeters> meters);
+    ~LoudnessMeter();
+
+    void start();
+    void stop();
+
+    // Audio thread: queue a stereo interleaved block
+    void push(const float* buffer, int numFrames);
+    // Called from prepare(), the meter thread picks the new rate up and restarts measuring
+    void setSampleRate(int sampleRate);
+
+private:
+    static constexpr int SUB_BLOCKS_SHORT_TERM = 30;   // 3 s of 100 ms sub-blocks
+    static constexpr int SUB_BLOCKS_MOMENTARY = 4;     // 400 ms
+    static constexpr int HISTOGRAM_BINS = 750;         // -70 to +5 LUFS in 0.1 LU steps
+
+    std::shared_ptr<OutputMeters> meters;
+    SpscRing<float> ring{1 << 16};
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<int> sampleRate{44100};
+
+    // Meter thread state
+    int activeSampleRate = 0;
+    std::array<LoudnessBiquad, 2> shelf;
+    std::array<LoudnessBiquad, 2> highPass;
+    int subBlockLength = 0;
+    int subBlockFill = 0;
+    double subBlockEnergy = 0.0;
+    std::array<double, SUB_BLOCKS_SHORT_TERM> subBlocks{};
+    int subBlockCount = 0;
+    std::array<double, HISTOGRAM_BINS> histogramEnergy{};
+    std::array<long long, HISTOGRAM_BINS> histogramCount{};
+
+    void run();
+    void reset(int rate);
+    void processFrame(float left, float right);
+    void finishSubBlock();
+    double integratedLoudness() const;
+};
+
+#endif //LEVELMETER_H
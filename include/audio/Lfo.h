@@ -0,0 +1,58 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef LFO_H
+#define LFO_H
+#pragma once
+
+#include <cstdint>
+
+#include "SynthetizerConfig.h"
+
+enum class LfoShape { SINE, TRIANGLE, SQUARE, SAMPLE_HOLD, SMOOTH_RANDOM, COUNT };
+constexpr int LFO_SHAPE_COUNT = static_cast<int>(LfoShape::COUNT);
+// Tempo sync choices of lfoN_sync, 0 = free running at lfoN_rate
+constexpr int LFO_SYNC_COUNT = 10;
+
+const char* lfoShapeName(LfoShape shape);
+// "off", "1/4", "1/8T", ...
+const char* lfoSyncName(int sync);
+
+// One LFO's patch settings with the tempo sync resolved to a rate in Hz
+struct LfoSettings {
+    LfoShape shape = LfoShape::SINE;
+    float frequency = 1.0f;
+    bool perVoice = false;
+};
+
+// LFO index in [0, NUM_LFOS); a synced rate follows tempo_bpm
+LfoSettings readLfoSettings(const SynthetizerConfig& params, int lfo);
+
+// Low-frequency oscillator with a control-rate output in [-1, 1]: advanced once per control block,
+// read by any number of destinations. The engine runs global LFOs once for all voices; per-voice
+// LFOs live in each Voice and restart at its note on.
+class Lfo {
+public:
+    // Back to phase 0 with a fresh random segment
+    void reset();
+    // Random shapes repeat for a given seed, for reproducible renders
+    void setSeed(uint32_t seed);
+    // Moves numFrames ahead at sampleRate and returns the value there
+    float advance(const LfoSettings& settings, int numFrames, float sampleRate);
+    float getValue() const { return value; }
+
+private:
+    float phase = 0.0f;
+    float value = 0.0f;
+    uint32_t randomState = 0x9E3779B9u;
+    // Sample and hold level, and the smooth random segment's end points
+    float held = 0.0f;
+    float randomFrom = 0.0f;
+    float randomTo = 0.0f;
+
+    // xorshift32 in [-1, 1): a few instructions, no state worth a std::mt19937
+    float nextRandom();
+};
+
+#endif //LFO_H
@@ -0,0 +1,44 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory map of a whole file. Pages are only read from disk when first touched,
+// so a large sample library costs address space, not RAM, until it is played.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // Reads the pages covering [offset, offset + count) now and locks them in RAM when allowed,
+    // so the audio thread never waits on a page fault there. Returns false if they could not be locked
+    // (they are still loaded, but may be evicted again under memory pressure).
+    bool prefault(size_t offset, size_t count);
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    // Locked range, unlocked again on close
+    const unsigned char* lockedStart = nullptr;
+    size_t lockedLength = 0;
+#if defined(_WIN32)
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+#endif //MAPPEDFILE_H
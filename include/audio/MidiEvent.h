@@ -0,0 +1,21 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef MIDIEVENT_H
+#define MIDIEVENT_H
+#pragma once
+
+#include <cstdint>
+
+// A channel message due at a frame offset inside the block being rendered
+struct MidiEvent {
+    uint32_t frame = 0;
+    uint8_t size = 0;
+    uint8_t data[3] = {0, 0, 0};
+};
+
+// Most events one block can carry, later ones move to the next block
+constexpr int MAX_BLOCK_EVENTS = 512;
+
+#endif //MIDIEVENT_H
@@ -0,0 +1,59 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef MIDIFILE_H
+#define MIDIFILE_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MidiEvent.h"
+
+// A channel message of a MIDI file at its absolute time
+struct MidiFileEvent {
+    double seconds = 0.0;
+    uint8_t size = 0;
+    uint8_t data[3] = {0, 0, 0};
+};
+
+struct MidiFileInfo {
+    int format = 0;
+    int tracks = 0;
+    int notes = 0;
+    // Up to the end of the longest track (its end-of-track event), not just its last event
+    double seconds = 0.0;
+    // Most notes held at once across all channels
+    int maxPolyphony = 0;
+};
+
+// Reads a Standard MIDI File (format 0 or 1) and merges its tracks into one array of channel messages
+// sorted by time, tempo changes already applied. Meta and system exclusive events are dropped.
+// False with the reason on stderr if the file cannot be read.
+bool loadMidiFile(const std::string& path, std::vector<MidiFileEvent>& events, MidiFileInfo* info = nullptr);
+
+// Plays a loaded event array block by block on the audio thread, without allocating
+class MidiPlayer {
+public:
+    // length is the file's duration (MidiFileInfo::seconds), where a loop restarts; never shorter than the
+    // last event, which is the length when it is 0
+    explicit MidiPlayer(std::vector<MidiFileEvent> events, bool loop = false, double length = 0.0);
+
+    // Events of the next numFrames frames with their offsets in the block. Events beyond capacity
+    // are left for the next block. At the end of a loop an all-notes-off restarts the file cleanly.
+    size_t nextBlock(int numFrames, int sampleRate, MidiEvent* out, size_t capacity);
+    bool isFinished() const { return !loop && cursor >= events.size(); }
+    double getLength() const { return length; }
+
+private:
+    std::vector<MidiFileEvent> events;
+    bool loop;
+    double length;
+    size_t cursor = 0;
+    double position = 0.0;
+};
+
+#endif //MIDIFILE_H
@@ -0,0 +1,43 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef MIDIINPUTQUEUE_H
+#define MIDIINPUTQUEUE_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MidiEvent.h"
+#include "SpscRing.h"
+
+// A MIDI message stamped on arrival by an input thread, in steady clock nanoseconds
+struct TimedMidiMessage {
+    int64_t nanoseconds = 0;
+    uint8_t size = 0;
+    uint8_t data[3] = {0, 0, 0};
+};
+
+// Hands live MIDI from an input thread to the audio thread with sample-accurate timing.
+// Every message is played exactly one block after it arrived, at the same position in that block:
+// a constant latency of one block instead of a jitter of up to one block.
+class MidiInputQueue {
+public:
+    // Steady clock (CLOCK_MONOTONIC on Linux) in nanoseconds, the time base of push()
+    static int64_t now();
+
+    // Input thread. Drops the message if the audio thread has stopped draining the queue.
+    void push(const TimedMidiMessage& message);
+
+    // Audio thread, at the start of each block: the messages that arrived during the last
+    // numFrames / sampleRate seconds, with their offset in that window as frame
+    size_t nextBlock(int numFrames, int sampleRate, MidiEvent* out, size_t capacity);
+
+    size_t getDropped() const { return ring.droppedCount(); }
+
+private:
+    SpscRing<TimedMidiMessage> ring{1024};
+};
+
+#endif //MIDIINPUTQUEUE_H
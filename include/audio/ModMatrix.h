@@ -0,0 +1,76 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef MODMATRIX_H
+#define MODMATRIX_H
+#pragma once
+
+#include <array>
+
+#include "SynthetizerConfig.h"
+
+// Source values: the LFOs, timbre and bend are bipolar [-1, 1], the others unipolar [0, 1].
+// MOD_WHEEL is CC1 of the voice's channel. Values are saved in patches, new sources go at the end.
+enum class ModSource { NONE, LFO1, ENVELOPE, VELOCITY, PRESSURE, TIMBRE, BEND, MOD_WHEEL, LFO2, COUNT };
+// Destination units per 1.0 of amount x source: PITCH in semitones, CUTOFF in octaves, RESONANCE added
+// to the patch's [0, 1] value, AMPLITUDE as gain 1 + x (floored at 0), PAN from -1 (left) to 1 (right)
+enum class ModDestination { NONE, PITCH, CUTOFF, RESONANCE, AMPLITUDE, PAN, COUNT };
+
+constexpr int MOD_SOURCE_COUNT = static_cast<int>(ModSource::COUNT);
+constexpr int MOD_DESTINATION_COUNT = static_cast<int>(ModDestination::COUNT);
+// Rows padded to whole Float4 vectors, one lane per voice
+constexpr int MOD_VOICE_LANES = (MAX_VOICES + 3) / 4 * 4;
+
+const char* modSourceName(ModSource source);
+const char* modDestinationName(ModDestination destination);
+
+// Modulation of one voice for one control block, in destination units
+struct VoiceModulation {
+    float pitch = 0.0f;
+    float cutoff = 0.0f;
+    // Linear cutoff offset in Hz of the fixed LFO 1 to cutoff route (filter_auto_amount)
+    float cutoffHz = 0.0f;
+    float resonance = 0.0f;
+    float amplitude = 0.0f;
+    float pan = 0.0f;
+};
+
+// The patch's routing slots evaluated for all voices at once, once per control block.
+// Sources and destinations are rows of MOD_VOICE_LANES floats (one lane per voice), so every slot is
+// a multiply-add over the rows, four voices per instruction; the voices then interpolate the result
+// per sample over the next control block.
+//
+// Cost: one slot is MOD_VOICE_LANES / 4 = 4 vector multiply-adds per control block for all voices,
+// measured at about 3.5 ns per slot per control block, 0.2 ns per slot per voice (synth_bench
+// modmatrix/evaluate). Any active slot also makes the engine render voices one control block per
+// call, about 6% of a 16-voice block at 256 frames (modmatrix/processAudio). Empty slots (NONE or
+// zero amount) are skipped when the patch is read.
+class ModMatrix {
+public:
+    // Audio thread, once per block: copies the patch's active slots into the flat routing arrays
+    void setRoutings(const SynthetizerConfig& params);
+    bool isActive() const { return routingCount > 0; }
+    int getRoutingCount() const { return routingCount; }
+
+    // Row of per-voice values the engine fills before evaluate()
+    float* sourceRow(ModSource source) { return sources[static_cast<int>(source)].data(); }
+    // Sums amount x source of every slot into the destination rows
+    void evaluate();
+    VoiceModulation getVoice(int voice) const;
+    const float* destinationRow(ModDestination destination) const {
+        return destinations[static_cast<int>(destination)].data();
+    }
+
+private:
+    alignas(16) std::array<std::array<float, MOD_VOICE_LANES>, MOD_SOURCE_COUNT> sources{};
+    alignas(16) std::array<std::array<float, MOD_VOICE_LANES>, MOD_DESTINATION_COUNT> destinations{};
+
+    // Active slots only, as parallel arrays
+    std::array<int, MOD_SLOTS> routingSources{};
+    std::array<int, MOD_SLOTS> routingDestinations{};
+    std::array<float, MOD_SLOTS> routingAmounts{};
+    int routingCount = 0;
+};
+
+#endif //MODMATRIX_H
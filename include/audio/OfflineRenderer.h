@@ -0,0 +1,56 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef OFFLINERENDERER_H
+#define OFFLINERENDERER_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MidiFile.h"
+#include "SynthetizerConfig.h"
+
+// One note rendered without an audio device
+struct RenderRequest {
+    int midiNote = 60;
+    // 0 to 1
+    float velocity = 1.0f;
+    double noteSeconds = 1.0;
+    // Rendered after note off, for the release
+    double tailSeconds = 1.0;
+    uint32_t noiseSeed = 1;
+};
+
+struct RenderFormat {
+    int sampleRate = DEFAULT_SAMPLE_RATE;
+    int blockSize = DEFAULT_FRAMES_PER_BUFFER;
+};
+
+// Renders the note through a fresh AudioEngine with seeded noise, so the same patch, request
+// and format always give bit-identical stereo interleaved output, whatever thread runs it
+std::vector<float> renderNote(const SynthetizerConfig& patch, const RenderRequest& request,
+                              const RenderFormat& format);
+
+struct MidiRenderStats {
+    int peakVoices = 0;
+    long long voiceSteals = 0;
+};
+
+// Plays a whole MIDI file through a fresh AudioEngine (events at their exact frame, seeded noise),
+// followed by tailSeconds for the last releases. stats, when given, receives the voice load.
+std::vector<float> renderMidiFile(const SynthetizerConfig& patch, const std::vector<MidiFileEvent>& events,
+                                  const RenderFormat& format, double tailSeconds = 1.0,
+                                  MidiRenderStats* stats = nullptr);
+
+// 32-bit float stereo WAV, keeps the render bit-exact
+bool writeWav(const std::string& path, const std::vector<float>& interleaved, int sampleRate);
+// Reads a stereo float WAV as written by writeWav
+bool readWav(const std::string& path, std::vector<float>& interleaved, int& sampleRate);
+
+// FNV-1a over the sample bits, to compare renders without keeping them
+uint64_t hashSamples(const std::vector<float>& samples);
+
+#endif //OFFLINERENDERER_H
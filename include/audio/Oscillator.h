@@ -5,30 +5,74 @@
 #ifndef OSCILLATOR_H
 #define OSCILLATOR_H
 
-#include <random>
+#include <cstdint>
+#include "SampleData.h"
+#include "SampleStreamer.h"
 #include "SynthetizerConfig.h"
 class Oscillator {
 public:
     Oscillator();
 
+    void prepare(float sampleRate);
+
     WaveformType getWaveform() const;
     float getFrequency() const;
 
     void setWaveForm(WaveformType waveform);
     void setFrequency(float freq);
+    // Phase in cycles [0, 1), for the voice kernels that run the waveform loops themselves
+    float getPhase() const { return phase; }
+    void setPhase(float phase) { this->phase = phase; }
 
     void generateBuffer(float* buffer, int numFrames, WaveformType waveform,
                        float frequency);
+    // Glides linearly from startFrequency to endFrequency over the buffer (samples play at the mean)
+    void generateBuffer(float* buffer, int numFrames, WaveformType waveform,
+                        float startFrequency, float endFrequency);
+    // Same, and per frame in wraps the sub-sample time at which the phase wrapped after that frame,
+    // in samples before the next frame ([0, 1)), or -1: the sync source of generateSynced
+    void generateBuffer(float* buffer, int numFrames, WaveformType waveform,
+                        float startFrequency, float endFrequency, float* wraps);
+    // Hard sync (triangle and saw): restarts the phase wherever the master's wraps say it wrapped.
+    // The steps this cuts into the waveform, and the saw's own wraps, get a two-sample polyBLEP
+    // correction against aliasing.
+    void generateSynced(float* buffer, int numFrames, WaveformType waveform,
+                        float startFrequency, float endFrequency, const float* wraps);
     void reset();
+    // Fixed noise sequence, for reproducible offline renders
+    void setSeed(uint32_t seed);
+
+    // Sample played by WaveformType::SAMPLE, nullptr for silence. Not owned, set while stopped.
+    void setSample(const SampleData* sample);
+    // Plays the stream's sample through its ring instead of reading the mapping directly
+    void setStream(StreamVoice* stream);
+    // Restarts the sample from its first frame, on every note on
+    void retrigger();
+    bool isSamplePlaying() const;
 
 private:
     WaveformType waveform;
     float frequency;
     float phase;
-    //Random number generator for noise sound using mersenne twister
-    std::mt19937 noise_gen;
-    // Float distribution b
-    std::uniform_real_distribution<float> noise_dist;
+    float sampleRate;
+    // Second half of the last polyBLEP correction, added to the next synced sample
+    float blepPending = 0.0f;
+    // xorshift32 state of the noise: 4 bytes instead of a 5 KB std::mt19937 per oscillator
+    uint32_t noiseState = 0x9E3779B9u;
+
+    const SampleData* sample = nullptr;
+    // Read position in sample frames, double so long samples keep sub-sample precision
+    double samplePosition = 0.0;
+    StreamVoice* stream = nullptr;
+    // Waiting for the I/O thread, counts one underrun per wait
+    bool streamStarved = false;
+
+    // White noise in [-0.5, 0.5)
+    float nextNoise();
+    void generateSample(float* buffer, int numFrames, float frequency);
+    template <SampleFormat Format>
+    void generateSample(float* buffer, int numFrames, double step);
+    void generateStream(float* buffer, int numFrames, double step);
 
 
 };
@@ -0,0 +1,55 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef OVERSAMPLER_H
+#define OVERSAMPLER_H
+#pragma once
+
+#include <span>
+
+#include "DspArena.h"
+
+// Polyphase halfband FIR decimating by 2, stereo interleaved.
+// Every second tap of a halfband filter is zero, so the even input samples go through a
+// 2M tap FIR and the odd ones only through a delay of M samples.
+class HalfbandDecimator {
+public:
+    // Taps and history for blocks of up to maxOutputFrames; halfLength = M, the filter has 4M - 1 taps
+    void allocate(DspArena& arena, int halfLength, int maxOutputFrames);
+    // Designs the taps and clears the history, once allocated
+    void prepare();
+    void reset();
+    // Reads numFrames * 2 stereo frames, writes numFrames stereo frames
+    void process(const float* input, float* output, int numFrames);
+
+private:
+    int halfLength = 0;
+    // Even-phase taps, reversed so the FIR is a forward dot product
+    std::span<float> taps;
+    // Per channel: 2M - 1 samples of history followed by the current block
+    std::span<float> even[2];
+    // Per channel: M samples of history followed by the current block
+    std::span<float> odd[2];
+};
+
+// Decimation back to the base rate for a voice chain running at 2x or 4x.
+// The oscillators generate at the raised rate directly, so no upsampling filter is needed.
+class Oversampler {
+public:
+    // Allocates every factor up front, so switching between 1x, 2x and 4x never allocates
+    void allocate(DspArena& arena, int maxBlockSize);
+    void prepare();
+    void reset();
+    // Reads numFrames * factor stereo frames at the raised rate, writes numFrames at the base rate
+    void downsample(const float* input, float* output, int numFrames, int factor);
+
+private:
+    // 2x -> 1x, steep (63 taps)
+    HalfbandDecimator finalStage;
+    // 4x -> 2x, the transition band is wide so a short filter is enough (15 taps)
+    HalfbandDecimator firstStage;
+    std::span<float> intermediate;
+};
+
+#endif //OVERSAMPLER_H
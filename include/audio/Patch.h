@@ -0,0 +1,22 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef PATCH_H
+#define PATCH_H
+#pragma once
+
+#include <string>
+
+#include "SynthetizerConfig.h"
+
+// A patch is the sound-design part of SynthetizerConfig (oscillators, envelope, filter, volume),
+// stored as "key = value" lines, e.g. "osc1_waveform = 1". Unknown keys are reported and skipped;
+// unison on a synced oscillator, which plays a single copy, is reported and set to 1.
+bool loadPatch(const std::string& path, SynthetizerConfig& config);
+bool savePatch(const std::string& path, const SynthetizerConfig& config);
+
+// Copies the patch parameters only, note and transport state are left alone
+void copyPatch(const SynthetizerConfig& from, SynthetizerConfig& to);
+
+#endif //PATCH_H
@@ -0,0 +1,21 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef PITCH_H
+#define PITCH_H
+#pragma once
+
+#include <cmath>
+
+// Pitch is handled in semitones (log frequency) up to the oscillators, so detune, bend and
+// modulation all add up and sound the same across the keyboard. Semitone 0 is noteNumber 0, A3.
+constexpr float PITCH_REFERENCE_HZ = 220.0f;
+
+// Called a handful of times per voice and control block; the library exp2 measured faster
+// than a polynomial approximation here (see Pitch/ in synth_bench).
+inline float semitonesToFrequency(float semitones) {
+    return PITCH_REFERENCE_HZ * std::exp2(semitones * (1.0f / 12.0f));
+}
+
+#endif //PITCH_H
@@ -0,0 +1,83 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef SAMPLEDATA_H
+#define SAMPLEDATA_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "MappedFile.h"
+
+enum class SampleFormat { INT16, INT24, FLOAT32 };
+
+// Layout of headerless files, which carry no description of their own
+struct RawSampleInfo {
+    SampleFormat format = SampleFormat::FLOAT32;
+    int channels = 1;
+    int sampleRate = 44100;
+    int rootNote = 60;
+};
+
+// One stored sample value as float in [-1, 1)
+template <SampleFormat Format>
+inline float decodeSample(const unsigned char* p) {
+    if constexpr (Format == SampleFormat::INT16) {
+        int16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value * (1.0f / 32768.0f);
+    } else if constexpr (Format == SampleFormat::INT24) {
+        int32_t value = static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16
+                                             | static_cast<uint32_t>(p[2]) << 24) >> 8;
+        return value * (1.0f / 8388608.0f);
+    } else {
+        float value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+}
+
+// Attack region read and locked at load time
+constexpr float SAMPLE_PREFAULT_SECONDS = 0.5f;
+
+// A mono or stereo sample played straight out of a memory-mapped WAV or raw file, never copied.
+// Little-endian PCM (16 or 24 bit) and 32-bit float are read as stored.
+class SampleData {
+public:
+    // nullptr (with the reason on stderr) if the file cannot be mapped or is not a supported WAV
+    static std::shared_ptr<SampleData> loadWav(const std::string& path);
+    static std::shared_ptr<SampleData> loadRaw(const std::string& path, const RawSampleInfo& info);
+
+    SampleFormat getFormat() const { return format; }
+    int getChannels() const { return channels; }
+    int getSampleRate() const { return sampleRate; }
+    // MIDI note recorded at the sample's own pitch (WAV 'smpl' chunk, else middle C)
+    int getRootNote() const { return rootNote; }
+    size_t getFrames() const { return frames; }
+    size_t getBytesPerFrame() const { return bytesPerFrame; }
+    const unsigned char* getFrameData() const { return frameData; }
+
+    // Makes the first seconds resident and locked, see MappedFile::prefault
+    bool prefault(float seconds);
+    // Decodes frames [first, first + count) to stereo interleaved float, mono on both channels
+    void readFrames(size_t first, size_t count, float* stereo) const;
+
+private:
+    MappedFile file;
+    SampleFormat format = SampleFormat::FLOAT32;
+    int channels = 1;
+    int sampleRate = 44100;
+    int rootNote = 60;
+    size_t frames = 0;
+    size_t bytesPerFrame = 0;
+    const unsigned char* frameData = nullptr;
+
+    bool setLayout(size_t dataOffset, size_t dataBytes, SampleFormat format, int channels, int sampleRate);
+};
+
+#endif //SAMPLEDATA_H
@@ -0,0 +1,129 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef SAMPLESTREAMER_H
+#define SAMPLESTREAMER_H
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SampleData.h"
+
+// Frames the I/O thread copies into one voice per pass
+constexpr int STREAM_CHUNK_FRAMES = 4096;
+
+// Streaming state of one playing sample. The audio thread reads the decoded head (in RAM from the start)
+// and then a per-voice ring that the streamer's I/O thread fills ahead of the play position, so the
+// audio thread never touches the file itself.
+//
+// The ring is addressed by absolute frame (frame % capacity). The I/O thread publishes how far it has
+// written, tagged with the note's generation, and only writes frames the audio thread no longer needs.
+class StreamVoice {
+public:
+    StreamVoice(std::shared_ptr<const SampleData> sample, std::shared_ptr<const std::vector<float>> head,
+                int ringFrames);
+
+    const SampleData& getSample() const { return *sample; }
+    long long getFrames() const { return frames; }
+
+    // Audio thread: restart from frame 0 (the head covers the time the I/O thread needs to catch up)
+    void retrigger();
+    // Audio thread: every frame below this is readable, from the head or the ring
+    long long readyFrames() const;
+    // Audio thread: frame must be below readyFrames() or past the end (silence)
+    void read(long long frame, float& left, float& right) const {
+        if (frame < 0 || frame >= frames) {
+            left = right = 0.0f;
+        } else if (frame < headFrames) {
+            left = (*head)[frame * 2];
+            right = (*head)[frame * 2 + 1];
+        } else {
+            size_t slot = static_cast<size_t>(frame & ringMask) * 2;
+            left = ring[slot];
+            right = ring[slot + 1];
+        }
+    }
+    // Audio thread, once per block: frames below lowestNeeded may be overwritten, and the play rate in
+    // source frames per second which orders the I/O thread's refills
+    void release(long long lowestNeeded, float framesPerSecond, bool stillPlaying);
+    // Audio thread: the play position waited for frames the I/O thread had not delivered yet
+    void countUnderrun(bool newUnderrun);
+
+private:
+    friend class SampleStreamer;
+
+    std::shared_ptr<const SampleData> sample;
+    std::shared_ptr<const std::vector<float>> head;
+    const long long frames;
+    const long long headFrames;
+    std::vector<float> ring;
+    const long long ringFrames;
+    const long long ringMask;
+
+    std::atomic<uint32_t> generation{0};
+    std::atomic<bool> playing{false};
+    std::atomic<long long> lowestNeeded{0};
+    std::atomic<float> framesPerSecond{0.0f};
+    // generation << 40 | first frame not yet written
+    std::atomic<uint64_t> published{0};
+    std::atomic<uint64_t> underruns{0};
+    std::atomic<uint64_t> underrunFrames{0};
+
+    // I/O thread only
+    uint32_t fetchGeneration = UINT32_MAX;
+    long long fetchFrame = 0;
+};
+
+struct StreamStats {
+    uint64_t underruns = 0;        // times a voice ran out of streamed frames
+    uint64_t underrunFrames = 0;   // output frames spent waiting
+    uint64_t bytesRead = 0;
+    double seconds = 0.0;          // since start()
+    double busySeconds = 0.0;      // spent copying from disk
+};
+
+// Background I/O for sample voices: one thread refills whichever voice is closest to running dry.
+class SampleStreamer {
+public:
+    // ringFrames is rounded up to a power of two, and to at least the head plus two chunks;
+    // headSeconds of every sample are decoded when its first voice is created
+    explicit SampleStreamer(int ringFrames = 1 << 15, float headSeconds = SAMPLE_PREFAULT_SECONDS);
+    ~SampleStreamer();
+
+    // Call before start(); voices live as long as the streamer
+    StreamVoice* createVoice(std::shared_ptr<const SampleData> sample);
+
+    void start();
+    void stop();
+
+    StreamStats getStats() const;
+
+private:
+    int ringFrames;
+    float headSeconds;
+    std::vector<std::unique_ptr<StreamVoice>> voices;
+    // Decoded heads, shared by the voices of one sample
+    std::map<const SampleData*, std::shared_ptr<const std::vector<float>>> heads;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<double> busySeconds{0.0};
+    std::chrono::steady_clock::time_point startTime;
+    double stoppedSeconds = 0.0;
+
+    void run();
+    // Copies the next chunk of the voice's sample into its ring, false if it had no room
+    bool refill(StreamVoice& voice);
+};
+
+void printStreamStats(const StreamStats& stats);
+
+#endif //SAMPLESTREAMER_H
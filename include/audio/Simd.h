@@ -0,0 +1,139 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef SIMD_H
+#define SIMD_H
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// Four float lanes mapped to SSE on x86, NEON on ARM (Apple silicon) and plain arrays elsewhere.
+// Only the operations the DSP kernels need; loads and stores are unaligned.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define SYNTH_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SYNTH_SIMD_NEON 1
+#endif
+
+struct Float4 {
+#if defined(SYNTH_SIMD_SSE)
+    __m128 v;
+#elif defined(SYNTH_SIMD_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+
+    static Float4 load(const float* p) {
+#if defined(SYNTH_SIMD_SSE)
+        return {_mm_loadu_ps(p)};
+#elif defined(SYNTH_SIMD_NEON)
+        return {vld1q_f32(p)};
+#else
+        return {{p[0], p[1], p[2], p[3]}};
+#endif
+    }
+
+    static Float4 broadcast(float x) {
+#if defined(SYNTH_SIMD_SSE)
+        return {_mm_set1_ps(x)};
+#elif defined(SYNTH_SIMD_NEON)
+        return {vdupq_n_f32(x)};
+#else
+        return {{x, x, x, x}};
+#endif
+    }
+
+    static Float4 zero() { return broadcast(0.0f); }
+
+    void store(float* p) const {
+#if defined(SYNTH_SIMD_SSE)
+        _mm_storeu_ps(p, v);
+#elif defined(SYNTH_SIMD_NEON)
+        vst1q_f32(p, v);
+#else
+        std::copy(v, v + 4, p);
+#endif
+    }
+
+    float lane(int i) const {
+        float lanes[4];
+        store(lanes);
+        return lanes[i];
+    }
+
+    // Sum of the four lanes
+    float sum() const {
+#if defined(SYNTH_SIMD_SSE)
+        __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+#else
+        float lanes[4];
+        store(lanes);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    }
+};
+
+#if defined(SYNTH_SIMD_SSE)
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 min(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline Float4 abs(Float4 a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+// 1 in the lanes where x >= edge, else 0
+inline Float4 step(Float4 edge, Float4 x) { return {_mm_and_ps(_mm_cmpge_ps(x.v, edge.v), _mm_set1_ps(1.0f))}; }
+// Nearest integer (ties to even), for |a| below 2^31
+inline Float4 round(Float4 a) { return {_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))}; }
+#elif defined(SYNTH_SIMD_NEON)
+inline Float4 operator+(Float4 a, Float4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {vmulq_f32(a.v, b.v)}; }
+inline Float4 min(Float4 a, Float4 b) { return {vminq_f32(a.v, b.v)}; }
+inline Float4 max(Float4 a, Float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+inline Float4 abs(Float4 a) { return {vabsq_f32(a.v)}; }
+inline Float4 step(Float4 edge, Float4 x) {
+    return {vreinterpretq_f32_u32(vandq_u32(vcgeq_f32(x.v, edge.v), vreinterpretq_u32_f32(vdupq_n_f32(1.0f))))};
+}
+inline Float4 round(Float4 a) { return {vrndnq_f32(a.v)}; }
+#else
+#define SYNTH_SIMD_LANEWISE(name, expr) \
+    inline Float4 name(Float4 a, Float4 b) { \
+        Float4 r; \
+        for (int i = 0; i < 4; ++i) { r.v[i] = expr; } \
+        return r; \
+    }
+SYNTH_SIMD_LANEWISE(operator+, a.v[i] + b.v[i])
+SYNTH_SIMD_LANEWISE(operator-, a.v[i] - b.v[i])
+SYNTH_SIMD_LANEWISE(operator*, a.v[i] * b.v[i])
+SYNTH_SIMD_LANEWISE(min, std::min(a.v[i], b.v[i]))
+SYNTH_SIMD_LANEWISE(max, std::max(a.v[i], b.v[i]))
+SYNTH_SIMD_LANEWISE(step, b.v[i] >= a.v[i] ? 1.0f : 0.0f)
+#undef SYNTH_SIMD_LANEWISE
+inline Float4 abs(Float4 a) {
+    Float4 r;
+    for (int i = 0; i < 4; ++i) { r.v[i] = std::fabs(a.v[i]); }
+    return r;
+}
+inline Float4 round(Float4 a) {
+    Float4 r;
+    for (int i = 0; i < 4; ++i) { r.v[i] = std::nearbyint(a.v[i]); }
+    return r;
+}
+#endif
+
+// Largest integer not above a, for |a| below 2^31: the nearest one, less one where that is above a
+inline Float4 floor(Float4 a) {
+    const Float4 nearest = round(a);
+    return nearest - (Float4::broadcast(1.0f) - step(nearest, a));
+}
+
+inline Float4& operator+=(Float4& a, Float4 b) { return a = a + b; }
+inline Float4& operator*=(Float4& a, Float4 b) { return a = a * b; }
+
+#endif //SIMD_H
@@ -0,0 +1,77 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free single producer / single consumer ring buffer.
+// The producer (audio thread) never blocks and never allocates: when the ring is full
+// the samples that do not fit are dropped and counted.
+template <typename T>
+class SpscRing {
+public:
+    // Capacity is rounded up to a power of two so indices wrap with a mask
+    explicit SpscRing(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) {
+            capacity <<= 1;
+        }
+        buffer.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    // Producer side, returns how many items were written
+    size_t push(const T* data, size_t count) {
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        size_t read = readIndex.load(std::memory_order_acquire);
+        size_t space = buffer.size() - (write - read);
+        size_t toWrite = std::min(count, space);
+
+        for (size_t i = 0; i < toWrite; ++i) {
+            buffer[(write + i) & mask] = data[i];
+        }
+        writeIndex.store(write + toWrite, std::memory_order_release);
+
+        if (toWrite < count) {
+            dropped.fetch_add(count - toWrite, std::memory_order_relaxed);
+        }
+        return toWrite;
+    }
+
+    // Consumer side, returns how many items were read
+    size_t pop(T* data, size_t maxCount) {
+        size_t read = readIndex.load(std::memory_order_relaxed);
+        size_t write = writeIndex.load(std::memory_order_acquire);
+        size_t toRead = std::min(maxCount, write - read);
+
+        for (size_t i = 0; i < toRead; ++i) {
+            data[i] = buffer[(read + i) & mask];
+        }
+        readIndex.store(read + toRead, std::memory_order_release);
+        return toRead;
+    }
+
+    size_t available() const {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return buffer.size(); }
+    size_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    std::vector<T> buffer;
+    size_t mask = 0;
+    // On separate cache lines so producer and consumer do not invalidate each other
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+    alignas(64) std::atomic<size_t> dropped{0};
+};
+
+#endif //SPSCRING_H
@@ -6,11 +6,29 @@
 #define SYNTHETIZERCONFIG_H
 #pragma once
 
+#include <array>
 #include <atomic>
 
-enum class WaveformType{TRIANGLE,SAW,NOISE};
-constexpr int SAMPLE_RATE = 44100;
-constexpr int FRAMES_PER_BUFFER = 256;
+enum class WaveformType{TRIANGLE,SAW,NOISE,SAMPLE};
+// Startup defaults, the real values are chosen at runtime and given to prepare()
+constexpr int DEFAULT_SAMPLE_RATE = 44100;
+constexpr int DEFAULT_FRAMES_PER_BUFFER = 256;
+// The voice chain can run at 1x, 2x or 4x the output rate
+constexpr int MAX_OVERSAMPLING = 4;
+// Voices allocated by the engine, the patch's polyphony limits how many are used
+constexpr int MAX_VOICES = 16;
+// Output-rate frames per control block: voice modulation is updated at this rate, not per sample
+constexpr int CONTROL_BLOCK_FRAMES = 32;
+// Routing slots of the modulation matrix
+constexpr int MOD_SLOTS = 8;
+// LFO modules, each either global or per voice
+constexpr int NUM_LFOS = 2;
+// Detuned copies per oscillator in unison mode
+constexpr int MAX_UNISON = 16;
+// FM operators per voice, the most any FM algorithm uses
+constexpr int FM_OPERATORS = 6;
+// Cutoff swing in Hz of filter_auto_amount = 1 (LFO 1 to cutoff)
+constexpr float FILTER_LFO_DEPTH_HZ = 5000.0f;
 
 
 
@@ -21,25 +39,92 @@ struct SynthetizerConfig {
     std::atomic<bool> osc2_enabled{false};
     std::atomic<bool> osc3_enabled{false};
 
-    //(0= Triangle 1= Saw 2= Noise)
+    //(0= Triangle 1= Saw 2= Noise 3= Sample)
     std::atomic<int> osc1_waveform{0};
     std::atomic<int> osc2_waveform{1};
     std::atomic<int> osc3_waveform{2};
 
-    // Oscillators offsets (demi-tons)
+    // Oscillators offsets in semitones (demi-tons) and fine detune in cents, both relative to the note
     std::atomic<float> osc1_freq_offset{0.0f};
     std::atomic<float> osc2_freq_offset{-2.0f};
     std::atomic<float> osc3_freq_offset{3.0f};
+    std::atomic<float> osc1_fine{0.0f};
+    std::atomic<float> osc2_fine{0.0f};
+    std::atomic<float> osc3_fine{0.0f};
+
+    // Oscillator 1 as master: hard sync restarts oscillator 2 or 3 (triangle, saw) at each of its cycles,
+    // ring modulation multiplies their output by it. Oscillator 1 runs for them even when disabled,
+    // without unison.
+    std::atomic<bool> osc2_sync{false};
+    std::atomic<bool> osc3_sync{false};
+    std::atomic<bool> osc2_ring{false};
+    std::atomic<bool> osc3_ring{false};
+
+    // Unison (triangle and saw): copies per note (1 = off), detune of the outermost copies in
+    // semitones either side of the pitch, stereo width of the copies (0 = mono, 1 = hard left to right)
+    std::atomic<int> osc1_unison{1};
+    std::atomic<int> osc2_unison{1};
+    std::atomic<int> osc3_unison{1};
+    std::atomic<float> osc1_unison_detune{0.15f};
+    std::atomic<float> osc2_unison_detune{0.15f};
+    std::atomic<float> osc3_unison_detune{0.15f};
+    std::atomic<float> osc1_unison_spread{0.5f};
+    std::atomic<float> osc2_unison_spread{0.5f};
+    std::atomic<float> osc3_unison_spread{0.5f};
+
+    // FM operators (FmAlgorithm, 0 = off), played beside the oscillators: each operator's frequency as
+    // a multiple of the note's, and its level, the output of a carrier or the modulation index of a modulator
+    std::atomic<int> fm_algorithm{0};
+    std::atomic<float> fm_op1_ratio{1.0f};
+    std::atomic<float> fm_op2_ratio{1.0f};
+    std::atomic<float> fm_op3_ratio{1.0f};
+    std::atomic<float> fm_op4_ratio{1.0f};
+    std::atomic<float> fm_op5_ratio{1.0f};
+    std::atomic<float> fm_op6_ratio{1.0f};
+    std::atomic<float> fm_op1_level{1.0f};
+    std::atomic<float> fm_op2_level{0.5f};
+    std::atomic<float> fm_op3_level{0.5f};
+    std::atomic<float> fm_op4_level{0.5f};
+    std::atomic<float> fm_op5_level{0.5f};
+    std::atomic<float> fm_op6_level{0.5f};
 
     // in seconds
     std::atomic<float> attack_time{0.1f};
     std::atomic<float> release_time{0.5f};
 
-    // LFO filter parameters
+    // Filter, filter_auto_amount is the depth of LFO 1 on the cutoff (FILTER_LFO_DEPTH_HZ at 1)
     std::atomic<float> filter_cutoff{10000.0f};
     std::atomic<float> filter_resonance{0.0f};
     std::atomic<float> filter_auto_amount{0.0f};
-    std::atomic<float> filter_auto_freq{5.0f};
+
+    // LFOs: LfoShape, free rate in Hz, tempo sync choice (0 = free, see lfoSyncName) and
+    // whether each voice runs its own LFO restarted at note on, rather than one shared phase
+    std::atomic<int> lfo1_shape{0};
+    std::atomic<float> lfo1_rate{5.0f};
+    std::atomic<int> lfo1_sync{0};
+    std::atomic<bool> lfo1_per_voice{false};
+    std::atomic<int> lfo2_shape{0};
+    std::atomic<float> lfo2_rate{2.0f};
+    std::atomic<int> lfo2_sync{0};
+    std::atomic<bool> lfo2_per_voice{false};
+
+    // Per-note expression (MPE): pitch bend range in semitones (48 is the MPE default),
+    // and how far pressure and timbre (CC74) move the cutoff, in octaves at full deflection
+    std::atomic<float> bend_range{2.0f};
+    std::atomic<float> pressure_to_cutoff{0.0f};
+    std::atomic<float> timbre_to_cutoff{0.0f};
+
+    // Modulation matrix: slot i routes mod_source[i] to mod_destination[i] scaled by mod_amount[i]
+    // (ModSource / ModDestination values, 0 = unused). Saved as mod1_source, mod1_destination, ...
+    std::array<std::atomic<int>, MOD_SLOTS> mod_source{};
+    std::array<std::atomic<int>, MOD_SLOTS> mod_destination{};
+    std::array<std::atomic<float>, MOD_SLOTS> mod_amount{};
+
+    // Voice chain rate multiplier (1, 2 or 4), against aliasing of sweeps and naive waveforms
+    std::atomic<int> oversampling{1};
+
+    // Notes sounding at once, 1 = monophonic (a new note takes over the sounding one)
+    std::atomic<int> polyphony{8};
 
     std::atomic<float> volume{0.5f};
     std::atomic<int> octave{0};
@@ -47,6 +132,14 @@ struct SynthetizerConfig {
     std::atomic<int> noteNumber { -1};
     std::atomic<bool> note_on{false};
     std::atomic<float> note_frequency{440.0f};
+
+    // Host transport (written by backends that have one, e.g. JACK)
+    std::atomic<bool> transport_rolling{false};
+    std::atomic<float> tempo_bpm{120.0f};
+
+    // Bumped by the audio side whenever something the UI displays has changed,
+    // so an idle UI only redraws when there is something new to show
+    std::atomic<unsigned> display_version{0};
 };
 
 
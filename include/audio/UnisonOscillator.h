@@ -0,0 +1,51 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef UNISONOSCILLATOR_H
+#define UNISONOSCILLATOR_H
+#pragma once
+
+#include <array>
+
+#include "SynthetizerConfig.h"
+
+// Up to MAX_UNISON detuned copies of a triangle or saw spread across the stereo field, the supersaw.
+// The copies are kept as arrays (phase, pitch ratio, gains) and run four at a time in SIMD lanes,
+// so 16 copies cost about four single oscillators rather than sixteen.
+class UnisonOscillator {
+public:
+    static bool supports(WaveformType waveform) {
+        return waveform == WaveformType::TRIANGLE || waveform == WaveformType::SAW;
+    }
+
+    void prepare(float sampleRate);
+    // Copies back to their starting phases, on every note on
+    void reset();
+    // copies in [1, MAX_UNISON], detune in semitones for the outermost copies, spread in [0, 1].
+    // Recomputes the copies' ratios and gains only when a value changed.
+    void setShape(int copies, float detune, float spread);
+
+    // Stereo frames of the copies summed, gliding linearly from startFrequency to endFrequency.
+    // Overwrites buffer like Oscillator::generateBuffer.
+    void generateBuffer(float* buffer, int numFrames, WaveformType waveform,
+                        float startFrequency, float endFrequency);
+
+private:
+    float sampleRate = DEFAULT_SAMPLE_RATE;
+    int copies = 0;
+    float detune = 0.0f;
+    float spread = 0.0f;
+    // copies rounded up to whole SIMD groups; the padding lanes run with zero gain
+    int lanes = 0;
+
+    alignas(16) std::array<float, MAX_UNISON> phases{};
+    alignas(16) std::array<float, MAX_UNISON> ratios{};
+    alignas(16) std::array<float, MAX_UNISON> leftGains{};
+    alignas(16) std::array<float, MAX_UNISON> rightGains{};
+
+    template <WaveformType Waveform>
+    void render(float* buffer, int numFrames, float startFrequency, float endFrequency);
+};
+
+#endif //UNISONOSCILLATOR_H
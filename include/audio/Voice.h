@@ -0,0 +1,117 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef VOICE_H
+#define VOICE_H
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "DspArena.h"
+#include "Envelope.h"
+#include "Filter.h"
+#include "Lfo.h"
+#include "ModMatrix.h"
+#include "Oscillator.h"
+#include "SynthetizerConfig.h"
+#include "UnisonOscillator.h"
+
+// Per-note expression as MPE sends it on the note's channel. A few floats, so events only overwrite
+// values and never allocate.
+struct VoiceExpression {
+    float bend = 0.0f;      // [-1, 1], times the patch's bend range in semitones
+    float pressure = 0.0f;  // [0, 1], channel or polyphonic aftertouch
+    float timbre = 0.0f;    // [-1, 1], CC74 centered on 64
+
+    bool operator==(const VoiceExpression&) const = default;
+};
+
+// One sounding note: the three oscillators, envelope and filter, run at the chain (oversampled) rate.
+// The engine owns a fixed set of voices and sums them before decimation.
+class Voice {
+public:
+    // The voice's buffers for maxChainFrames stereo frames; never called from the audio thread
+    void allocate(DspArena& arena, int maxChainFrames);
+    // Silences the voice and gives the rate to its DSP objects, once allocated
+    void prepare(float chainRate);
+    // Oversampling switch: new rate for every DSP object, the envelope keeps its state
+    void setChainRate(float chainRate);
+    void setSeed(uint32_t seed);
+    void setSample(const SampleData* sample);
+    void setStream(int oscillator, StreamVoice* stream);
+
+    // pitch in semitones above A3 (PITCH_REFERENCE_HZ), octave included.
+    // expression: the channel's state at the note on, taken over without smoothing
+    void noteOn(int note, int channel, float pitch, float velocity, uint64_t age,
+                const VoiceExpression& expression);
+    void noteOff();
+    // Targets the voice glides to, one step per control block
+    void setBend(float bend) { target.bend = bend; }
+    void setPressure(float pressure) { target.pressure = pressure; }
+    void setTimbre(float timbre) { target.timbre = timbre; }
+
+    // Still audible (attack, sustain or release)
+    bool isActive() const { return envelope.isActive(); }
+    // Key still down
+    bool isHeld() const { return held; }
+    int getNote() const { return note; }
+    int getChannel() const { return channel; }
+    // Order of note ons, the lowest is the oldest voice and the first stolen
+    uint64_t getAge() const { return age; }
+    float getLevel() const { return envelope.getValue(); }
+    float getVelocity() const { return velocity; }
+    // Per-voice LFO i, restarted at each note on; returns its value numFrames later
+    float advanceLfo(int lfo, const LfoSettings& settings, int numFrames, float sampleRate) {
+        return lfos[lfo].advance(settings, numFrames, sampleRate);
+    }
+    // Smoothed expression the voice currently plays with
+    const VoiceExpression& getExpression() const { return current; }
+    // Note pitch in semitones with the current bend, what the engine's FM operators play at
+    float getPitch(const SynthetizerConfig& params) const { return pitch + current.bend * params.bend_range.load(); }
+
+    // Adds chainFrames stereo frames of this voice, velocity applied, to mix. While the expression
+    // moves it renders in spans of controlFrames (a control block at the chain rate).
+    // The matrix modulation glides per sample from the previous call's value to this one.
+    // fm: chainFrames mono samples of the voice's FM operators added to the oscillators, or nullptr.
+    void render(const SynthetizerConfig& params, float* mix, int chainFrames, int controlFrames,
+                const VoiceModulation& modulation = {}, const float* fm = nullptr);
+
+private:
+    std::array<Oscillator, 3> oscillators;
+    // Play instead of the oscillator of the same index when its unison is above 1 copy
+    std::array<UnisonOscillator, 3> unisons;
+    Envelope envelope;
+    Filter filter;
+    std::array<Lfo, NUM_LFOS> lfos;
+    // Oscillator 1's output and phase wraps when it is the sync or ring source
+    std::span<float> masterBuffer;
+    std::span<float> masterWraps;
+    std::span<float> oscBuffer;
+    std::span<float> voiceBuffer;
+    float chainRate = DEFAULT_SAMPLE_RATE;
+
+    int note = -1;
+    int channel = 0;
+    float pitch = 0.0f;
+    float velocity = 1.0f;
+    bool held = false;
+    uint64_t age = 0;
+
+    VoiceExpression target;
+    VoiceExpression current;
+    // Reached at the end of the last render, the start of the next glide
+    VoiceModulation modulation;
+    // Set by noteOn: the first render starts at its modulation instead of gliding from the old note's
+    bool modulationReset = true;
+
+    // One smoothing step of current towards target
+    void stepExpression();
+    // from and to: modulation at the first frame and after the last one
+    void renderSpan(const SynthetizerConfig& params, float* mix, int chainFrames,
+                    const VoiceModulation& from, const VoiceModulation& to, const float* fm);
+};
+
+#endif //VOICE_H
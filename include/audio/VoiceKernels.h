@@ -0,0 +1,29 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef VOICEKERNELS_H
+#define VOICEKERNELS_H
+#pragma once
+
+#include "SynthetizerConfig.h"
+
+// Oscillator state a kernel runs with: phase in cycles and per-sample phase increment of each
+// oscillator, the increment gliding by incrementStep per sample. Unused for disabled oscillators.
+struct VoiceKernelState {
+    float phases[3];
+    float increments[3];
+    float incrementSteps[3];
+};
+
+// Sums the three oscillators into numFrames stereo frames of out (overwritten) and moves the state on
+using VoiceKernel = void (*)(VoiceKernelState& state, float* out, int numFrames);
+
+// Kernel compiled for this combination of enabled oscillators and waveforms, one per combination of
+// off / triangle / saw, so its loop has neither the enabled checks nor the waveform switch. nullptr when
+// an enabled oscillator plays noise or a sample, which keep the generic path.
+VoiceKernel findVoiceKernel(const bool* enabled, const WaveformType* waveforms);
+// Number of kernels compiled, for the code size figures of synth_bench
+int voiceKernelCount();
+
+#endif //VOICEKERNELS_H
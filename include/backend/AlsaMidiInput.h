@@ -0,0 +1,52 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef ALSAMIDIINPUT_H
+#define ALSAMIDIINPUT_H
+#pragma once
+
+#ifdef SYNTH_HAVE_ALSA
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <alsa/asoundlib.h>
+
+#include "../audio/AudioSettings.h"
+#include "../audio/MidiInputQueue.h"
+
+// ALSA sequencer client "synth" with a midi_in port. Its own thread waits on the sequencer, stamps
+// every event with the steady clock as it arrives and pushes it as raw bytes into the engine's
+// MidiInputQueue, so live MIDI reaches the audio thread without going through the UI.
+// Hardware ports (raw MIDI devices) show up as sequencer clients and connect the same way.
+class AlsaMidiInput {
+public:
+    explicit AlsaMidiInput(std::shared_ptr<MidiInputQueue> queue);
+    ~AlsaMidiInput();
+
+    // Creates the port and, unless source is empty, subscribes it to "client:port" (e.g. "20:0" or
+    // "Keystation:0"). Returns false on failure.
+    bool open(const std::string& source);
+    // The thread runs one step below the audio thread's real-time priority, if one was requested
+    void start(const RealtimeOptions& realtime);
+    void stop();
+    void close();
+
+private:
+    std::shared_ptr<MidiInputQueue> queue;
+    snd_seq_t* sequencer = nullptr;
+    int port = -1;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+
+    void run();
+    // Converts a sequencer event to a channel message, false for everything else (clock, sysex, ...)
+    static bool toMessage(const snd_seq_event_t& event, TimedMidiMessage& message);
+};
+
+#endif //SYNTH_HAVE_ALSA
+
+#endif //ALSAMIDIINPUT_H
@@ -0,0 +1,53 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef AUDIOBACKEND_H
+#define AUDIOBACKEND_H
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "../audio/AudioEngine.h"
+#include "../audio/AudioSettings.h"
+#include "RealtimeThread.h"
+
+// A driver that pulls audio from AudioEngine::processAudio (PortAudio, JACK, ...)
+class AudioBackend {
+public:
+    virtual ~AudioBackend() = default;
+
+    // Opens the device and prepares the engine for the rate and block size it will run at
+    virtual void open(const AudioSettings& settings) = 0;
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    virtual void close() = 0;
+
+    virtual const char* getName() const = 0;
+    // Output latency achieved by the driver, in seconds
+    virtual double getOutputLatency() const = 0;
+
+    // Scheduling applied by the audio thread to itself on its first callback after start()
+    void setRealtimeOptions(const RealtimeOptions& options);
+    // Null until the audio thread has applied the options
+    const RealtimeReport* getRealtimeReport() const;
+
+protected:
+    // Called by start() before the audio thread runs
+    void resetRealtimePromotion();
+    // Called at the top of every audio callback, only does work the first time
+    void promoteAudioThread();
+
+private:
+    RealtimeOptions realtimeOptions;
+    RealtimeReport realtimeReport;
+    // Only touched by the audio thread once started
+    bool audioThreadPromoted = false;
+    std::atomic<bool> realtimeReportReady{false};
+};
+
+// Creates the backend named in settings.backend, exits if it is unknown or not compiled in
+std::unique_ptr<AudioBackend> createAudioBackend(AudioEngine& engine, const AudioSettings& settings);
+
+#endif //AUDIOBACKEND_H
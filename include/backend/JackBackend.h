@@ -0,0 +1,62 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef JACKBACKEND_H
+#define JACKBACKEND_H
+#pragma once
+
+#ifdef SYNTH_HAVE_JACK
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <jack/jack.h>
+
+#include "AudioBackend.h"
+
+// Frames the output buffer holds from open() on; the engine renders longer periods in chunks of its block
+constexpr jack_nframes_t JACK_PREPARED_PERIOD = 4096;
+
+// Native JACK client: renders directly at JACK's period size without PortAudio's extra buffering.
+// Registers out_L/out_R audio ports and a midi_in port, and forwards the transport tempo to the engine.
+class JackBackend : public AudioBackend {
+public:
+    explicit JackBackend(AudioEngine& engine);
+    ~JackBackend() override;
+
+    void open(const AudioSettings& settings) override;
+    void start() override;
+    void stop() override;
+    void close() override;
+
+    const char* getName() const override { return "JACK"; }
+    double getOutputLatency() const override;
+
+private:
+    AudioEngine& engine;
+    jack_client_t* client = nullptr;
+    std::array<jack_port_t*, 2> outputPorts{};
+    jack_port_t* midiInputPort = nullptr;
+    // Cleared by the shutdown callback from JACK's thread
+    std::atomic<bool> isActive{false};
+
+    // processAudio renders interleaved stereo, JACK ports are one buffer per channel.
+    // Sized once in open() for the largest period expected; only regrown while resizing is set.
+    std::vector<float> interleaved;
+    // Set by bufferSizeCallback while it regrows interleaved, the process thread outputs silence meanwhile
+    std::atomic<bool> resizing{false};
+    // Set by the process thread while it uses interleaved, bufferSizeCallback waits for it to clear
+    std::atomic<bool> rendering{false};
+    std::vector<MidiEvent> midiEvents = std::vector<MidiEvent>(MAX_BLOCK_EVENTS);
+
+    static int processCallback(jack_nframes_t numFrames, void* arg);
+    static int bufferSizeCallback(jack_nframes_t numFrames, void* arg);
+    static void shutdownCallback(void* arg);
+
+    void connectToPlaybackPorts();
+};
+
+#endif //SYNTH_HAVE_JACK
+
+#endif //JACKBACKEND_H
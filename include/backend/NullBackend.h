@@ -0,0 +1,64 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef NULLBACKEND_H
+#define NULLBACKEND_H
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "AudioBackend.h"
+
+// Running min/max/mean/stddev of a duration series, in microseconds
+struct TimingStats {
+    long long count = 0;
+    double min = 0.0;
+    double max = 0.0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+
+    void add(double value);
+    double mean() const;
+    double stddev() const;
+};
+
+// Driver without audio hardware: a thread calls processAudio either on the clock a real
+// device would use (one block every framesPerBuffer / sampleRate seconds) or as fast as possible.
+// Reports throughput, render time and wake-up jitter when closed.
+class NullBackend : public AudioBackend {
+public:
+    explicit NullBackend(AudioEngine& engine);
+    ~NullBackend() override;
+
+    void open(const AudioSettings& settings) override;
+    void start() override;
+    void stop() override;
+    void close() override;
+
+    const char* getName() const override { return "Null"; }
+    double getOutputLatency() const override;
+
+    void printReport() const;
+
+private:
+    AudioEngine& engine;
+    AudioSettings settings;
+    std::vector<float> outputBuffer;
+
+    std::thread renderThread;
+    std::atomic<bool> running{false};
+
+    // Written by the render thread, read once it is joined
+    TimingStats renderTime;
+    TimingStats wakeUpJitter;
+    long long renderedFrames = 0;
+    std::chrono::steady_clock::duration wallTime{};
+
+    void renderLoop();
+};
+
+#endif //NULLBACKEND_H
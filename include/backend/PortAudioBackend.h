@@ -0,0 +1,44 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef PORTAUDIOBACKEND_H
+#define PORTAUDIOBACKEND_H
+#pragma once
+
+#include <portaudio.h>
+
+#include "AudioBackend.h"
+
+class PortAudioBackend : public AudioBackend {
+public:
+    explicit PortAudioBackend(AudioEngine& engine);
+    ~PortAudioBackend() override;
+
+    void open(const AudioSettings& settings) override;
+    void start() override;
+    void stop() override;
+    void close() override;
+
+    const char* getName() const override { return "PortAudio"; }
+    double getOutputLatency() const override;
+
+    // Prints every host API and output device with its latency range
+    static void listDevices();
+
+private:
+    AudioEngine& engine;
+    PaStream* stream = nullptr;
+    AudioSettings settings;
+    bool isInitialized = false;
+
+    PaDeviceIndex selectOutputDevice() const;
+
+    static int audioCallback(const void* inputBuffer, void* outputBuffer,
+                           unsigned long framesPerBuffer,
+                           const PaStreamCallbackTimeInfo* timeInfo,
+                           PaStreamCallbackFlags statusFlags,
+                           void* userData);
+};
+
+#endif //PORTAUDIOBACKEND_H
@@ -0,0 +1,47 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef REALTIMETHREAD_H
+#define REALTIMETHREAD_H
+#pragma once
+
+#include <cstdint>
+
+#include "../audio/AudioSettings.h"
+
+// What could actually be applied, missing privileges are reported instead of failing.
+// Plain values only: the audio thread fills it without allocating, printRealtimeReport() makes the text.
+struct RealtimeReport {
+    bool priorityRequested = false;
+    bool priorityApplied = false;
+    RealtimePolicy policy = RealtimePolicy::NONE;
+    // After clamping to the policy's range
+    int priority = 0;
+    // errno, or GetLastError() on Windows; 0 when applied
+    int priorityError = 0;
+
+    bool affinityRequested = false;
+    bool affinitySupported = true;
+    bool affinityApplied = false;
+    int affinityError = 0;
+    // Requested CPUs, bit n = CPU n (the first 64)
+    uint64_t cpuMask = 0;
+
+    bool memoryLockRequested = false;
+    bool memoryLockSupported = true;
+    bool memoryLocked = false;
+    int memoryLockError = 0;
+};
+
+// Applies policy, priority and CPU affinity to the calling thread. Meant to be called once
+// from the audio thread itself, so it also works for threads created by PortAudio or JACK.
+// Makes system calls only, never allocates.
+void promoteCurrentThread(const RealtimeOptions& options, RealtimeReport& report);
+
+// Locks current and future pages of the process in RAM
+void lockProcessMemory(RealtimeReport& report);
+
+void printRealtimeReport(const RealtimeReport& report);
+
+#endif //REALTIMETHREAD_H
@@ -0,0 +1,58 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+#pragma once
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include "../audio/AudioTap.h"
+
+// Oscilloscope and spectrum of the engine output, computed on the UI thread from the AudioTap.
+// Hann window, 50 % overlapping FFTs, log-spaced bands with peak hold.
+class SpectrumAnalyzer {
+public:
+    explicit SpectrumAnalyzer(std::shared_ptr<AudioTap> tap);
+
+    // Drains the tap and runs one FFT per completed hop, returns true if the display changed
+    bool update();
+    void render();
+
+private:
+    static constexpr int FFT_SIZE = 2048;
+    static constexpr int HOP_SIZE = FFT_SIZE / 2;
+    static constexpr int SCOPE_SIZE = 512;
+    static constexpr int NUM_BANDS = 96;
+    static constexpr float FLOOR_DB = -100.0f;
+    static constexpr float PEAK_HOLD_SECONDS = 1.0f;
+    static constexpr float PEAK_FALL_DB = 1.5f;
+
+    std::shared_ptr<AudioTap> tap;
+
+    // Circular history of the last FFT_SIZE samples
+    std::vector<float> history;
+    int historyPos = 0;
+    int samplesSinceFft = 0;
+
+    std::vector<float> window;
+    float windowGain = 1.0f;
+    std::vector<std::complex<float>> fftBuffer;
+
+    std::vector<float> bandLevels;
+    std::vector<float> peakLevels;
+    // FFTs since each peak was set
+    std::vector<int> peakAge;
+
+    std::vector<float> scope;
+    std::vector<float> readBuffer;
+    bool displayAtFloor = true;
+
+    void computeSpectrum();
+    static void fft(std::vector<std::complex<float>>& data);
+};
+
+#endif //SPECTRUMANALYZER_H
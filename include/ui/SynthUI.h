@@ -4,12 +4,29 @@
 #include <functional>
 
 #include "../audio/SynthetizerConfig.h"
+#include "../audio/AudioTap.h"
+#include "../audio/FmBank.h"
+#include "../audio/LevelMeter.h"
+#include "../audio/Lfo.h"
+#include "../audio/ModMatrix.h"
+#include "SpectrumAnalyzer.h"
 #include <SDL3/SDL.h>
 #include <memory>
 
+struct UiOptions {
+    // Let the renderer wait for the display refresh
+    bool vsync = true;
+    // Upper bound on redraws per second, 0 = uncapped
+    int maxFps = 60;
+    // Sleep in SDL_WaitEventTimeout and only redraw on input or new data from the audio side
+    bool idleWhenUnchanged = true;
+};
+
 class SynthUI {
 public:
-    SynthUI(std::shared_ptr<SynthetizerConfig> synthParams);
+    // Tap and meters are optional, without them the analyzer and meters are not shown
+    SynthUI(std::shared_ptr<SynthetizerConfig> synthParams, const UiOptions& options = UiOptions(),
+            std::shared_ptr<AudioTap> audioTap = nullptr, std::shared_ptr<OutputMeters> meters = nullptr);
     ~SynthUI();
 
     void initialize();
@@ -25,16 +42,41 @@ private:
     int currentOctave;
     bool keyStates[13];
     bool isInitialized = false;
+    UiOptions options;
+    std::unique_ptr<SpectrumAnalyzer> analyzer;
+    std::shared_ptr<OutputMeters> meters;
+
+    // ImGui needs a few frames after an input to settle hover/active states
+    int framesToRedraw = 0;
+    unsigned lastDisplayVersion = 0;
+
+    // UI thread CPU usage, updated about once per second
+    double cpuWindowStart = 0.0;
+    double cpuAtWindowStart = 0.0;
+    int framesInWindow = 0;
+    float cpuPercent = 0.0f;
+    float framesPerSecond = 0.0f;
+    double runStart = 0.0;
+    double cpuAtRunStart = 0.0;
 
 
     static const char* noteNames[13];
 
     void renderOscillatorControls();
+    void renderFmControls();
     void renderEnvelopeControls();
     void renderFilterControls();
+    void renderLfoControls();
+    void renderModulationControls();
     void renderVolumeControl();
     void renderOctaveControl();
     void renderVirtualKeyboard();
+    void renderAnalyzer();
+    void renderMeters();
+    void renderUiStats();
+
+    bool needsRedraw();
+    void updateCpuUsage();
 
     float noteToFrequency(int note, int octave);
     void handleKeyboard(const SDL_Event& event);
@@ -1,21 +1,238 @@
 #include "include/audio/AudioEngine.h"
+#include "include/backend/AlsaMidiInput.h"
+#include "include/backend/AudioBackend.h"
+#include "include/backend/PortAudioBackend.h"
 #include "include/ui/SynthUI.h"
+#include <chrono>
+#include <cmath>
 #include <memory>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct AppOptions {
+    AudioSettings audio;
+    UiOptions ui;
+    // > 0: run without UI for this many seconds, holding a note (benchmarks, CI)
+    double headlessSeconds = 0.0;
+    // Initial oversampling factor of the patch
+    int oversampling = 1;
+    // WAV file played by oscillators set to SAMPLE, memory-mapped
+    std::string samplePath;
+    // Stream the sample through a background I/O thread instead of reading the mapping from the audio thread
+    bool streamSample = false;
+    // Standard MIDI file played from startup, optionally looped
+    std::string midiFile;
+    bool midiLoop = false;
+    // ALSA sequencer source to play live, "client:port"; "port" only creates the synth's input port
+    std::string alsaMidi;
+    // 0 keeps the patch default
+    int polyphony = 0;
+};
+
+// Reads the command line, e.g. "synth --host-api jack --sample-rate 48000 --buffer-size 64"
+static AppOptions parseOptions(int argc, char* argv[]) {
+    AppOptions options;
+    AudioSettings& settings = options.audio;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sample-rate" && hasValue) {
+            settings.sampleRate = std::stoi(argv[++i]);
+        } else if (arg == "--buffer-size" && hasValue) {
+            settings.framesPerBuffer = std::stoi(argv[++i]);
+        } else if (arg == "--device" && hasValue) {
+            settings.deviceIndex = std::stoi(argv[++i]);
+        } else if (arg == "--host-api" && hasValue) {
+            settings.hostApi = argv[++i];
+        } else if (arg == "--latency" && hasValue) {
+            // given in milliseconds on the command line
+            settings.suggestedLatency = std::stod(argv[++i]) / 1000.0;
+        } else if (arg == "--backend" && hasValue) {
+            settings.backend = argv[++i];
+        } else if (arg == "--free-run") {
+            settings.freeRun = true;
+        } else if (arg == "--rt-policy" && hasValue) {
+            std::string policy = argv[++i];
+            settings.realtime.policy = policy == "fifo" ? RealtimePolicy::FIFO
+                                     : policy == "rr" ? RealtimePolicy::RR
+                                     : RealtimePolicy::NONE;
+        } else if (arg == "--rt-priority" && hasValue) {
+            settings.realtime.priority = std::stoi(argv[++i]);
+        } else if (arg == "--cpus" && hasValue) {
+            // comma separated list, e.g. "2,3"
+            std::stringstream list(argv[++i]);
+            std::string cpu;
+            while (std::getline(list, cpu, ',')) {
+                settings.realtime.cpus.push_back(std::stoi(cpu));
+            }
+        } else if (arg == "--mlock") {
+            settings.realtime.lockMemory = true;
+        } else if (arg == "--ui-fps" && hasValue) {
+            options.ui.maxFps = std::stoi(argv[++i]);
+        } else if (arg == "--no-vsync") {
+            options.ui.vsync = false;
+        } else if (arg == "--ui-always-redraw") {
+            options.ui.idleWhenUnchanged = false;
+        } else if (arg == "--oversample" && hasValue) {
+            options.oversampling = std::stoi(argv[++i]);
+        } else if (arg == "--sample" && hasValue) {
+            options.samplePath = argv[++i];
+        } else if (arg == "--midi-file" && hasValue) {
+            options.midiFile = argv[++i];
+        } else if (arg == "--midi-loop") {
+            options.midiLoop = true;
+        } else if (arg == "--alsa-midi" && hasValue) {
+            options.alsaMidi = argv[++i];
+        } else if (arg == "--polyphony" && hasValue) {
+            options.polyphony = std::stoi(argv[++i]);
+        } else if (arg == "--stream-sample") {
+            options.streamSample = true;
+        } else if (arg == "--headless" && hasValue) {
+            options.headlessSeconds = std::stod(argv[++i]);
+        }
+    }
+    if (settings.sampleRate <= 0 || settings.framesPerBuffer <= 0) {
+        std::cerr << "Invalid sample rate or buffer size" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return options;
+}
 
 int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--list-devices") {
+            PortAudioBackend::listDevices();
+            return 0;
+        }
+    }
+    AppOptions options = parseOptions(argc, argv);
 
     // Create shared parameters
     auto synthParams = std::make_shared<SynthetizerConfig>();
+    synthParams->oversampling = options.oversampling;
+    if (options.polyphony > 0) {
+        synthParams->polyphony = options.polyphony;
+    }
 
-    // Initialize audio engine
+    // Initialize audio engine and the driver that pulls from it
     AudioEngine audioEngine(synthParams);
-    audioEngine.initialize();
+    std::shared_ptr<SampleStreamer> sampleStreamer;
+    if (!options.samplePath.empty()) {
+        std::shared_ptr<SampleData> sample = SampleData::loadWav(options.samplePath);
+        if (!sample) {
+            return EXIT_FAILURE;
+        }
+        if (options.streamSample) {
+            sampleStreamer = std::make_shared<SampleStreamer>();
+        }
+        audioEngine.setSample(sample, sampleStreamer);
+        if (sampleStreamer) {
+            sampleStreamer->start();
+        }
+    }
+    if (!options.midiFile.empty()) {
+        std::vector<MidiFileEvent> events;
+        MidiFileInfo info;
+        if (!loadMidiFile(options.midiFile, events, &info)) {
+            return EXIT_FAILURE;
+        }
+        std::cout << "Playing " << options.midiFile << ": " << info.notes << " notes, " << info.seconds
+                  << " s, up to " << info.maxPolyphony << " notes at once" << std::endl;
+        audioEngine.setMidiPlayer(std::make_shared<MidiPlayer>(std::move(events), options.midiLoop, info.seconds));
+    }
+#ifdef SYNTH_HAVE_ALSA
+    std::unique_ptr<AlsaMidiInput> alsaMidiInput;
+    if (!options.alsaMidi.empty()) {
+        auto midiInput = std::make_shared<MidiInputQueue>();
+        alsaMidiInput = std::make_unique<AlsaMidiInput>(midiInput);
+        if (!alsaMidiInput->open(options.alsaMidi == "port" ? "" : options.alsaMidi)) {
+            return EXIT_FAILURE;
+        }
+        audioEngine.setMidiInput(midiInput);
+    }
+#else
+    if (!options.alsaMidi.empty()) {
+        std::cerr << "--alsa-midi needs a Linux build with ALSA" << std::endl;
+        return EXIT_FAILURE;
+    }
+#endif
+    // Output copy for the UI's oscilloscope and spectrum analyzer
+    auto audioTap = std::make_shared<AudioTap>();
+    if (options.headlessSeconds <= 0.0) {
+        audioEngine.setAudioTap(audioTap);
+    }
+    // Level meters for the UI and the headless stats, loudness on its own thread
+    auto meters = std::make_shared<OutputMeters>();
+    auto loudnessMeter = std::make_shared<LoudnessMeter>(meters);
+    audioEngine.setMeters(meters, loudnessMeter);
+    loudnessMeter->start();
+    std::unique_ptr<AudioBackend> audioBackend = createAudioBackend(audioEngine, options.audio);
+    audioBackend->open(options.audio);
+
+    // DSP memory is allocated by open(), lock it before the first callback
+    if (options.audio.realtime.lockMemory) {
+        RealtimeReport memoryReport;
+        lockProcessMemory(memoryReport);
+        printRealtimeReport(memoryReport);
+    }
+
+    audioBackend->start();
+#ifdef SYNTH_HAVE_ALSA
+    if (alsaMidiInput) {
+        alsaMidiInput->start(options.audio.realtime);
+    }
+#endif
+    std::cout << "Audio engine initialized successfully! (" << audioBackend->getName() << ")" << std::endl;
+
+    // The audio thread applies its scheduling on the first callback, wait briefly for its report
+    for (int i = 0; i < 100 && !audioBackend->getRealtimeReport(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (const RealtimeReport* report = audioBackend->getRealtimeReport()) {
+        printRealtimeReport(*report);
+    }
+
+    if (options.headlessSeconds > 0.0) {
+        // Keep the whole voice chain busy: three oscillators on a held note, or on the MIDI file's notes
+        synthParams->osc1_enabled = true;
+        synthParams->osc2_enabled = true;
+        synthParams->osc3_enabled = true;
+        if (options.midiFile.empty()) {
+            synthParams->noteNumber = 0;
+        }
+        std::this_thread::sleep_for(std::chrono::duration<double>(options.headlessSeconds));
 
-    // Initialize UI
-    SynthUI synthUI(synthParams);
-    synthUI.initialize();
-    synthUI.run();
+        auto toDb = [](float level) { return level > 0.0f ? 20.0f * std::log10(level) : -INFINITY; };
+        int activeVoices = 0;
+        for (const std::atomic<float>& level : meters->voiceLevels) {
+            activeVoices += level.load() > 0.0f ? 1 : 0;
+        }
+        std::cout << "Voices: " << activeVoices << " of " << synthParams->polyphony.load() << " active" << std::endl;
+        std::cout << "Output: peak " << toDb(std::max(meters->peakLeft.load(), meters->peakRight.load()))
+                  << " dB, rms " << toDb(std::max(meters->rmsLeft.load(), meters->rmsRight.load()))
+                  << " dB, integrated " << meters->integratedLufs.load() << " LUFS, "
+                  << meters->clippedSamples.load() << " clipped samples" << std::endl;
+    } else {
+        // Initialize UI
+        SynthUI synthUI(synthParams, options.ui, audioTap, meters);
+        synthUI.initialize();
+        synthUI.run();
+    }
 
+#ifdef SYNTH_HAVE_ALSA
+    if (alsaMidiInput) {
+        alsaMidiInput->close();
+    }
+#endif
+    audioBackend->close();
+    loudnessMeter->stop();
+    std::cout << "Voices: peak " << audioEngine.getPeakVoices() << " of " << synthParams->polyphony.load()
+              << ", " << audioEngine.getVoiceSteals() << " stolen" << std::endl;
+    if (sampleStreamer) {
+        sampleStreamer->stop();
+        printStreamStats(sampleStreamer->getStats());
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -4,157 +4,536 @@
 
 #include "../../include/audio/AudioEngine.h"
 
-#include <iostream>
+#include <algorithm>
+#include <climits>
 
+#include "../../include/audio/Pitch.h"
 
-AudioEngine::AudioEngine(std::shared_ptr<SynthetizerConfig> p ) : stream(nullptr),params(p) {}
-AudioEngine::~AudioEngine() {
-    shutdown();
+
+AudioEngine::AudioEngine(std::shared_ptr<SynthetizerConfig> p ) : params(p) {
+    prepare(DEFAULT_SAMPLE_RATE, DEFAULT_FRAMES_PER_BUFFER);
 }
 
-void AudioEngine::initialize() {
-    // Initialize PortAudio
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        std::cerr << "PortAudio error in Pa_Initialize(): " << Pa_GetErrorText(err) << std::endl;
-        std::exit(EXIT_FAILURE);
-    }
+void AudioEngine::prepare(int sampleRate, int maxBlockSize) {
+    this->sampleRate = sampleRate;
+    this->maxBlockSize = std::max(maxBlockSize, 1);
 
-    Pa_OpenDefaultStream(&stream,
-                     0,
-                     2,
-                     paFloat32,
-                     SAMPLE_RATE,
-                     FRAMES_PER_BUFFER,
-                     audioCallback,
-                     this);
+    // First pass sizes the arena, the second hands out its memory
+    arena.beginLayout();
+    allocateState();
+    arena.commit();
+    allocateState();
+    oversampler.prepare();
 
-    if (err != paNoError) {
-        std::cerr << "PortAudio open failed: " << Pa_GetErrorText(err) << std::endl;
-        std::exit(EXIT_FAILURE);
+    tapDecimation = std::max(1, (sampleRate + AUDIO_TAP_MAX_RATE - 1) / AUDIO_TAP_MAX_RATE);
+    tapCounter = 0;
+    tapAccumulator = 0.0f;
+    if (audioTap) {
+        audioTap->sampleRate.store(static_cast<float>(sampleRate) / tapDecimation);
     }
-
-    // Start stream immediately
-    err = Pa_StartStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio start failed: " << Pa_GetErrorText(err) << std::endl;
-        std::exit(EXIT_FAILURE);
+    levelMeter.prepare(sampleRate);
+    if (loudnessMeter) {
+        loudnessMeter->setSampleRate(sampleRate);
     }
 
-    std::cout << "Audio engine initialized successfully!" << std::endl;
+    oversampling = params->oversampling.load() >= 4 ? 4 : params->oversampling.load() >= 2 ? 2 : 1;
+    for (Voice& voice : voices) {
+        voice.prepare(static_cast<float>(sampleRate * oversampling));
+    }
+    fmBank.prepare(static_cast<float>(sampleRate * oversampling));
+    lastNoteNumber = -1;
+    pendingCount = 0;
+    channelExpression.fill(VoiceExpression{});
+    channelModWheel.fill(0.0f);
+    for (Lfo& lfo : globalLfos) {
+        lfo.reset();
+    }
+    peakVoices = 0;
+    voiceSteals = 0;
 }
 
+// In the order a block uses them: events, FM operators, each voice, the mix and its decimation
+void AudioEngine::allocateState() {
+    const int maxChainFrames = maxBlockSize * MAX_OVERSAMPLING;
+    playerEvents = arena.allocate<MidiEvent>(MAX_BLOCK_EVENTS);
+    inputEvents = arena.allocate<MidiEvent>(MAX_BLOCK_EVENTS);
+    // Room for a whole block of expression from the host, the player and the live input
+    pendingExpression = arena.allocate<MidiEvent>(MAX_BLOCK_EVENTS * 3);
+    fmBank.allocate(arena, MAX_VOICES, maxChainFrames);
+    for (Voice& voice : voices) {
+        voice.allocate(arena, maxChainFrames);
+    }
+    mixBuffer = arena.allocate<float>(maxChainFrames * 2);
+    oversampler.allocate(arena, maxBlockSize);
+    voiceBuffer = arena.allocate<float>(maxBlockSize * 2);
+    tapBuffer = arena.allocate<float>(maxBlockSize);
+}
 
+void AudioEngine::setOversampling(int factor) {
+    factor = factor >= 4 ? 4 : factor >= 2 ? 2 : 1;
+    if (factor == oversampling) {
+        return;
+    }
+    oversampling = factor;
 
-void AudioEngine::shutdown() {
-    if (stream) {
-        Pa_CloseStream(stream);
-        stream = nullptr;
+    // The envelopes keep their state so a switch during a note does not cut it
+    float chainRate = static_cast<float>(sampleRate * factor);
+    for (Voice& voice : voices) {
+        voice.setChainRate(chainRate);
     }
-    Pa_Terminate();
+    fmBank.setSampleRate(chainRate);
+    oversampler.reset();
 }
 
-int AudioEngine::audioCallback(const void* inputBuffer, void* outputBuffer,
-                              unsigned long framesPerBuffer,
-                              const PaStreamCallbackTimeInfo* timeInfo,
-                              PaStreamCallbackFlags statusFlags,
-                              void* userData) {
-    AudioEngine* engine = static_cast<AudioEngine*>(userData);
-    float* output = static_cast<float*>(outputBuffer);
-
-    engine->processAudio(output, framesPerBuffer);
-    return paContinue;
+// noteOn() only picks voices below the limit; when it drops, the notes held above it are released
+// so they fade out over the release time instead of sounding on
+void AudioEngine::limitPolyphony(int polyphony) {
+    polyphony = std::clamp(polyphony, 1, MAX_VOICES);
+    for (int v = polyphony; v < MAX_VOICES; ++v) {
+        if (voices[v].isHeld()) {
+            voices[v].noteOff();
+        }
+    }
 }
 
 void AudioEngine::processAudio(float* outputBuffer, int numFrames) {
+    processAudio(outputBuffer, numFrames, nullptr, 0);
+}
 
-    // Clear the stereo output buffer (L+R channels, so numFrames * 2 samples)
-    std::fill_n(outputBuffer, numFrames * 2, 0.0f);
-    // Clear the internal mixing buffer
-    std::fill(mixBuffer.begin(), mixBuffer.end(), 0.0f);
-
-    static int lastNoteNumber = -1;
+void AudioEngine::processAudio(float* outputBuffer, int numFrames, const MidiEvent* events, size_t eventCount) {
     int currentNote = params->noteNumber.load();
 
-    // If the note number changed since the last callback
+    // The on-screen keyboard plays one note at a time: a new key releases the previous one
     if (currentNote != lastNoteNumber) {
+        if (lastNoteNumber >= 0) {
+            noteOff(lastNoteNumber);
+        }
         if (currentNote >= 0) {
             noteOn(currentNote);
-        } else {
-            noteOff();
         }
         // Remember this note for next time
         lastNoteNumber = currentNote;
     }
-    float noteFreq = params->note_frequency.load();
 
+    size_t playerCount = 0;
+    if (midiPlayer) {
+        playerCount = midiPlayer->nextBlock(numFrames, sampleRate, playerEvents.data(), playerEvents.size());
+    }
+    size_t inputCount = 0;
+    if (midiInput) {
+        inputCount = midiInput->nextBlock(numFrames, sampleRate, inputEvents.data(), inputEvents.size());
+    }
 
-    if (params->osc1_enabled.load()) {
-        float freq = noteFreq + params->osc1_freq_offset.load();
-        oscillators[0].generateBuffer(
-            osc1Buffer.data(), numFrames,
-            static_cast<WaveformType>(params->osc1_waveform.load()),
-            freq
-        );
-        for (int i = 0; i < numFrames * 2; ++i) {
-            mixBuffer[i] += osc1Buffer[i];
+    // Merge the host's, the file player's and the live input's events, rendering up to each one.
+    // On equal frames the host goes first, then the player, then the live input.
+    const MidiEvent* sources[3] = {events, playerEvents.data(), inputEvents.data()};
+    const size_t counts[3] = {eventCount, playerCount, inputCount};
+    size_t indices[3] = {0, 0, 0};
+    int frame = 0;
+    while (true) {
+        int next = -1;
+        for (int s = 0; s < 3; ++s) {
+            if (indices[s] < counts[s]
+                && (next < 0 || sources[s][indices[s]].frame < sources[next][indices[next]].frame)) {
+                next = s;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        const MidiEvent& event = sources[next][indices[next]++];
+        int eventFrame = std::min(static_cast<int>(event.frame), numFrames);
+        if (isExpressionEvent(event)) {
+            // Voices step their expression once per control block anyway: renderBlock() applies it on its
+            // control grid, so thousands of events per second never cut the block into tiny spans
+            queueExpression(event, eventFrame - frame);
+            continue;
         }
+        if (eventFrame > frame) {
+            renderFrames(outputBuffer + frame * 2, eventFrame - frame);
+            frame = eventFrame;
+        }
+        // Expression sent before this event reaches the voices first, a new note starts with it
+        applyExpression(INT_MAX);
+        processMidi(event.data, event.size);
     }
+    renderFrames(outputBuffer + frame * 2, numFrames - frame);
+}
 
-    if (params->osc2_enabled.load()) {
-        float freq = noteFreq + params->osc2_freq_offset.load();
-        oscillators[1].generateBuffer(
-            osc2Buffer.data(), numFrames,
-            static_cast<WaveformType>(params->osc2_waveform.load()),
-            freq
-        );
-        for (int i = 0; i < numFrames * 2; ++i) {
-            mixBuffer[i] += osc2Buffer[i];
-        }
+void AudioEngine::renderFrames(float* outputBuffer, int numFrames) {
+    // Hosts may deliver more frames than the buffers were sized for, so render in chunks
+    while (numFrames > 0) {
+        int chunk = std::min(numFrames, maxBlockSize);
+        renderBlock(outputBuffer, chunk);
+        outputBuffer += chunk * 2;
+        numFrames -= chunk;
     }
+}
+
+void AudioEngine::renderBlock(float* outputBuffer, int numFrames) {
+    // Only changes at block boundaries, so one patch setting applies to a whole block
+    setOversampling(params->oversampling.load());
+    limitPolyphony(params->polyphony.load());
+    const int chainFrames = numFrames * oversampling;
 
-    if (params->osc3_enabled.load()) {
-        float freq = noteFreq + params->osc3_freq_offset.load();
-        oscillators[2].generateBuffer(
-            osc3Buffer.data(), numFrames,
-            static_cast<WaveformType>(params->osc3_waveform.load()),
-            freq
-        );
-        for (int i = 0; i < numFrames * 2; ++i) {
-            mixBuffer[i] += osc3Buffer[i];
+    // Clear the internal mixing buffer (L+R channels, so chainFrames * 2 samples)
+    std::fill_n(mixBuffer.begin(), chainFrames * 2, 0.0f);
+
+    // Silent voices cost nothing
+    int activeVoices = 0;
+    for (Voice& voice : voices) {
+        activeVoices += voice.isActive() ? 1 : 0;
+    }
+    peakVoices = std::max(peakVoices, activeVoices);
+
+    const int controlFrames = CONTROL_BLOCK_FRAMES * oversampling;
+    modMatrix.setRoutings(*params);
+    for (int i = 0; i < NUM_LFOS; ++i) {
+        lfoSettings[i] = readLfoSettings(*params, i);
+    }
+    // The filter's LFO depth is a fixed LFO 1 route beside the matrix
+    const float filterLfoDepth = params->filter_auto_amount.load() * FILTER_LFO_DEPTH_HZ;
+    fmSettings = readFmSettings(*params);
+    const bool fm = fmSettings.algorithm != FmAlgorithm::OFF;
+    if (!modMatrix.isActive() && filterLfoDepth == 0.0f) {
+        // Nothing reads the LFOs: global ones keep their phase running, voices render in one call
+        for (int i = 0; i < NUM_LFOS; ++i) {
+            globalLfos[i].advance(lfoSettings[i], numFrames, static_cast<float>(sampleRate));
+        }
+        // In one call, or split only at the control block boundaries where queued expression is due
+        for (int frame = 0; frame < numFrames;) {
+            applyExpression(frame);
+            const int end = nextExpressionBoundary(frame, numFrames);
+            const int spanFrames = (end - frame) * oversampling;
+            if (fm) {
+                renderFm(spanFrames, false);
+            }
+            for (int v = 0; v < MAX_VOICES; ++v) {
+                if (voices[v].isActive()) {
+                    voices[v].render(*params, mixBuffer.data() + frame * oversampling * 2, spanFrames,
+                                     controlFrames, {}, fm ? fmBank.getOutput(v) : nullptr);
+                }
+            }
+            frame = end;
+        }
+    } else {
+        // The LFOs and the matrix run once per control block for all voices, each voice glides to its result
+        const float* filterLfoRow = modMatrix.sourceRow(ModSource::LFO1);
+        for (int frame = 0; frame < numFrames; frame += CONTROL_BLOCK_FRAMES) {
+            int frames = std::min(CONTROL_BLOCK_FRAMES, numFrames - frame);
+            applyExpression(frame);
+            evaluateModulation(frames);
+            if (fm) {
+                renderFm(frames * oversampling, true);
+            }
+            for (int v = 0; v < MAX_VOICES; ++v) {
+                if (voices[v].isActive()) {
+                    VoiceModulation modulation = modMatrix.getVoice(v);
+                    modulation.cutoffHz = filterLfoRow[v] * filterLfoDepth;
+                    voices[v].render(*params, mixBuffer.data() + frame * oversampling * 2, frames * oversampling,
+                                     controlFrames, modulation, fm ? fmBank.getOutput(v) : nullptr);
+                }
+            }
         }
     }
 
-    envelope.setAttackTime(params->attack_time.load());
-    envelope.setReleaseTime(params->release_time.load());
-    envelope.processBuffer(mixBuffer.data(), numFrames);
+    // Events due after the last boundary apply at the next block's first
+    for (size_t i = 0; i < pendingCount; ++i) {
+        MidiEvent& event = pendingExpression[i];
+        event.frame = event.frame > static_cast<uint32_t>(numFrames) ? event.frame - numFrames : 0;
+    }
 
-    filter.processBuffer(
-        mixBuffer.data(), numFrames,
-        params->filter_cutoff.load(),
-        params->filter_auto_amount.load(),
-        params->filter_auto_freq.load(),
-        params->filter_resonance.load()
-    );
+    // Back to the output rate (a plain copy at 1x), once for the sum of all voices
+    oversampler.downsample(mixBuffer.data(), voiceBuffer.data(), numFrames, oversampling);
 
     float volume = params->volume.load();
     for (int i = 0; i < numFrames * 2; ++i) {
-        outputBuffer[i] = mixBuffer[i] * volume;
+        outputBuffer[i] = voiceBuffer[i] * volume;
+    }
+
+    if (audioTap) {
+        writeTap(outputBuffer, numFrames);
+    }
+    if (meters) {
+        updateMeters(outputBuffer, numFrames);
+    }
+}
+
+void AudioEngine::evaluateModulation(int numFrames) {
+    // Sampled at the end of the control block: the voices glide to these values over it.
+    // A global LFO is computed here once, a per-voice one by every sounding voice.
+    float* lfoRows[NUM_LFOS] = {modMatrix.sourceRow(ModSource::LFO1), modMatrix.sourceRow(ModSource::LFO2)};
+    const float rate = static_cast<float>(sampleRate);
+    for (int i = 0; i < NUM_LFOS; ++i) {
+        if (!lfoSettings[i].perVoice) {
+            std::fill_n(lfoRows[i], MAX_VOICES, globalLfos[i].advance(lfoSettings[i], numFrames, rate));
+            continue;
+        }
+        for (int v = 0; v < MAX_VOICES; ++v) {
+            lfoRows[i][v] = voices[v].isActive() ? voices[v].advanceLfo(i, lfoSettings[i], numFrames, rate) : 0.0f;
+        }
     }
+
+    float* envelopeRow = modMatrix.sourceRow(ModSource::ENVELOPE);
+    float* velocityRow = modMatrix.sourceRow(ModSource::VELOCITY);
+    float* pressureRow = modMatrix.sourceRow(ModSource::PRESSURE);
+    float* timbreRow = modMatrix.sourceRow(ModSource::TIMBRE);
+    float* bendRow = modMatrix.sourceRow(ModSource::BEND);
+    float* modWheelRow = modMatrix.sourceRow(ModSource::MOD_WHEEL);
+    for (int v = 0; v < MAX_VOICES; ++v) {
+        const Voice& voice = voices[v];
+        const VoiceExpression& expression = voice.getExpression();
+        envelopeRow[v] = voice.getLevel();
+        velocityRow[v] = voice.getVelocity();
+        pressureRow[v] = expression.pressure;
+        timbreRow[v] = expression.timbre;
+        bendRow[v] = expression.bend;
+        modWheelRow[v] = channelModWheel[voice.getChannel()];
+    }
+    modMatrix.evaluate();
 }
 
-void AudioEngine::noteOn(int noteNumber) {
-    float baseFreq = 220.0f;
-    int octave = params->octave.load();
-    float frequency = baseFreq * std::pow(2.0f, (octave + noteNumber / 12.0f));
+void AudioEngine::renderFm(int chainFrames, bool modulated) {
+    const float* pitchRow = modMatrix.destinationRow(ModDestination::PITCH);
+    for (int v = 0; v < MAX_VOICES; ++v) {
+        fmActive[v] = voices[v].isActive();
+        if (fmActive[v]) {
+            float pitch = voices[v].getPitch(*params) + (modulated ? pitchRow[v] : 0.0f);
+            fmBank.setFrequency(v, semitonesToFrequency(pitch));
+        }
+    }
+    fmBank.render(fmSettings, chainFrames, fmActive.data());
+}
+
+void AudioEngine::setMeters(std::shared_ptr<OutputMeters> meters, std::shared_ptr<LoudnessMeter> loudness) {
+    this->meters = meters;
+    loudnessMeter = loudness;
+    if (loudnessMeter) {
+        loudnessMeter->setSampleRate(sampleRate);
+    }
+}
+
+void AudioEngine::updateMeters(const float* outputBuffer, int numFrames) {
+    levelMeter.process(outputBuffer, numFrames, *meters);
+    float voiceLevel = 0.0f;
+    for (int i = 0; i < MAX_VOICES; ++i) {
+        const float level = voices[i].getLevel();
+        meters->voiceLevels[i].store(level, std::memory_order_relaxed);
+        voiceLevel = std::max(voiceLevel, level);
+    }
+
+    if (loudnessMeter) {
+        loudnessMeter->push(outputBuffer, numFrames);
+    }
+
+    // Meters move while anything is audible or still falling
+    if (voiceLevel > 0.0f || meters->peakLeft.load(std::memory_order_relaxed) > 0.0f
+        || meters->peakRight.load(std::memory_order_relaxed) > 0.0f) {
+        params->display_version.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void AudioEngine::setAudioTap(std::shared_ptr<AudioTap> tap) {
+    audioTap = tap;
+    audioTap->sampleRate.store(static_cast<float>(sampleRate) / tapDecimation);
+}
 
-    params->note_frequency.store(frequency);
+// Mono, decimated copy of the block; one pass over the output and a single ring write
+void AudioEngine::writeTap(const float* outputBuffer, int numFrames) {
+    int count = 0;
+    float scale = 0.5f / tapDecimation;
+    for (int i = 0; i < numFrames; ++i) {
+        tapAccumulator += outputBuffer[i * 2] + outputBuffer[i * 2 + 1];
+        if (++tapCounter == tapDecimation) {
+            tapBuffer[count++] = tapAccumulator * scale;
+            tapAccumulator = 0.0f;
+            tapCounter = 0;
+        }
+    }
+    audioTap->ring.push(tapBuffer.data(), count);
+}
+
+void AudioEngine::processMidi(const uint8_t* data, size_t size) {
+    if (size < 2) {
+        return;
+    }
+    uint8_t status = data[0] & 0xF0;
+    int channel = data[0] & 0x0F;
+    // Channel pressure is the only handled two-byte message
+    if (status != 0xD0 && size < 3) {
+        return;
+    }
+    int note = data[1];
+    int velocity = status == 0xD0 ? 0 : data[2];
+    VoiceExpression& expression = channelExpression[channel];
+
+    if (status == 0x90 && velocity > 0) {
+        noteOn(note - MIDI_NOTE_BASE, velocity / 127.0f, channel);
+    } else if (status == 0x80 || status == 0x90) {
+        noteOff(note - MIDI_NOTE_BASE, channel);
+    } else if (status == 0xA0) {
+        // Polyphonic key pressure: this note only
+        for (Voice& voice : voices) {
+            if (voice.isActive() && voice.getChannel() == channel && voice.getNote() == note - MIDI_NOTE_BASE) {
+                voice.setPressure(velocity / 127.0f);
+            }
+        }
+    } else if (status == 0xD0) {
+        expression.pressure = note / 127.0f;
+        updateChannelExpression(channel);
+    } else if (status == 0xE0) {
+        // 14 bits centered on 8192
+        expression.bend = static_cast<float>(((velocity << 7) | note) - 8192) / 8192.0f;
+        updateChannelExpression(channel);
+    } else if (status == 0xB0 && note == 74) {
+        expression.timbre = std::clamp((velocity - 64) / 63.0f, -1.0f, 1.0f);
+        updateChannelExpression(channel);
+    } else if (status == 0xB0 && note == 1) {
+        channelModWheel[channel] = velocity / 127.0f;
+    } else if (status == 0xB0 && note == 121) {
+        // Reset all controllers
+        expression = VoiceExpression{};
+        channelModWheel[channel] = 0.0f;
+        updateChannelExpression(channel);
+    } else if (status == 0xB0 && (note == 120 || note == 123)) {
+        // All sound off / all notes off
+        noteOff();
+    }
+}
+
+bool AudioEngine::isExpressionEvent(const MidiEvent& event) {
+    uint8_t status = event.data[0] & 0xF0;
+    return status == 0xA0 || status == 0xD0 || status == 0xE0
+        || (status == 0xB0 && event.size >= 2 && event.data[1] == 74);
+}
+
+void AudioEngine::queueExpression(const MidiEvent& event, int frame) {
+    if (pendingCount == pendingExpression.size()) {
+        // Full: the oldest changes apply now rather than being dropped
+        applyExpression(INT_MAX);
+    }
+    pendingExpression[pendingCount] = event;
+    pendingExpression[pendingCount].frame = static_cast<uint32_t>(std::max(frame, 0));
+    ++pendingCount;
+}
+
+// Queued in frame order, so the due ones are a prefix
+void AudioEngine::applyExpression(int frame) {
+    size_t due = 0;
+    while (due < pendingCount && static_cast<int64_t>(pendingExpression[due].frame) <= frame) {
+        processMidi(pendingExpression[due].data, pendingExpression[due].size);
+        ++due;
+    }
+    if (due > 0) {
+        std::copy(pendingExpression.begin() + due, pendingExpression.begin() + pendingCount,
+                  pendingExpression.begin());
+        pendingCount -= due;
+    }
+}
+
+int AudioEngine::nextExpressionBoundary(int frame, int numFrames) const {
+    if (pendingCount == 0) {
+        return numFrames;
+    }
+    const int due = static_cast<int>(std::min<uint32_t>(pendingExpression[0].frame, numFrames));
+    const int boundary = (due + CONTROL_BLOCK_FRAMES - 1) / CONTROL_BLOCK_FRAMES * CONTROL_BLOCK_FRAMES;
+    return std::min(std::max(boundary, frame + CONTROL_BLOCK_FRAMES), numFrames);
+}
+
+void AudioEngine::updateChannelExpression(int channel) {
+    const VoiceExpression& expression = channelExpression[channel];
+    for (Voice& voice : voices) {
+        if (voice.isActive() && voice.getChannel() == channel) {
+            voice.setBend(expression.bend);
+            voice.setPressure(expression.pressure);
+            voice.setTimbre(expression.timbre);
+        }
+    }
+}
+
+void AudioEngine::setMidiPlayer(std::shared_ptr<MidiPlayer> player) {
+    midiPlayer = player;
+}
+
+void AudioEngine::setMidiInput(std::shared_ptr<MidiInputQueue> input) {
+    midiInput = input;
+}
+
+void AudioEngine::setTransportState(bool rolling, float bpm) {
+    if (rolling != params->transport_rolling.load(std::memory_order_relaxed)
+        || bpm != params->tempo_bpm.load(std::memory_order_relaxed)) {
+        params->transport_rolling.store(rolling, std::memory_order_relaxed);
+        params->tempo_bpm.store(bpm, std::memory_order_relaxed);
+        params->display_version.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void AudioEngine::noteOn(int noteNumber, float velocity, int channel) {
+    float pitch = static_cast<float>(params->octave.load() * 12 + noteNumber);
+    params->note_frequency.store(semitonesToFrequency(pitch));
     params->note_on.store(true);
 
-    envelope.noteOn();
+    // Same key again: retrigger its voice. Else a free voice, else the oldest released one, else the oldest
+    int polyphony = std::clamp(params->polyphony.load(), 1, MAX_VOICES);
+    Voice* target = nullptr;
+    for (int i = 0; i < polyphony && !target; ++i) {
+        if (voices[i].isActive() && voices[i].getNote() == noteNumber && voices[i].getChannel() == channel) {
+            target = &voices[i];
+        }
+    }
+    for (int i = 0; i < polyphony && !target; ++i) {
+        if (!voices[i].isActive()) {
+            target = &voices[i];
+        }
+    }
+    if (!target) {
+        target = &voices[0];
+        for (int i = 1; i < polyphony; ++i) {
+            bool releasedFirst = !voices[i].isHeld() && target->isHeld();
+            bool sameKind = voices[i].isHeld() == target->isHeld();
+            if (releasedFirst || (sameKind && voices[i].getAge() < target->getAge())) {
+                target = &voices[i];
+            }
+        }
+        ++voiceSteals;
+    }
+    target->noteOn(noteNumber, channel, pitch, velocity, ++noteCounter, channelExpression[channel]);
+    fmBank.reset(static_cast<int>(target - voices.data()));
+}
+
+void AudioEngine::noteOff(int noteNumber, int channel) {
+    for (Voice& voice : voices) {
+        if (voice.isHeld() && voice.getNote() == noteNumber && voice.getChannel() == channel) {
+            voice.noteOff();
+        }
+    }
 }
 
 void AudioEngine::noteOff() {
     params->note_on.store(false);
-    envelope.noteOff();
+    for (Voice& voice : voices) {
+        if (voice.isHeld()) {
+            voice.noteOff();
+        }
+    }
+}
+
+void AudioEngine::setNoiseSeed(uint32_t seed) {
+    for (size_t v = 0; v < voices.size(); ++v) {
+        voices[v].setSeed(seed + static_cast<uint32_t>(v * 3));
+    }
+    for (size_t i = 0; i < globalLfos.size(); ++i) {
+        globalLfos[i].setSeed(seed * 31u + static_cast<uint32_t>(i) + 1u);
+    }
+}
+
+void AudioEngine::setSample(std::shared_ptr<const SampleData> sample, std::shared_ptr<SampleStreamer> streamer) {
+    this->sample = sample;
+    this->streamer = streamer;
+    for (Voice& voice : voices) {
+        voice.setSample(this->sample.get());
+        for (int i = 0; streamer && sample && i < 3; ++i) {
+            voice.setStream(i, streamer->createVoice(sample));
+        }
+    }
 }
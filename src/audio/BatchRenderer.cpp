@@ -0,0 +1,115 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/BatchRenderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#include "../../include/audio/Patch.h"
+
+std::vector<BatchJob> loadBatchJobs(const std::string& jobFile, const std::string& outputDir) {
+    std::vector<BatchJob> jobs;
+    std::ifstream file(jobFile);
+    if (!file) {
+        std::cerr << "Cannot open job list " << jobFile << std::endl;
+        return jobs;
+    }
+    const std::filesystem::path baseDir = std::filesystem::path(jobFile).parent_path();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        BatchJob job;
+        int velocity = 127;
+        if (!(fields >> job.patchPath >> job.request.midiNote >> velocity)) {
+            std::cerr << "Skipping malformed job: " << line << std::endl;
+            continue;
+        }
+        fields >> job.request.noteSeconds >> job.request.tailSeconds;
+        job.request.velocity = velocity / 127.0f;
+
+        std::filesystem::path patch(job.patchPath);
+        if (patch.is_relative()) {
+            job.patchPath = (baseDir / patch).string();
+        }
+        std::ostringstream name;
+        name << std::setw(5) << std::setfill('0') << jobs.size() << "_" << patch.stem().string()
+             << "_n" << job.request.midiNote << "_v" << velocity << ".wav";
+        job.outputPath = (std::filesystem::path(outputDir) / name.str()).string();
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+BatchReport runBatch(const std::vector<BatchJob>& jobs, const RenderFormat& format, int numThreads,
+                     const std::string& outputDir, std::vector<BatchResult>& results) {
+    BatchReport report;
+    report.jobs = static_cast<int>(jobs.size());
+    report.threads = numThreads > 0 ? numThreads : std::max(1u, std::thread::hardware_concurrency());
+    results.assign(jobs.size(), BatchResult());
+    std::filesystem::create_directories(outputDir);
+
+    // Each patch file is parsed once, jobs copy it into their own engine
+    std::map<std::string, std::unique_ptr<SynthetizerConfig>> patches;
+    for (const auto& job : jobs) {
+        auto& patch = patches[job.patchPath];
+        if (!patch) {
+            patch = std::make_unique<SynthetizerConfig>();
+            if (!loadPatch(job.patchPath, *patch)) {
+                patch.reset();
+                patches.erase(job.patchPath);
+            }
+        }
+    }
+
+    // The queue is an index into the job list, each worker takes the next job
+    std::atomic<size_t> nextJob{0};
+    auto worker = [&]() {
+        for (size_t i = nextJob.fetch_add(1); i < jobs.size(); i = nextJob.fetch_add(1)) {
+            auto patch = patches.find(jobs[i].patchPath);
+            if (patch == patches.end()) {
+                continue;
+            }
+            std::vector<float> audio = renderNote(*patch->second, jobs[i].request, format);
+            results[i].hash = hashSamples(audio);
+            results[i].audioSeconds = static_cast<double>(audio.size() / 2) / format.sampleRate;
+            results[i].ok = writeWav(jobs[i].outputPath, audio, format.sampleRate);
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < report.threads; ++t) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::ofstream index(std::filesystem::path(outputDir) / "index.txt");
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        report.audioSeconds += results[i].audioSeconds;
+        report.failed += results[i].ok ? 0 : 1;
+        index << std::filesystem::path(jobs[i].outputPath).filename().string() << " "
+              << jobs[i].patchPath << " " << jobs[i].request.midiNote << " "
+              << static_cast<int>(jobs[i].request.velocity * 127.0f + 0.5f) << " "
+              << std::hex << std::setw(16) << std::setfill('0') << results[i].hash << std::dec
+              << (results[i].ok ? "" : " FAILED") << "\n";
+    }
+    return report;
+}
@@ -0,0 +1,106 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/DspArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+DspArena::~DspArena() {
+    release();
+}
+
+void DspArena::beginLayout() {
+    release();
+    used = 0;
+}
+
+#if defined(_WIN32)
+
+static std::byte* mapPages(size_t bytes) {
+    return static_cast<std::byte*>(VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+}
+
+static void unmapPages(std::byte* memory, size_t) {
+    VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+static bool lockPages(std::byte* memory, size_t bytes) {
+    return VirtualLock(memory, bytes) != 0;
+}
+
+static void unlockPages(std::byte* memory, size_t bytes) {
+    VirtualUnlock(memory, bytes);
+}
+
+#else
+
+static std::byte* mapPages(size_t bytes) {
+    void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? nullptr : static_cast<std::byte*>(memory);
+}
+
+static void unmapPages(std::byte* memory, size_t bytes) {
+    munmap(memory, bytes);
+}
+
+static bool lockPages(std::byte* memory, size_t bytes) {
+    return mlock(memory, bytes) == 0;
+}
+
+static void unlockPages(std::byte* memory, size_t bytes) {
+    munlock(memory, bytes);
+}
+
+#endif
+
+void DspArena::commit() {
+    release();
+    // Pages are at least DSP_ARENA_ALIGNMENT aligned, every allocation keeps its offset's alignment
+    capacity = std::max<size_t>(used, DSP_ARENA_ALIGNMENT);
+    memory = mapPages(capacity);
+    if (!memory) {
+        std::cerr << "Cannot map " << capacity << " bytes for the DSP state" << std::endl;
+        capacity = 0;
+        throw std::bad_alloc();
+    }
+    lockedPages = lockPages(memory, capacity);
+    // Touches every page now rather than on the audio thread's first block
+    std::memset(memory, 0, capacity);
+    used = 0;
+}
+
+void* DspArena::take(size_t bytes) {
+    const size_t offset = (used + DSP_ARENA_ALIGNMENT - 1) / DSP_ARENA_ALIGNMENT * DSP_ARENA_ALIGNMENT;
+    used = offset + bytes;
+    if (!memory) {
+        return nullptr;
+    }
+    if (used > capacity) {
+        // The second pass asked for more than the first counted
+        std::cerr << "DSP arena overflow: " << used << " of " << capacity << " bytes" << std::endl;
+        throw std::bad_alloc();
+    }
+    return memory + offset;
+}
+
+void DspArena::release() {
+    if (memory) {
+        if (lockedPages) {
+            unlockPages(memory, capacity);
+        }
+        unmapPages(memory, capacity);
+    }
+    memory = nullptr;
+    capacity = 0;
+    lockedPages = false;
+}
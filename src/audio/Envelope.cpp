@@ -7,12 +7,22 @@
 #include <algorithm>
 #include <iostream>
 
+void Envelope::prepare(float sampleRate) {
+    this->sampleRate = sampleRate;
+    state = State::IDLE;
+    value = 0.0f;
+}
+
+void Envelope::setSampleRate(float sampleRate) {
+    this->sampleRate = sampleRate;
+}
+
 void Envelope::setAttackTime(float attackTime) {
-    attackRate = attackTime > 0.0f ? 1.0f / (attackTime * SAMPLE_RATE) : 1000.0f;
+    attackRate = attackTime > 0.0f ? 1.0f / (attackTime * sampleRate) : 1000.0f;
 }
 
 void Envelope::setReleaseTime(float releaseTime) {
-    releaseRate = releaseTime > 0.0f ? 1.0f / (releaseTime * SAMPLE_RATE) : 1000.0f;
+    releaseRate = releaseTime > 0.0f ? 1.0f / (releaseTime * sampleRate) : 1000.0f;
 }
 
 void Envelope::noteOn() {
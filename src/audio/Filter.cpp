@@ -9,11 +9,20 @@
 #include "../../include/audio/SynthetizerConfig.h"
 
 
+void Filter::prepare(float sampleRate) {
+    this->sampleRate = sampleRate;
+    x1_L = x2_L = y1_L = y2_L = 0.0f;
+    x1_R = x2_R = y1_R = y2_R = 0.0f;
+    // Coefficients depend on the sample rate, so recompute them on the next sample
+    lastCutoff = -1.0f;
+    lastResonance = -1.0f;
+}
+
 // Recalculates filter coefficients when the cutoff frequency changes
 // This is needed to adapt the filter behavior to the new frequency
 void Filter::updateCoefficients(float cutoff, float resonance) {
     float q = 0.5f / (1.0f - std::clamp(resonance, 0.0f, 0.99f));
-    float omega = 2.0f * M_PI * cutoff / SAMPLE_RATE;
+    float omega = 2.0f * M_PI * cutoff / sampleRate;
     float alpha = std::sin(omega) / (2.0f * q);
     float cosw = std::cos(omega);
     float norm = 1.0f / (1.0f + alpha);
@@ -26,24 +35,24 @@ void Filter::updateCoefficients(float cutoff, float resonance) {
 }
 
 
-// Applies the filter to a stereo audio buffer with optional LFO modulation
-void Filter::processBuffer(float* buffer, int numFrames, float baseCutoff,
-                           float autoAmount, float autoFreq, float resonance) {
-    float lfoIncrement = autoFreq / SAMPLE_RATE;
+// Applies the filter to a stereo audio buffer
+void Filter::processBuffer(float* buffer, int numFrames, float cutoff, float resonance) {
+    processBuffer(buffer, numFrames, cutoff, cutoff, resonance);
+}
 
-    static float lastCutoff = -1.0f;
+void Filter::processBuffer(float* buffer, int numFrames, float startCutoff, float endCutoff, float resonance) {
+    float cutoff = startCutoff;
+    const float cutoffStep = (endCutoff - startCutoff) / numFrames;
 
     for (int i = 0; i < numFrames * 2; i += 2) {
-        // Calculate the LFO modulation
-        float lfoValue = std::sin(2.0f * M_PI * lfoPhase);
-        float modulation = lfoValue * autoAmount * 5000.0f;
-        float currentCutoff = std::clamp(baseCutoff + modulation, 20.0f, 20000.0f);
+        float currentCutoff = std::clamp(cutoff, 20.0f, 20000.0f);
 
-        // Only update coefficients if the cutoff has changed by more than 100 Hz
+        // Only update coefficients if the cutoff has changed by more than 100 Hz (or the resonance changed)
         // This avoids unnecessary recalculations and keeps processing smooth
-        if (std::abs(currentCutoff - lastCutoff) > 100.0f) {
+        if (std::abs(currentCutoff - lastCutoff) > 100.0f || resonance != lastResonance) {
             updateCoefficients(currentCutoff, resonance);
             lastCutoff = currentCutoff;
+            lastResonance = resonance;
         }
 
         // Apply filter to left channel and update previous input/output history
@@ -64,8 +73,6 @@ void Filter::processBuffer(float* buffer, int numFrames, float baseCutoff,
         y1_R = outputR;
         buffer[i + 1] = outputR;
 
-        lfoPhase += lfoIncrement;
-        if (lfoPhase >= 1.0f)
-            lfoPhase -= 1.0f;
+        cutoff += cutoffStep;
     }
 }
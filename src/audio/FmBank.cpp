@@ -0,0 +1,213 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/FmBank.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <utility>
+
+#include "../../include/audio/Simd.h"
+
+// Peak of the carriers' sum, the oscillators' level
+constexpr float FM_OUTPUT_GAIN = 0.5f;
+
+// Operator count, the operators modulating each operator (bit m set: operator m modulates it) and
+// the operators summed to the output, numbered from 0 here
+struct FmTopology {
+    int operators;
+    std::array<unsigned, FM_OPERATORS> modulators;
+    unsigned carriers;
+};
+
+constexpr FmTopology FM_TOPOLOGIES[FM_ALGORITHM_COUNT] = {
+    {0, {}, 0u},
+    {2, {0b10u}, 0b1u},
+    {4, {0b10u, 0b100u, 0b1000u}, 0b1u},
+    {4, {0b10u, 0u, 0b1000u}, 0b101u},
+    {4, {0b1110u}, 0b1u},
+    {6, {0b10u, 0b100u, 0b1000u, 0b10000u, 0b100000u}, 0b1u},
+    {6, {0b10u, 0b100u, 0u, 0b10000u, 0b100000u}, 0b1001u},
+    {6, {0b10u, 0u, 0b1000u, 0u, 0b100000u}, 0b10101u},
+};
+
+const char* fmAlgorithmName(FmAlgorithm algorithm) {
+    static const char* names[] = {"off", "2 op: 2>1", "4 op: 4>3>2>1", "4 op: 2>1, 4>3", "4 op: 2+3+4>1",
+                                  "6 op: 6>5>4>3>2>1", "6 op: 3>2>1, 6>5>4", "6 op: 2>1, 4>3, 6>5"};
+    return names[static_cast<int>(algorithm)];
+}
+
+int fmOperatorCount(FmAlgorithm algorithm) {
+    return FM_TOPOLOGIES[static_cast<int>(algorithm)].operators;
+}
+
+FmSettings readFmSettings(const SynthetizerConfig& params) {
+    const std::atomic<float>* ratios[] = {&params.fm_op1_ratio, &params.fm_op2_ratio, &params.fm_op3_ratio,
+                                          &params.fm_op4_ratio, &params.fm_op5_ratio, &params.fm_op6_ratio};
+    const std::atomic<float>* levels[] = {&params.fm_op1_level, &params.fm_op2_level, &params.fm_op3_level,
+                                          &params.fm_op4_level, &params.fm_op5_level, &params.fm_op6_level};
+    FmSettings settings;
+    int algorithm = params.fm_algorithm.load(std::memory_order_relaxed);
+    settings.algorithm = algorithm > 0 && algorithm < FM_ALGORITHM_COUNT
+        ? static_cast<FmAlgorithm>(algorithm) : FmAlgorithm::OFF;
+    for (int op = 0; op < FM_OPERATORS; ++op) {
+        settings.ratios[op] = std::max(0.0f, ratios[op]->load(std::memory_order_relaxed));
+        settings.levels[op] = levels[op]->load(std::memory_order_relaxed);
+    }
+    return settings;
+}
+
+void FmBank::allocate(DspArena& arena, int voices, int maxFrames) {
+    this->maxFrames = maxFrames;
+    lanes = (voices + 3) / 4 * 4;
+    phases = arena.allocate<float>(lanes * FM_OPERATORS);
+    startIncrements = arena.allocate<float>(lanes);
+    endIncrements = arena.allocate<float>(lanes);
+    glide = arena.allocate<bool>(lanes);
+    outputs = arena.allocate<float>(lanes * maxFrames);
+}
+
+void FmBank::prepare(float sampleRate) {
+    this->sampleRate = sampleRate;
+    std::fill(phases.begin(), phases.end(), 0.0f);
+    std::fill(startIncrements.begin(), startIncrements.end(), 0.0f);
+    std::fill(endIncrements.begin(), endIncrements.end(), 0.0f);
+    std::fill(glide.begin(), glide.end(), false);
+    std::fill(outputs.begin(), outputs.end(), 0.0f);
+}
+
+void FmBank::setSampleRate(float sampleRate) {
+    // The increments are per sample: rescale them so running notes keep their pitch
+    const float scale = this->sampleRate / sampleRate;
+    for (int lane = 0; lane < lanes; ++lane) {
+        endIncrements[lane] *= scale;
+    }
+    this->sampleRate = sampleRate;
+}
+
+void FmBank::reset(int voice) {
+    const int group = voice / 4 * 4;
+    for (int op = 0; op < FM_OPERATORS; ++op) {
+        phases[(group * FM_OPERATORS) + op * 4 + voice % 4] = 0.0f;
+    }
+    glide[voice] = false;
+}
+
+void FmBank::setFrequency(int voice, float frequency) {
+    const float increment = frequency / sampleRate;
+    startIncrements[voice] = glide[voice] ? endIncrements[voice] : increment;
+    endIncrements[voice] = increment;
+    glide[voice] = true;
+}
+
+void FmBank::render(const FmSettings& settings, int numFrames, const bool* active) {
+    switch (settings.algorithm) {
+        case FmAlgorithm::TWO_OP: renderAlgorithm<FmAlgorithm::TWO_OP>(settings, numFrames, active); break;
+        case FmAlgorithm::FOUR_OP_STACK: renderAlgorithm<FmAlgorithm::FOUR_OP_STACK>(settings, numFrames, active); break;
+        case FmAlgorithm::FOUR_OP_PAIRS: renderAlgorithm<FmAlgorithm::FOUR_OP_PAIRS>(settings, numFrames, active); break;
+        case FmAlgorithm::FOUR_OP_BRANCH: renderAlgorithm<FmAlgorithm::FOUR_OP_BRANCH>(settings, numFrames, active); break;
+        case FmAlgorithm::SIX_OP_STACK: renderAlgorithm<FmAlgorithm::SIX_OP_STACK>(settings, numFrames, active); break;
+        case FmAlgorithm::SIX_OP_TWO_STACKS: renderAlgorithm<FmAlgorithm::SIX_OP_TWO_STACKS>(settings, numFrames, active); break;
+        case FmAlgorithm::SIX_OP_PAIRS: renderAlgorithm<FmAlgorithm::SIX_OP_PAIRS>(settings, numFrames, active); break;
+        default: break;
+    }
+}
+
+// sin(2 pi x) of a phase in cycles: reduced to [-1/4, 1/4] cycle, then an odd degree-9 polynomial
+// (Taylor, error below 4e-6, -108 dB)
+static inline Float4 sineCycles(Float4 x) {
+    const Float4 quarter = Float4::broadcast(0.25f);
+    x = x - round(x);
+    // sin(2 pi x) = sin(2 pi (1/2 - x)) folds the outer quarters back onto the middle one
+    x = Float4::broadcast(2.0f) * min(max(x, Float4::zero() - quarter), quarter) - x;
+    const Float4 x2 = x * x;
+    Float4 p = Float4::broadcast(4.2058693944e+01f);
+    p = Float4::broadcast(-7.6705859753e+01f) + x2 * p;
+    p = Float4::broadcast(8.1605249276e+01f) + x2 * p;
+    p = Float4::broadcast(-4.1341702240e+01f) + x2 * p;
+    p = Float4::broadcast(6.2831853072e+00f) + x2 * p;
+    return x * p;
+}
+
+// Sum of the outputs whose bit is set in Mask; resolved at compile time
+template <unsigned Mask, int... Ops>
+static inline Float4 sumOperators(const Float4 (&out)[FM_OPERATORS], std::integer_sequence<int, Ops...>) {
+    Float4 sum = Float4::zero();
+    ((sum = ((Mask >> Ops) & 1u) ? sum + out[Ops] : sum), ...);
+    return sum;
+}
+
+// One frame of operator Op for four voices: its phase offset by its modulators' outputs
+template <FmAlgorithm Algorithm, int Op>
+static inline void runOperator(Float4 (&out)[FM_OPERATORS], Float4 (&phase)[FM_OPERATORS],
+                               const Float4 (&gains)[FM_OPERATORS], const Float4 (&ratios)[FM_OPERATORS],
+                               Float4 increment) {
+    constexpr unsigned modulators = FM_TOPOLOGIES[static_cast<int>(Algorithm)].modulators[Op];
+    out[Op] = sineCycles(phase[Op] + sumOperators<modulators>(out, std::make_integer_sequence<int, FM_OPERATORS>{}))
+            * gains[Op];
+    phase[Op] += increment * ratios[Op];
+    // Whole cycles off: a high ratio on a high note steps more than one cycle per frame
+    phase[Op] = phase[Op] - floor(phase[Op]);
+}
+
+// All operators of one frame, highest first so every modulator is computed before its carriers
+template <FmAlgorithm Algorithm, int... I>
+static inline Float4 runFrame(Float4 (&phase)[FM_OPERATORS], const Float4 (&gains)[FM_OPERATORS],
+                              const Float4 (&ratios)[FM_OPERATORS], Float4 increment,
+                              std::integer_sequence<int, I...>) {
+    constexpr FmTopology topology = FM_TOPOLOGIES[static_cast<int>(Algorithm)];
+    Float4 out[FM_OPERATORS];
+    (runOperator<Algorithm, topology.operators - 1 - I>(out, phase, gains, ratios, increment), ...);
+    return sumOperators<topology.carriers>(out, std::make_integer_sequence<int, FM_OPERATORS>{});
+}
+
+template <FmAlgorithm Algorithm>
+void FmBank::renderAlgorithm(const FmSettings& settings, int numFrames, const bool* active) {
+    constexpr FmTopology topology = FM_TOPOLOGIES[static_cast<int>(Algorithm)];
+    constexpr int operators = topology.operators;
+
+    // Carriers share the output level, modulators scale to a phase deviation in cycles
+    constexpr int carriers = std::popcount(topology.carriers);
+    Float4 gains[FM_OPERATORS];
+    Float4 ratios[FM_OPERATORS];
+    for (int op = 0; op < FM_OPERATORS; ++op) {
+        const bool carrier = (topology.carriers >> op) & 1u;
+        gains[op] = Float4::broadcast(settings.levels[op]
+                                      * (carrier ? FM_OUTPUT_GAIN / carriers : FM_INDEX_CYCLES));
+        ratios[op] = Float4::broadcast(settings.ratios[op]);
+    }
+
+    const Float4 frameStep = Float4::broadcast(1.0f / numFrames);
+    for (int group = 0; group < lanes; group += 4) {
+        if (!(active[group] || active[group + 1] || active[group + 2] || active[group + 3])) {
+            continue;
+        }
+        float* groupPhases = phases.data() + group * FM_OPERATORS;
+        Float4 phase[FM_OPERATORS];
+        for (int op = 0; op < operators; ++op) {
+            phase[op] = Float4::load(groupPhases + op * 4);
+        }
+        Float4 increment = Float4::load(startIncrements.data() + group);
+        const Float4 incrementStep = (Float4::load(endIncrements.data() + group) - increment) * frameStep;
+        float* out[4];
+        for (int lane = 0; lane < 4; ++lane) {
+            out[lane] = outputs.data() + (group + lane) * maxFrames;
+        }
+
+        for (int frame = 0; frame < numFrames; ++frame) {
+            float samples[4];
+            runFrame<Algorithm>(phase, gains, ratios, increment, std::make_integer_sequence<int, operators>{})
+                .store(samples);
+            for (int lane = 0; lane < 4; ++lane) {
+                out[lane][frame] = samples[lane];
+            }
+            increment += incrementStep;
+        }
+
+        for (int op = 0; op < operators; ++op) {
+            phase[op].store(groupPhases + op * 4);
+        }
+    }
+}
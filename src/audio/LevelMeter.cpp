@@ -0,0 +1,221 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/LevelMeter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "../../include/audio/Simd.h"
+
+void LevelMeter::prepare(int sampleRate) {
+    this->sampleRate = static_cast<float>(sampleRate);
+    peakLeft = peakRight = 0.0f;
+    meanSquareLeft = meanSquareRight = 0.0f;
+}
+
+void LevelMeter::process(const float* buffer, int numFrames, OutputMeters& meters) {
+    // Lanes hold L, R, L, R: one pass gives both channels' peak and sum of squares
+    Float4 peak = Float4::zero();
+    Float4 sumSquares = Float4::zero();
+    int samples = numFrames * 2;
+    int i = 0;
+    for (; i + 4 <= samples; i += 4) {
+        Float4 x = Float4::load(buffer + i);
+        peak = max(peak, abs(x));
+        sumSquares += x * x;
+    }
+    float blockPeakLeft = std::max(peak.lane(0), peak.lane(2));
+    float blockPeakRight = std::max(peak.lane(1), peak.lane(3));
+    float sumLeft = sumSquares.lane(0) + sumSquares.lane(2);
+    float sumRight = sumSquares.lane(1) + sumSquares.lane(3);
+    for (; i < samples; i += 2) {
+        blockPeakLeft = std::max(blockPeakLeft, std::fabs(buffer[i]));
+        blockPeakRight = std::max(blockPeakRight, std::fabs(buffer[i + 1]));
+        sumLeft += buffer[i] * buffer[i];
+        sumRight += buffer[i + 1] * buffer[i + 1];
+    }
+
+    // Only count clipped samples when the block actually clipped
+    if (blockPeakLeft > 1.0f || blockPeakRight > 1.0f) {
+        unsigned long long clipped = 0;
+        for (int j = 0; j < samples; ++j) {
+            clipped += std::fabs(buffer[j]) > 1.0f;
+        }
+        meters.clippedSamples.fetch_add(clipped, std::memory_order_relaxed);
+        meters.clipping.store(true, std::memory_order_relaxed);
+    }
+
+    // Ballistics: peak falls 20 dB per second, RMS is a 300 ms exponential average
+    float blockSeconds = numFrames / sampleRate;
+    float fall = std::pow(10.0f, -blockSeconds);
+    float smoothing = 1.0f - std::exp(-blockSeconds / 0.3f);
+    peakLeft = std::max(blockPeakLeft, peakLeft * fall);
+    peakRight = std::max(blockPeakRight, peakRight * fall);
+    meanSquareLeft += smoothing * (sumLeft / numFrames - meanSquareLeft);
+    meanSquareRight += smoothing * (sumRight / numFrames - meanSquareRight);
+
+    // Settle to exact zero below -100 dB so silence stops updating the display
+    if (peakLeft < 1e-5f) peakLeft = 0.0f;
+    if (peakRight < 1e-5f) peakRight = 0.0f;
+    if (meanSquareLeft < 1e-10f) meanSquareLeft = 0.0f;
+    if (meanSquareRight < 1e-10f) meanSquareRight = 0.0f;
+
+    meters.peakLeft.store(peakLeft, std::memory_order_relaxed);
+    meters.peakRight.store(peakRight, std::memory_order_relaxed);
+    meters.rmsLeft.store(std::sqrt(meanSquareLeft), std::memory_order_relaxed);
+    meters.rmsRight.store(std::sqrt(meanSquareRight), std::memory_order_relaxed);
+}
+
+LoudnessMeter::LoudnessMeter(std::shared_ptr<OutputMeters> meters) : meters(meters) {}
+
+LoudnessMeter::~LoudnessMeter() {
+    stop();
+}
+
+void LoudnessMeter::start() {
+    running = true;
+    thread = std::thread(&LoudnessMeter::run, this);
+}
+
+void LoudnessMeter::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void LoudnessMeter::push(const float* buffer, int numFrames) {
+    ring.push(buffer, numFrames * 2);
+}
+
+void LoudnessMeter::setSampleRate(int sampleRate) {
+    this->sampleRate.store(sampleRate, std::memory_order_relaxed);
+}
+
+void LoudnessMeter::run() {
+    std::array<float, 4096> samples;
+    while (running.load(std::memory_order_relaxed)) {
+        int rate = sampleRate.load(std::memory_order_relaxed);
+        if (rate != activeSampleRate) {
+            reset(rate);
+        }
+
+        size_t count = ring.pop(samples.data(), samples.size());
+        if (count == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        for (size_t i = 0; i + 1 < count; i += 2) {
+            processFrame(samples[i], samples[i + 1]);
+        }
+    }
+}
+
+// K-weighting filters for the given rate (bilinear transform of the BS.1770 pre-filter and RLB curve)
+void LoudnessMeter::reset(int rate) {
+    activeSampleRate = rate;
+
+    double k = std::tan(M_PI * 1681.974450955533 / rate);
+    double q = 0.7071752369554196;
+    double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    LoudnessBiquad shelfFilter;
+    shelfFilter.b0 = (vh + vb * k / q + k * k) / a0;
+    shelfFilter.b1 = 2.0 * (k * k - vh) / a0;
+    shelfFilter.b2 = (vh - vb * k / q + k * k) / a0;
+    shelfFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelfFilter.a2 = (1.0 - k / q + k * k) / a0;
+
+    k = std::tan(M_PI * 38.13547087602444 / rate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    LoudnessBiquad highPassFilter;
+    highPassFilter.b0 = 1.0;
+    highPassFilter.b1 = -2.0;
+    highPassFilter.b2 = 1.0;
+    highPassFilter.a1 = 2.0 * (k * k - 1.0) / a0;
+    highPassFilter.a2 = (1.0 - k / q + k * k) / a0;
+
+    shelf.fill(shelfFilter);
+    highPass.fill(highPassFilter);
+
+    subBlockLength = rate / 10;
+    subBlockFill = 0;
+    subBlockEnergy = 0.0;
+    subBlocks.fill(0.0);
+    subBlockCount = 0;
+    histogramEnergy.fill(0.0);
+    histogramCount.fill(0);
+}
+
+void LoudnessMeter::processFrame(float left, float right) {
+    double l = highPass[0].process(shelf[0].process(left));
+    double r = highPass[1].process(shelf[1].process(right));
+    // Channel weights are 1.0 for left and right
+    subBlockEnergy += l * l + r * r;
+
+    if (++subBlockFill == subBlockLength) {
+        finishSubBlock();
+    }
+}
+
+static float energyToLufs(double energy) {
+    return energy > 0.0 ? static_cast<float>(-0.691 + 10.0 * std::log10(energy))
+                        : -std::numeric_limits<float>::infinity();
+}
+
+void LoudnessMeter::finishSubBlock() {
+    subBlocks[subBlockCount % SUB_BLOCKS_SHORT_TERM] = subBlockEnergy / subBlockLength;
+    ++subBlockCount;
+    subBlockFill = 0;
+    subBlockEnergy = 0.0;
+
+    auto windowEnergy = [&](int length) {
+        int available = std::min(subBlockCount, length);
+        double sum = 0.0;
+        for (int i = 1; i <= available; ++i) {
+            sum += subBlocks[(subBlockCount - i) % SUB_BLOCKS_SHORT_TERM];
+        }
+        return sum / length;
+    };
+
+    // 400 ms gating blocks overlap by 75 %, so one ends every 100 ms sub-block
+    double momentary = windowEnergy(SUB_BLOCKS_MOMENTARY);
+    float momentaryLufs = energyToLufs(momentary);
+    if (subBlockCount >= SUB_BLOCKS_MOMENTARY && momentaryLufs > -70.0f) {
+        int bin = std::clamp(static_cast<int>((momentaryLufs + 70.0f) * 10.0f), 0, HISTOGRAM_BINS - 1);
+        histogramEnergy[bin] += momentary;
+        ++histogramCount[bin];
+    }
+
+    meters->momentaryLufs.store(momentaryLufs, std::memory_order_relaxed);
+    meters->shortTermLufs.store(energyToLufs(windowEnergy(SUB_BLOCKS_SHORT_TERM)), std::memory_order_relaxed);
+    meters->integratedLufs.store(static_cast<float>(integratedLoudness()), std::memory_order_relaxed);
+}
+
+// Absolute gate at -70 LUFS (applied when filling the histogram), then relative gate 10 LU below
+double LoudnessMeter::integratedLoudness() const {
+    double energy = 0.0;
+    long long count = 0;
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        energy += histogramEnergy[bin];
+        count += histogramCount[bin];
+    }
+    if (count == 0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    double relativeGate = energyToLufs(energy / count) - 10.0;
+    int firstBin = std::clamp(static_cast<int>(std::ceil((relativeGate + 70.0) * 10.0)), 0, HISTOGRAM_BINS);
+    energy = 0.0;
+    count = 0;
+    for (int bin = firstBin; bin < HISTOGRAM_BINS; ++bin) {
+        energy += histogramEnergy[bin];
+        count += histogramCount[bin];
+    }
+    return count > 0 ? energyToLufs(energy / count) : -std::numeric_limits<double>::infinity();
+}
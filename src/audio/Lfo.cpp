@@ -0,0 +1,95 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/Lfo.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Cycle length in beats per sync choice, index 0 unused (free running)
+static const float syncBeats[LFO_SYNC_COUNT] = {0.0f, 8.0f, 4.0f, 2.0f, 1.0f, 0.5f, 0.25f,
+                                                2.0f / 3.0f, 1.0f / 3.0f, 1.0f / 6.0f};
+
+const char* lfoShapeName(LfoShape shape) {
+    static const char* names[] = {"sine", "triangle", "square", "sample & hold", "smooth random"};
+    return names[static_cast<int>(shape)];
+}
+
+const char* lfoSyncName(int sync) {
+    static const char* names[LFO_SYNC_COUNT] = {"off", "2/1", "1/1", "1/2", "1/4", "1/8", "1/16",
+                                                "1/4T", "1/8T", "1/16T"};
+    return names[sync];
+}
+
+LfoSettings readLfoSettings(const SynthetizerConfig& params, int lfo) {
+    const bool first = lfo == 0;
+    int shape = (first ? params.lfo1_shape : params.lfo2_shape).load(std::memory_order_relaxed);
+    int sync = (first ? params.lfo1_sync : params.lfo2_sync).load(std::memory_order_relaxed);
+
+    LfoSettings settings;
+    settings.shape = shape >= 0 && shape < LFO_SHAPE_COUNT ? static_cast<LfoShape>(shape) : LfoShape::SINE;
+    settings.perVoice = (first ? params.lfo1_per_voice : params.lfo2_per_voice).load(std::memory_order_relaxed);
+    if (sync > 0 && sync < LFO_SYNC_COUNT) {
+        float bpm = params.tempo_bpm.load(std::memory_order_relaxed);
+        settings.frequency = bpm / 60.0f / syncBeats[sync];
+    } else {
+        settings.frequency = (first ? params.lfo1_rate : params.lfo2_rate).load(std::memory_order_relaxed);
+    }
+    return settings;
+}
+
+void Lfo::reset() {
+    phase = 0.0f;
+    held = nextRandom();
+    randomFrom = held;
+    randomTo = nextRandom();
+}
+
+void Lfo::setSeed(uint32_t seed) {
+    // xorshift never leaves 0
+    randomState = seed != 0 ? seed : 0x9E3779B9u;
+    reset();
+}
+
+float Lfo::nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return static_cast<float>(randomState >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+float Lfo::advance(const LfoSettings& settings, int numFrames, float sampleRate) {
+    phase += std::max(0.0f, settings.frequency) * numFrames / sampleRate;
+    if (phase >= 1.0f) {
+        // New random values once per completed cycle, however many passed in this step
+        phase -= std::floor(phase);
+        held = nextRandom();
+        randomFrom = randomTo;
+        randomTo = nextRandom();
+    }
+
+    switch (settings.shape) {
+        case LfoShape::SINE:
+            value = std::sin(2.0f * static_cast<float>(M_PI) * phase);
+            break;
+        case LfoShape::TRIANGLE:
+            value = phase < 0.5f ? 4.0f * phase - 1.0f : 3.0f - 4.0f * phase;
+            break;
+        case LfoShape::SQUARE:
+            value = phase < 0.5f ? 1.0f : -1.0f;
+            break;
+        case LfoShape::SAMPLE_HOLD:
+            value = held;
+            break;
+        case LfoShape::SMOOTH_RANDOM: {
+            // Smoothstep between one random level and the next, no corners at the joins
+            float t = phase * phase * (3.0f - 2.0f * phase);
+            value = randomFrom + (randomTo - randomFrom) * t;
+            break;
+        }
+        case LfoShape::COUNT:
+            break;
+    }
+    return value;
+}
@@ -0,0 +1,164 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/MappedFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Cannot open " << path << " (error " << GetLastError() << ")" << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    void* view = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    }
+    if (!view) {
+        std::cerr << "Cannot map " << path << " (error " << GetLastError() << ")" << std::endl;
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    mappingHandle = mapping;
+    bytes = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (lockedLength > 0) {
+        VirtualUnlock(const_cast<unsigned char*>(lockedStart), lockedLength);
+    }
+    if (bytes) {
+        UnmapViewOfFile(bytes);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    bytes = nullptr;
+    length = 0;
+    lockedStart = nullptr;
+    lockedLength = 0;
+    fileHandle = nullptr;
+    mappingHandle = nullptr;
+}
+
+static size_t pageSize() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+}
+
+static bool lockPages(const unsigned char* start, size_t count) {
+    return VirtualLock(const_cast<unsigned char*>(start), count) != 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info {};
+    void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping keeps the file referenced, the descriptor is not needed anymore
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Cannot map " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    bytes = static_cast<const unsigned char*>(view);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void MappedFile::close() {
+    if (lockedLength > 0) {
+        munlock(lockedStart, lockedLength);
+    }
+    if (bytes) {
+        munmap(const_cast<unsigned char*>(bytes), length);
+    }
+    bytes = nullptr;
+    length = 0;
+    lockedStart = nullptr;
+    lockedLength = 0;
+}
+
+static size_t pageSize() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+static bool lockPages(const unsigned char* start, size_t count) {
+    return mlock(start, count) == 0;
+}
+
+#endif
+
+bool MappedFile::prefault(size_t offset, size_t count) {
+    if (!bytes || offset >= length) {
+        return true;
+    }
+    count = std::min(count, length - offset);
+    const size_t page = pageSize();
+    const unsigned char* start = bytes + offset / page * page;
+    const unsigned char* end = bytes + offset + count;
+
+#if !defined(_WIN32)
+    madvise(const_cast<unsigned char*>(start), end - start, MADV_WILLNEED);
+#endif
+    // Touch one byte per page so every page is resident before the first note
+    volatile unsigned char sink = 0;
+    for (const unsigned char* p = start; p < end; p += page) {
+        sink = sink + *p;
+    }
+
+    // One locked range per file, the attack region asked for first
+    if (lockedLength > 0) {
+        return true;
+    }
+    if (!lockPages(start, end - start)) {
+        return false;
+    }
+    lockedStart = start;
+    lockedLength = end - start;
+    return true;
+}
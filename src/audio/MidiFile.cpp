@@ -0,0 +1,245 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/MidiFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+struct TickEvent {
+    uint64_t tick;
+    // File order, keeps simultaneous events (a note off before the next note on) in sequence
+    uint64_t order;
+    // 0 for channel messages, otherwise the new tempo in microseconds per quarter note
+    uint32_t tempo;
+    uint8_t size;
+    uint8_t data[3];
+};
+
+class Reader {
+public:
+    Reader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    bool atEnd() const { return offset >= size; }
+    bool has(size_t count) const { return offset + count <= size; }
+    uint8_t byte() { return has(1) ? data[offset++] : 0; }
+    uint32_t big(int count) {
+        uint32_t value = 0;
+        for (int i = 0; i < count; ++i) {
+            value = value << 8 | byte();
+        }
+        return value;
+    }
+    // Variable-length quantity: 7 bits per byte, high bit set on all but the last
+    uint32_t variable() {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint8_t b = byte();
+            value = value << 7 | (b & 0x7F);
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+    void skip(size_t count) { offset = std::min(size, offset + count); }
+    size_t position() const { return offset; }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t offset = 0;
+};
+
+// Data bytes following each channel status
+int dataBytes(uint8_t status) {
+    uint8_t type = status & 0xF0;
+    return type == 0xC0 || type == 0xD0 ? 1 : 2;
+}
+
+// Appends the track's events; endTick is raised to the track's end (its end-of-track event, delta included)
+bool readTrack(Reader& track, std::vector<TickEvent>& events, uint64_t& endTick) {
+    uint64_t tick = 0;
+    uint8_t runningStatus = 0;
+    while (!track.atEnd()) {
+        tick += track.variable();
+        uint8_t status = track.byte();
+        if (status == 0xFF) {
+            uint8_t type = track.byte();
+            uint32_t length = track.variable();
+            if (type == 0x51 && length == 3) {
+                events.push_back({tick, events.size(), track.big(3), 0, {0, 0, 0}});
+            } else if (type == 0x2F) {
+                endTick = std::max(endTick, tick);
+                return true;
+            } else {
+                track.skip(length);
+            }
+            continue;
+        }
+        if (status == 0xF0 || status == 0xF7) {
+            track.skip(track.variable());
+            continue;
+        }
+
+        uint8_t first;
+        if (status & 0x80) {
+            runningStatus = status;
+            first = track.byte();
+        } else if (runningStatus) {
+            // Running status: the byte read is already the first data byte
+            first = status;
+            status = runningStatus;
+        } else {
+            return false;
+        }
+        TickEvent event{tick, events.size(), 0, static_cast<uint8_t>(1 + dataBytes(status)), {status, first, 0}};
+        if (event.size == 3) {
+            event.data[2] = track.byte();
+        }
+        events.push_back(event);
+    }
+    endTick = std::max(endTick, tick);
+    return true;
+}
+
+}
+
+bool loadMidiFile(const std::string& path, std::vector<MidiFileEvent>& events, MidiFileInfo* info) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Reader reader(bytes.data(), bytes.size());
+    if (!reader.has(14) || reader.big(4) != 0x4D546864 /* MThd */) {
+        std::cerr << path << " is not a MIDI file" << std::endl;
+        return false;
+    }
+    uint32_t headerLength = reader.big(4);
+    int format = static_cast<int>(reader.big(2));
+    int trackCount = static_cast<int>(reader.big(2));
+    uint16_t division = static_cast<uint16_t>(reader.big(2));
+    reader.skip(headerLength - 6);
+    if (format > 1) {
+        std::cerr << path << ": MIDI format " << format << " (independent sequences) is not supported" << std::endl;
+        return false;
+    }
+
+    std::vector<TickEvent> tickEvents;
+    uint64_t endTick = 0;
+    for (int t = 0; t < trackCount && reader.has(8); ++t) {
+        uint32_t chunkId = reader.big(4);
+        uint32_t length = reader.big(4);
+        size_t start = reader.position();
+        if (chunkId == 0x4D54726B /* MTrk */) {
+            Reader track(bytes.data() + start, std::min<size_t>(length, bytes.size() - start));
+            if (!readTrack(track, tickEvents, endTick)) {
+                std::cerr << path << ": corrupt track " << t << std::endl;
+                return false;
+            }
+        }
+        reader.skip(length);
+    }
+    std::stable_sort(tickEvents.begin(), tickEvents.end(),
+                     [](const TickEvent& a, const TickEvent& b) { return a.tick < b.tick; });
+
+    // Ticks to seconds through the tempo map: 120 BPM until the first tempo event.
+    // A negative SMPTE division gives frames per second and ticks per frame directly.
+    double secondsPerTick;
+    double ticksPerQuarter = division & 0x7FFF;
+    bool smpte = division & 0x8000;
+    if (smpte) {
+        int framesPerSecond = -static_cast<int8_t>(division >> 8);
+        secondsPerTick = 1.0 / (framesPerSecond * (division & 0xFF));
+    } else {
+        secondsPerTick = 0.5 / ticksPerQuarter;
+    }
+
+    events.clear();
+    events.reserve(tickEvents.size());
+    uint64_t lastTick = 0;
+    double seconds = 0.0;
+    int held = 0;
+    MidiFileInfo result;
+    for (const TickEvent& event : tickEvents) {
+        seconds += (event.tick - lastTick) * secondsPerTick;
+        lastTick = event.tick;
+        if (event.tempo != 0) {
+            if (!smpte) {
+                secondsPerTick = event.tempo / 1.0e6 / ticksPerQuarter;
+            }
+            continue;
+        }
+        MidiFileEvent out;
+        out.seconds = seconds;
+        out.size = event.size;
+        std::copy(event.data, event.data + 3, out.data);
+        events.push_back(out);
+
+        uint8_t type = event.data[0] & 0xF0;
+        if (type == 0x90 && event.data[2] > 0) {
+            ++result.notes;
+            result.maxPolyphony = std::max(result.maxPolyphony, ++held);
+        } else if ((type == 0x80 || type == 0x90) && held > 0) {
+            --held;
+        }
+    }
+
+    // The file lasts until its longest track ends, usually the end of the last bar rather than the last note off
+    if (endTick > lastTick) {
+        seconds += (endTick - lastTick) * secondsPerTick;
+    }
+
+    if (info) {
+        result.format = format;
+        result.tracks = trackCount;
+        result.seconds = seconds;
+        *info = result;
+    }
+    return true;
+}
+
+MidiPlayer::MidiPlayer(std::vector<MidiFileEvent> events, bool loop, double length)
+    : events(std::move(events)), loop(loop),
+      length(std::max(length, this->events.empty() ? 0.0 : this->events.back().seconds)) {}
+
+size_t MidiPlayer::nextBlock(int numFrames, int sampleRate, MidiEvent* out, size_t capacity) {
+    const double blockSeconds = static_cast<double>(numFrames) / sampleRate;
+    auto frameOf = [&](double offset) {
+        return static_cast<uint32_t>(std::clamp(offset * sampleRate, 0.0, numFrames - 1.0));
+    };
+
+    size_t count = 0;
+    while (count < capacity) {
+        if (cursor >= events.size()) {
+            if (!loop || getLength() <= 0.0 || getLength() - position >= blockSeconds) {
+                break;
+            }
+            // The file ends inside this block: release what is held, then rewind the clock
+            MidiEvent& allOff = out[count++];
+            allOff.frame = frameOf(getLength() - position);
+            allOff.size = 3;
+            allOff.data[0] = 0xB0;
+            allOff.data[1] = 123;
+            allOff.data[2] = 0;
+            position -= getLength();
+            cursor = 0;
+            continue;
+        }
+        const MidiFileEvent& event = events[cursor];
+        double offset = event.seconds - position;
+        if (offset >= blockSeconds) {
+            break;
+        }
+        MidiEvent& next = out[count++];
+        next.frame = frameOf(offset);
+        next.size = event.size;
+        std::copy(event.data, event.data + 3, next.data);
+        ++cursor;
+    }
+    position += blockSeconds;
+    return count;
+}
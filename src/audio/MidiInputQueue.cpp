@@ -0,0 +1,44 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/MidiInputQueue.h"
+
+#include <algorithm>
+#include <chrono>
+
+int64_t MidiInputQueue::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void MidiInputQueue::push(const TimedMidiMessage& message) {
+    ring.push(&message, 1);
+}
+
+size_t MidiInputQueue::nextBlock(int numFrames, int sampleRate, MidiEvent* out, size_t capacity) {
+    const int64_t blockStart = now();
+    const int64_t blockNanoseconds = static_cast<int64_t>(numFrames) * 1000000000LL / sampleRate;
+    const int64_t windowStart = blockStart - blockNanoseconds;
+
+    TimedMidiMessage messages[64];
+    size_t count = 0;
+    while (count < capacity) {
+        size_t popped = ring.pop(messages, std::min(std::size(messages), capacity - count));
+        if (popped == 0) {
+            break;
+        }
+        for (size_t i = 0; i < popped; ++i) {
+            // Messages older than the window (the stream was stopped) play at once; ones stamped
+            // after blockStart arrived while draining and play at the end of the block
+            int64_t offset = (messages[i].nanoseconds - windowStart) * sampleRate / 1000000000LL;
+            MidiEvent& event = out[count++];
+            event.frame = static_cast<uint32_t>(std::clamp<int64_t>(offset, 0, numFrames - 1));
+            event.size = messages[i].size;
+            std::copy(messages[i].data, messages[i].data + 3, event.data);
+        }
+    }
+    // Out of order only if the input thread's stamps went backwards; keep the engine's sorted contract
+    std::stable_sort(out, out + count, [](const MidiEvent& a, const MidiEvent& b) { return a.frame < b.frame; });
+    return count;
+}
@@ -0,0 +1,59 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/ModMatrix.h"
+
+#include "../../include/audio/Simd.h"
+
+const char* modSourceName(ModSource source) {
+    static const char* names[] = {"none", "LFO 1", "envelope", "velocity", "pressure", "timbre", "bend", "mod wheel",
+                                  "LFO 2"};
+    return names[static_cast<int>(source)];
+}
+
+const char* modDestinationName(ModDestination destination) {
+    static const char* names[] = {"none", "pitch", "cutoff", "resonance", "amplitude", "pan"};
+    return names[static_cast<int>(destination)];
+}
+
+void ModMatrix::setRoutings(const SynthetizerConfig& params) {
+    routingCount = 0;
+    for (int slot = 0; slot < MOD_SLOTS; ++slot) {
+        int source = params.mod_source[slot].load(std::memory_order_relaxed);
+        int destination = params.mod_destination[slot].load(std::memory_order_relaxed);
+        float amount = params.mod_amount[slot].load(std::memory_order_relaxed);
+        if (source <= 0 || source >= MOD_SOURCE_COUNT || destination <= 0 || destination >= MOD_DESTINATION_COUNT
+            || amount == 0.0f) {
+            continue;
+        }
+        routingSources[routingCount] = source;
+        routingDestinations[routingCount] = destination;
+        routingAmounts[routingCount] = amount;
+        ++routingCount;
+    }
+}
+
+void ModMatrix::evaluate() {
+    for (auto& row : destinations) {
+        row.fill(0.0f);
+    }
+    for (int r = 0; r < routingCount; ++r) {
+        const float* source = sources[routingSources[r]].data();
+        float* destination = destinations[routingDestinations[r]].data();
+        const Float4 amount = Float4::broadcast(routingAmounts[r]);
+        for (int v = 0; v < MOD_VOICE_LANES; v += 4) {
+            (Float4::load(destination + v) + amount * Float4::load(source + v)).store(destination + v);
+        }
+    }
+}
+
+VoiceModulation ModMatrix::getVoice(int voice) const {
+    VoiceModulation modulation;
+    modulation.pitch = destinations[static_cast<int>(ModDestination::PITCH)][voice];
+    modulation.cutoff = destinations[static_cast<int>(ModDestination::CUTOFF)][voice];
+    modulation.resonance = destinations[static_cast<int>(ModDestination::RESONANCE)][voice];
+    modulation.amplitude = destinations[static_cast<int>(ModDestination::AMPLITUDE)][voice];
+    modulation.pan = destinations[static_cast<int>(ModDestination::PAN)][voice];
+    return modulation;
+}
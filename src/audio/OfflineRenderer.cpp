@@ -0,0 +1,150 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/OfflineRenderer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+#include "../../include/audio/AudioEngine.h"
+#include "../../include/audio/Patch.h"
+
+std::vector<float> renderNote(const SynthetizerConfig& patch, const RenderRequest& request,
+                              const RenderFormat& format) {
+    auto params = std::make_shared<SynthetizerConfig>();
+    copyPatch(patch, *params);
+
+    AudioEngine engine(params);
+    engine.prepare(format.sampleRate, format.blockSize);
+    engine.setNoiseSeed(request.noiseSeed);
+
+    const long long noteFrames = static_cast<long long>(request.noteSeconds * format.sampleRate);
+    const long long totalFrames = noteFrames + static_cast<long long>(request.tailSeconds * format.sampleRate);
+    std::vector<float> output(totalFrames * 2, 0.0f);
+
+    engine.noteOn(request.midiNote - MIDI_NOTE_BASE, request.velocity);
+    long long frame = 0;
+    while (frame < totalFrames) {
+        // Blocks never straddle the note off, it lands exactly on noteFrames
+        long long end = frame < noteFrames ? noteFrames : totalFrames;
+        int frames = static_cast<int>(std::min<long long>(format.blockSize, end - frame));
+        engine.processAudio(output.data() + frame * 2, frames);
+        frame += frames;
+        if (frame == noteFrames) {
+            engine.noteOff();
+        }
+    }
+    return output;
+}
+
+std::vector<float> renderMidiFile(const SynthetizerConfig& patch, const std::vector<MidiFileEvent>& events,
+                                  const RenderFormat& format, double tailSeconds, MidiRenderStats* stats) {
+    auto params = std::make_shared<SynthetizerConfig>();
+    copyPatch(patch, *params);
+
+    AudioEngine engine(params);
+    engine.prepare(format.sampleRate, format.blockSize);
+    engine.setNoiseSeed(1);
+    auto player = std::make_shared<MidiPlayer>(events);
+    engine.setMidiPlayer(player);
+
+    const double seconds = player->getLength() + tailSeconds;
+    const long long totalFrames = static_cast<long long>(seconds * format.sampleRate);
+    std::vector<float> output(totalFrames * 2, 0.0f);
+    for (long long frame = 0; frame < totalFrames; frame += format.blockSize) {
+        int frames = static_cast<int>(std::min<long long>(format.blockSize, totalFrames - frame));
+        engine.processAudio(output.data() + frame * 2, frames);
+    }
+
+    if (stats) {
+        stats->peakVoices = engine.getPeakVoices();
+        stats->voiceSteals = engine.getVoiceSteals();
+    }
+    return output;
+}
+
+template <typename T>
+static void writeLittleEndian(std::ofstream& file, T value) {
+    unsigned char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bytes[i] = static_cast<unsigned char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xFF);
+    }
+    file.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+bool writeWav(const std::string& path, const std::vector<float>& interleaved, int sampleRate) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return false;
+    }
+    const uint16_t channels = 2;
+    const uint16_t bitsPerSample = 32;
+    const uint32_t dataBytes = static_cast<uint32_t>(interleaved.size() * sizeof(float));
+
+    file.write("RIFF", 4);
+    writeLittleEndian<uint32_t>(file, 36 + dataBytes);
+    file.write("WAVEfmt ", 8);
+    writeLittleEndian<uint32_t>(file, 16);
+    writeLittleEndian<uint16_t>(file, 3);   // IEEE float
+    writeLittleEndian<uint16_t>(file, channels);
+    writeLittleEndian<uint32_t>(file, sampleRate);
+    writeLittleEndian<uint32_t>(file, sampleRate * channels * bitsPerSample / 8);
+    writeLittleEndian<uint16_t>(file, channels * bitsPerSample / 8);
+    writeLittleEndian<uint16_t>(file, bitsPerSample);
+    file.write("data", 4);
+    writeLittleEndian<uint32_t>(file, dataBytes);
+
+    // Byte order is fixed here so the files are identical on every host
+    std::vector<unsigned char> data(dataBytes);
+    for (size_t i = 0; i < interleaved.size(); ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, &interleaved[i], sizeof(bits));
+        for (int b = 0; b < 4; ++b) {
+            data[i * 4 + b] = static_cast<unsigned char>(bits >> (8 * b));
+        }
+    }
+    file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    return static_cast<bool>(file);
+}
+
+bool readWav(const std::string& path, std::vector<float>& interleaved, int& sampleRate) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto read32 = [&](size_t offset) {
+        return static_cast<uint32_t>(bytes[offset]) | static_cast<uint32_t>(bytes[offset + 1]) << 8
+             | static_cast<uint32_t>(bytes[offset + 2]) << 16 | static_cast<uint32_t>(bytes[offset + 3]) << 24;
+    };
+    // Only the exact layout writeWav produces: 44 byte header, format 3, two channels
+    if (bytes.size() < 44 || std::memcmp(bytes.data(), "RIFF", 4) != 0 || bytes[20] != 3 || bytes[22] != 2) {
+        std::cerr << path << " is not a stereo float WAV" << std::endl;
+        return false;
+    }
+    sampleRate = static_cast<int>(read32(24));
+    uint32_t dataBytes = std::min<uint32_t>(read32(40), static_cast<uint32_t>(bytes.size() - 44));
+
+    interleaved.resize(dataBytes / sizeof(float));
+    for (size_t i = 0; i < interleaved.size(); ++i) {
+        uint32_t bits = read32(44 + i * 4);
+        std::memcpy(&interleaved[i], &bits, sizeof(bits));
+    }
+    return true;
+}
+
+uint64_t hashSamples(const std::vector<float>& samples) {
+    uint64_t hash = 1469598103934665603ull;
+    for (float sample : samples) {
+        uint32_t bits;
+        std::memcpy(&bits, &sample, sizeof(bits));
+        for (int i = 0; i < 4; ++i) {
+            hash ^= (bits >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
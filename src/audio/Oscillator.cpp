@@ -4,13 +4,102 @@
 
 #include "../../include/audio/Oscillator.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+// Windowed-sinc interpolation for sample playback: SINC_TAPS source frames around the read position,
+// weights from a table of SINC_PHASES fractional positions (Blackman window, cutoff just below Nyquist)
+constexpr int SINC_TAPS = 8;
+constexpr int SINC_PHASES = 1024;
+using SincTable = std::array<std::array<float, SINC_TAPS>, SINC_PHASES + 1>;
+// Read faster than one source frame per output sample (transposed up, or a sample at a higher rate than
+// the engine's), the kernel is stretched by the step: its cutoff drops to 0.9 / step of the source's
+// Nyquist, below the engine's, and it spans SINC_TAPS * step frames. Up to this step, above it aliases.
+constexpr int MAX_SINC_STRETCH = 8;
+constexpr int MAX_STRETCHED_TAPS = SINC_TAPS * MAX_SINC_STRETCH + 1;
+// The unstretched kernel over its whole width, SINC_PHASES points per source frame, for stretched reads
+using SincKernel = std::array<float, SINC_TAPS * SINC_PHASES + 2>;
+
+// Blackman-windowed sinc at x source frames from the read position, x in [-SINC_TAPS / 2, SINC_TAPS / 2]
+static double windowedSinc(double x) {
+    const double cutoff = 0.9;
+    double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * cutoff * x) / (M_PI * cutoff * x);
+    double w = (x + SINC_TAPS / 2.0) / SINC_TAPS;
+    double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * w) + 0.08 * std::cos(4.0 * M_PI * w);
+    return sinc * window;
+}
+
+static const SincTable& sincTable() {
+    static const SincTable table = [] {
+        SincTable weights{};
+        for (int phase = 0; phase <= SINC_PHASES; ++phase) {
+            double fraction = static_cast<double>(phase) / SINC_PHASES;
+            double sum = 0.0;
+            for (int tap = 0; tap < SINC_TAPS; ++tap) {
+                // Taps cover source frames -3..4 around the integer position
+                double x = tap - (SINC_TAPS / 2 - 1) - fraction;
+                weights[phase][tap] = static_cast<float>(windowedSinc(x));
+                sum += windowedSinc(x);
+            }
+            // Unity gain at DC for every phase
+            for (float& weight : weights[phase]) {
+                weight = static_cast<float>(weight / sum);
+            }
+        }
+        return weights;
+    }();
+    return table;
+}
+
+static const SincKernel& sincKernel() {
+    static const SincKernel kernel = [] {
+        SincKernel points{};
+        for (int i = 0; i <= SINC_TAPS * SINC_PHASES; ++i) {
+            points[i] = static_cast<float>(windowedSinc(static_cast<double>(i) / SINC_PHASES - SINC_TAPS / 2));
+        }
+        // Guard point, so the interpolation at the far edge reads zero past it
+        points[SINC_TAPS * SINC_PHASES + 1] = 0.0f;
+        return points;
+    }();
+    return kernel;
+}
+
+// Weights of the kernel stretched by stretch (> 1) for the source frames around position, normalized to
+// unity gain at DC. Returns the first frame; count is the number of weights.
+static long long stretchedWeights(double position, double stretch, float* weights, int& count) {
+    const SincKernel& kernel = sincKernel();
+    const double halfWidth = SINC_TAPS / 2 * stretch;
+    const long long first = static_cast<long long>(std::floor(position - halfWidth)) + 1;
+    const long long last = static_cast<long long>(std::floor(position + halfWidth));
+    count = static_cast<int>(std::min<long long>(last - first + 1, MAX_STRETCHED_TAPS));
+    // Kernel points per source frame at this stretch
+    const double scale = SINC_PHASES / stretch;
+    double sum = 0.0;
+    for (int tap = 0; tap < count; ++tap) {
+        double point = (static_cast<double>(first + tap) - position) * scale + SINC_TAPS / 2 * SINC_PHASES;
+        point = std::clamp(point, 0.0, static_cast<double>(SINC_TAPS * SINC_PHASES));
+        const int index = static_cast<int>(point);
+        const float fraction = static_cast<float>(point - index);
+        weights[tap] = kernel[index] + (kernel[index + 1] - kernel[index]) * fraction;
+        sum += weights[tap];
+    }
+    const float normalize = static_cast<float>(1.0 / sum);
+    for (int tap = 0; tap < count; ++tap) {
+        weights[tap] *= normalize;
+    }
+    return first;
+}
 
 Oscillator::Oscillator():
                             frequency(440.0f),
                             waveform(WaveformType::TRIANGLE),
                             phase(0.0f),
-                            noise_gen(std::random_device{}()),
-                            noise_dist(-0.5f,0.5f) {}
+                            sampleRate(DEFAULT_SAMPLE_RATE) {
+    setSeed(std::random_device{}());
+}
 
 float Oscillator::getFrequency() const {
     return frequency;
@@ -28,14 +117,81 @@ void Oscillator::setFrequency(float freq) {
     frequency = freq;
 }
 
+void Oscillator::prepare(float sampleRate) {
+    this->sampleRate = sampleRate;
+    reset();
+}
+
 void Oscillator::reset() {
     phase = 0.0f;
+    blepPending = 0.0f;
+}
+
+void Oscillator::setSeed(uint32_t seed) {
+    // Voices seed their oscillators with consecutive numbers: mixed (murmur3's finalizer) so their
+    // sequences do not start alike, and never 0, which xorshift does not leave
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6Bu;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35u;
+    seed ^= seed >> 16;
+    noiseState = seed != 0 ? seed : 0x9E3779B9u;
+}
+
+float Oscillator::nextNoise() {
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    return static_cast<float>(noiseState >> 8) * (1.0f / 16777216.0f) - 0.5f;
+}
+
+
+void Oscillator::setSample(const SampleData* sample) {
+    // Builds the interpolation table here rather than on the audio thread's first note
+    sincTable();
+    this->sample = sample;
+    retrigger();
+}
+
+void Oscillator::setStream(StreamVoice* stream) {
+    setSample(stream ? &stream->getSample() : nullptr);
+    this->stream = stream;
 }
 
+void Oscillator::retrigger() {
+    samplePosition = 0.0;
+    streamStarved = false;
+    if (stream) {
+        stream->retrigger();
+    }
+}
+
+bool Oscillator::isSamplePlaying() const {
+    return sample && samplePosition < static_cast<double>(sample->getFrames());
+}
 
 void Oscillator::generateBuffer(float* buffer, int numFrames, WaveformType waveform,
                        float frequency) {
-    float phaseIncrement = frequency / SAMPLE_RATE;
+    generateBuffer(buffer, numFrames, waveform, frequency, frequency);
+}
+
+void Oscillator::generateBuffer(float* buffer, int numFrames, WaveformType waveform,
+                                float startFrequency, float endFrequency) {
+    generateBuffer(buffer, numFrames, waveform, startFrequency, endFrequency, nullptr);
+}
+
+void Oscillator::generateBuffer(float* buffer, int numFrames, WaveformType waveform,
+                                float startFrequency, float endFrequency, float* wraps) {
+    if (waveform == WaveformType::SAMPLE) {
+        generateSample(buffer, numFrames, 0.5f * (startFrequency + endFrequency));
+        if (wraps) {
+            std::fill_n(wraps, numFrames, -1.0f);
+        }
+        return;
+    }
+    float phaseIncrement = startFrequency / sampleRate;
+    // Zero for a steady pitch, the increment then stays exactly the same
+    const float incrementStep = (endFrequency - startFrequency) / sampleRate / numFrames;
 
     for (int i = 0; i < numFrames * 2; i += 2) {
         float sample = 0.0f;
@@ -54,7 +210,11 @@ void Oscillator::generateBuffer(float* buffer, int numFrames, WaveformType wavef
                 break;
 
             case WaveformType::NOISE:
-                sample = noise_dist(noise_gen);
+                sample = nextNoise();
+                break;
+
+            case WaveformType::SAMPLE:
+                // Rendered by generateSample
                 break;
         }
 
@@ -62,10 +222,193 @@ void Oscillator::generateBuffer(float* buffer, int numFrames, WaveformType wavef
         buffer[i + 1] = sample;   // Right always odd
 
         phase += phaseIncrement;
-        if (phase >= 1.0f) {
+        const bool wrapped = phase >= 1.0f;
+        if (wrapped) {
             phase -= 1.0f;
         }
+        if (wraps) {
+            wraps[i / 2] = wrapped ? phase / phaseIncrement : -1.0f;
+        }
+        phaseIncrement += incrementStep;
+    }
+}
+
+// Triangle or saw value at a phase in [0, 1)
+static inline float syncedWave(WaveformType waveform, float phase) {
+    return waveform == WaveformType::SAW
+        ? phase - 0.5f
+        : 0.5f - 2.0f * std::abs(phase - 0.5f);
+}
+
+// Every frame takes both outcomes (sync, own wrap, neither) and selects, so the master's wraps need no
+// separate event pass and the loop stays free of data-dependent branches
+void Oscillator::generateSynced(float* buffer, int numFrames, WaveformType waveform,
+                                float startFrequency, float endFrequency, const float* wraps) {
+    if (waveform != WaveformType::TRIANGLE && waveform != WaveformType::SAW) {
+        generateBuffer(buffer, numFrames, waveform, startFrequency, endFrequency);
+        return;
+    }
+    float phaseIncrement = startFrequency / sampleRate;
+    const float incrementStep = (endFrequency - startFrequency) / sampleRate / numFrames;
+    const float restart = syncedWave(waveform, 0.0f);
+    // The saw drops by 1 at its own wrap, the triangle is continuous there
+    const float wrapStep = waveform == WaveformType::SAW ? -1.0f : 0.0f;
+
+    for (int i = 0; i < numFrames; ++i) {
+        float sample = syncedWave(waveform, phase) + blepPending;
+
+        float next = phase + phaseIncrement;
+        const bool ownWrap = next >= 1.0f;
+        next -= ownWrap ? 1.0f : 0.0f;
+
+        // Synced: the phase restarts at the master's wrap, t samples before the next frame, and has run
+        // t increments since. The step is the waveform at restart minus where it was at that moment.
+        const float t = wraps[i];
+        const bool synced = t >= 0.0f;
+        float before = phase + phaseIncrement * (1.0f - t);
+        before -= before >= 1.0f ? 1.0f : 0.0f;
+        const float syncStep = restart - syncedWave(waveform, before);
+
+        const float step = synced ? syncStep : ownWrap ? wrapStep : 0.0f;
+        // Distance after the step to the next frame, in samples
+        const float after = synced ? t : ownWrap ? next / phaseIncrement : 0.0f;
+        phase = synced ? t * phaseIncrement : next;
+
+        // polyBLEP: the band-limited step minus the naive one, on the frames either side of it
+        sample += 0.5f * step * after * after;
+        blepPending = -0.5f * step * (1.0f - after) * (1.0f - after);
+
+        buffer[i * 2] = sample;
+        buffer[i * 2 + 1] = sample;
+        phaseIncrement += incrementStep;
+    }
+}
+
+// One-shot playback, transposed so the sample's root note plays at its recorded pitch
+void Oscillator::generateSample(float* buffer, int numFrames, float frequency) {
+    if (!isSamplePlaying()) {
+        std::fill_n(buffer, numFrames * 2, 0.0f);
+        return;
+    }
+    float rootFrequency = 440.0f * std::pow(2.0f, (sample->getRootNote() - 69) / 12.0f);
+    double step = static_cast<double>(frequency) / rootFrequency * sample->getSampleRate() / sampleRate;
+    if (stream) {
+        generateStream(buffer, numFrames, step);
+        return;
+    }
+    switch (sample->getFormat()) {
+        case SampleFormat::INT16: generateSample<SampleFormat::INT16>(buffer, numFrames, step); break;
+        case SampleFormat::INT24: generateSample<SampleFormat::INT24>(buffer, numFrames, step); break;
+        case SampleFormat::FLOAT32: generateSample<SampleFormat::FLOAT32>(buffer, numFrames, step); break;
     }
 }
 
+template <SampleFormat Format>
+void Oscillator::generateSample(float* buffer, int numFrames, double step) {
+    const SincTable& table = sincTable();
+    const unsigned char* data = sample->getFrameData();
+    const long long frames = static_cast<long long>(sample->getFrames());
+    const size_t stride = sample->getBytesPerFrame();
+    // Mono samples read the same bytes for both channels
+    const size_t rightOffset = sample->getChannels() == 2 ? stride / 2 : 0;
+    const double stretch = std::min(step, static_cast<double>(MAX_SINC_STRETCH));
+    float stretched[MAX_STRETCHED_TAPS];
 
+    for (int i = 0; i < numFrames * 2; i += 2) {
+        long long index = static_cast<long long>(samplePosition);
+        if (index >= frames) {
+            std::fill(buffer + i, buffer + numFrames * 2, 0.0f);
+            break;
+        }
+        const float* weights;
+        long long first;
+        int taps = SINC_TAPS;
+        if (stretch > 1.0) {
+            first = stretchedWeights(samplePosition, stretch, stretched, taps);
+            weights = stretched;
+        } else {
+            int phase = static_cast<int>((samplePosition - index) * SINC_PHASES + 0.5);
+            weights = table[phase].data();
+            first = index - (SINC_TAPS / 2 - 1);
+        }
+
+        float left = 0.0f;
+        float right = 0.0f;
+        if (first >= 0 && first + taps <= frames) {
+            const unsigned char* p = data + first * stride;
+            for (int tap = 0; tap < taps; ++tap, p += stride) {
+                left += weights[tap] * decodeSample<Format>(p);
+                right += weights[tap] * decodeSample<Format>(p + rightOffset);
+            }
+        } else {
+            // First and last frames: taps outside the sample read silence
+            for (int tap = 0; tap < taps; ++tap) {
+                long long frame = first + tap;
+                if (frame >= 0 && frame < frames) {
+                    const unsigned char* p = data + frame * stride;
+                    left += weights[tap] * decodeSample<Format>(p);
+                    right += weights[tap] * decodeSample<Format>(p + rightOffset);
+                }
+            }
+        }
+        buffer[i] = left;
+        buffer[i + 1] = right;
+        samplePosition += step;
+    }
+}
+
+// Same interpolation over the decoded head and the stream ring. When the I/O thread is behind, the
+// position waits (silence) instead of skipping ahead, and the wait is counted as an underrun.
+void Oscillator::generateStream(float* buffer, int numFrames, double step) {
+    const SincTable& table = sincTable();
+    const long long frames = stream->getFrames();
+    long long ready = stream->readyFrames();
+    const double stretch = std::min(step, static_cast<double>(MAX_SINC_STRETCH));
+    float stretched[MAX_STRETCHED_TAPS];
+
+    for (int i = 0; i < numFrames * 2; i += 2) {
+        long long index = static_cast<long long>(samplePosition);
+        if (index >= frames) {
+            std::fill(buffer + i, buffer + numFrames * 2, 0.0f);
+            break;
+        }
+        const float* weights;
+        long long first;
+        int taps = SINC_TAPS;
+        if (stretch > 1.0) {
+            first = stretchedWeights(samplePosition, stretch, stretched, taps);
+            weights = stretched;
+        } else {
+            int phase = static_cast<int>((samplePosition - index) * SINC_PHASES + 0.5);
+            weights = table[phase].data();
+            first = index - (SINC_TAPS / 2 - 1);
+        }
+        long long last = std::min(first + taps - 1, frames - 1);
+        if (last >= ready) {
+            ready = stream->readyFrames();
+            if (last >= ready) {
+                stream->countUnderrun(!streamStarved);
+                streamStarved = true;
+                buffer[i] = buffer[i + 1] = 0.0f;
+                continue;
+            }
+        }
+        streamStarved = false;
+
+        float left = 0.0f;
+        float right = 0.0f;
+        for (int tap = 0; tap < taps; ++tap) {
+            float l, r;
+            stream->read(first + tap, l, r);
+            left += weights[tap] * l;
+            right += weights[tap] * r;
+        }
+        buffer[i] = left;
+        buffer[i + 1] = right;
+        samplePosition += step;
+    }
+
+    const long long halfWidth = static_cast<long long>(std::ceil(SINC_TAPS / 2 * std::max(stretch, 1.0)));
+    long long lowestNeeded = std::max(0LL, static_cast<long long>(samplePosition) - halfWidth + 1);
+    stream->release(lowestNeeded, static_cast<float>(step * sampleRate), samplePosition < frames);
+}
@@ -0,0 +1,135 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/Oversampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../../include/audio/Simd.h"
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+void HalfbandDecimator::allocate(DspArena& arena, int halfLength, int maxOutputFrames) {
+    this->halfLength = halfLength;
+    taps = arena.allocate<float>(2 * halfLength);
+    for (int channel = 0; channel < 2; ++channel) {
+        even[channel] = arena.allocate<float>(2 * halfLength - 1 + maxOutputFrames);
+        odd[channel] = arena.allocate<float>(halfLength + maxOutputFrames);
+    }
+}
+
+void HalfbandDecimator::prepare() {
+
+    // Kaiser windowed sinc with the cutoff at a quarter of the input rate
+    const int numTaps = 4 * halfLength - 1;
+    const int center = 2 * halfLength - 1;
+    const double beta = 8.0;
+    std::vector<double> h(numTaps);
+    double evenSum = 0.0;
+    for (int i = 0; i < numTaps; ++i) {
+        int offset = i - center;
+        double x = offset / 2.0;
+        double sinc = offset == 0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        double r = static_cast<double>(offset) / center;
+        double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+        h[i] = 0.5 * sinc * window;
+        if (i % 2 == 0) {
+            evenSum += h[i];
+        }
+    }
+
+    // Even-index taps must add up to 0.5 (with the 0.5 center tap, unity gain at DC)
+    for (int k = 0; k < 2 * halfLength; ++k) {
+        taps[k] = static_cast<float>(h[2 * (2 * halfLength - 1 - k)] * 0.5 / evenSum);
+    }
+    reset();
+}
+
+void HalfbandDecimator::reset() {
+    for (int channel = 0; channel < 2; ++channel) {
+        std::fill(even[channel].begin(), even[channel].end(), 0.0f);
+        std::fill(odd[channel].begin(), odd[channel].end(), 0.0f);
+    }
+}
+
+void HalfbandDecimator::process(const float* input, float* output, int numFrames) {
+    const int evenHistory = 2 * halfLength - 1;
+    const int numTaps = 2 * halfLength;
+    const Float4 half = Float4::broadcast(0.5f);
+
+    for (int channel = 0; channel < 2; ++channel) {
+        float* evenData = even[channel].data();
+        float* oddData = odd[channel].data();
+
+        // Split the block into its two phases, after the history of the previous block
+        for (int n = 0; n < numFrames; ++n) {
+            evenData[evenHistory + n] = input[4 * n + channel];
+            oddData[halfLength + n] = input[4 * n + 2 + channel];
+        }
+
+        // Four outputs per iteration, one broadcast tap at a time
+        int n = 0;
+        for (; n + 4 <= numFrames; n += 4) {
+            Float4 acc = half * Float4::load(oddData + n);
+            for (int k = 0; k < numTaps; ++k) {
+                acc += Float4::broadcast(taps[k]) * Float4::load(evenData + n + k);
+            }
+            float result[4];
+            acc.store(result);
+            for (int i = 0; i < 4; ++i) {
+                output[2 * (n + i) + channel] = result[i];
+            }
+        }
+        for (; n < numFrames; ++n) {
+            float acc = 0.5f * oddData[n];
+            for (int k = 0; k < numTaps; ++k) {
+                acc += taps[k] * evenData[n + k];
+            }
+            output[2 * n + channel] = acc;
+        }
+
+        // Keep the tail as history for the next block
+        std::copy(evenData + numFrames, evenData + numFrames + evenHistory, evenData);
+        std::copy(oddData + numFrames, oddData + numFrames + halfLength, oddData);
+    }
+}
+
+// In the order downsample() runs them at 4x
+void Oversampler::allocate(DspArena& arena, int maxBlockSize) {
+    firstStage.allocate(arena, 4, maxBlockSize * 2);
+    intermediate = arena.allocate<float>(maxBlockSize * 2 * 2);
+    finalStage.allocate(arena, 16, maxBlockSize);
+}
+
+void Oversampler::prepare() {
+    finalStage.prepare();
+    firstStage.prepare();
+}
+
+void Oversampler::reset() {
+    finalStage.reset();
+    firstStage.reset();
+}
+
+void Oversampler::downsample(const float* input, float* output, int numFrames, int factor) {
+    if (factor == 4) {
+        firstStage.process(input, intermediate.data(), numFrames * 2);
+        finalStage.process(intermediate.data(), output, numFrames);
+    } else if (factor == 2) {
+        finalStage.process(input, output, numFrames);
+    } else {
+        std::copy(input, input + numFrames * 2, output);
+    }
+}
@@ -0,0 +1,234 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/Patch.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+
+template <typename T>
+struct PatchField {
+    const char* name;
+    std::atomic<T> SynthetizerConfig::* member;
+};
+
+// One value per modulation slot, saved as "mod<slot>_<suffix>" with slots counted from 1
+template <typename T>
+struct PatchSlotField {
+    const char* suffix;
+    std::array<std::atomic<T>, MOD_SLOTS> SynthetizerConfig::* member;
+};
+
+static const PatchField<bool> boolFields[] = {
+    {"osc1_enabled", &SynthetizerConfig::osc1_enabled},
+    {"osc2_enabled", &SynthetizerConfig::osc2_enabled},
+    {"osc3_enabled", &SynthetizerConfig::osc3_enabled},
+    {"osc2_sync", &SynthetizerConfig::osc2_sync},
+    {"osc3_sync", &SynthetizerConfig::osc3_sync},
+    {"osc2_ring", &SynthetizerConfig::osc2_ring},
+    {"osc3_ring", &SynthetizerConfig::osc3_ring},
+    {"lfo1_per_voice", &SynthetizerConfig::lfo1_per_voice},
+    {"lfo2_per_voice", &SynthetizerConfig::lfo2_per_voice},
+};
+
+static const PatchField<int> intFields[] = {
+    {"osc1_waveform", &SynthetizerConfig::osc1_waveform},
+    {"osc2_waveform", &SynthetizerConfig::osc2_waveform},
+    {"osc3_waveform", &SynthetizerConfig::osc3_waveform},
+    {"osc1_unison", &SynthetizerConfig::osc1_unison},
+    {"osc2_unison", &SynthetizerConfig::osc2_unison},
+    {"osc3_unison", &SynthetizerConfig::osc3_unison},
+    {"fm_algorithm", &SynthetizerConfig::fm_algorithm},
+    {"octave", &SynthetizerConfig::octave},
+    {"oversampling", &SynthetizerConfig::oversampling},
+    {"polyphony", &SynthetizerConfig::polyphony},
+    {"lfo1_shape", &SynthetizerConfig::lfo1_shape},
+    {"lfo1_sync", &SynthetizerConfig::lfo1_sync},
+    {"lfo2_shape", &SynthetizerConfig::lfo2_shape},
+    {"lfo2_sync", &SynthetizerConfig::lfo2_sync},
+};
+
+static const PatchField<float> floatFields[] = {
+    {"osc1_freq_offset", &SynthetizerConfig::osc1_freq_offset},
+    {"osc2_freq_offset", &SynthetizerConfig::osc2_freq_offset},
+    {"osc3_freq_offset", &SynthetizerConfig::osc3_freq_offset},
+    {"osc1_fine", &SynthetizerConfig::osc1_fine},
+    {"osc2_fine", &SynthetizerConfig::osc2_fine},
+    {"osc3_fine", &SynthetizerConfig::osc3_fine},
+    {"osc1_unison_detune", &SynthetizerConfig::osc1_unison_detune},
+    {"osc2_unison_detune", &SynthetizerConfig::osc2_unison_detune},
+    {"osc3_unison_detune", &SynthetizerConfig::osc3_unison_detune},
+    {"osc1_unison_spread", &SynthetizerConfig::osc1_unison_spread},
+    {"osc2_unison_spread", &SynthetizerConfig::osc2_unison_spread},
+    {"osc3_unison_spread", &SynthetizerConfig::osc3_unison_spread},
+    {"fm_op1_ratio", &SynthetizerConfig::fm_op1_ratio},
+    {"fm_op2_ratio", &SynthetizerConfig::fm_op2_ratio},
+    {"fm_op3_ratio", &SynthetizerConfig::fm_op3_ratio},
+    {"fm_op4_ratio", &SynthetizerConfig::fm_op4_ratio},
+    {"fm_op5_ratio", &SynthetizerConfig::fm_op5_ratio},
+    {"fm_op6_ratio", &SynthetizerConfig::fm_op6_ratio},
+    {"fm_op1_level", &SynthetizerConfig::fm_op1_level},
+    {"fm_op2_level", &SynthetizerConfig::fm_op2_level},
+    {"fm_op3_level", &SynthetizerConfig::fm_op3_level},
+    {"fm_op4_level", &SynthetizerConfig::fm_op4_level},
+    {"fm_op5_level", &SynthetizerConfig::fm_op5_level},
+    {"fm_op6_level", &SynthetizerConfig::fm_op6_level},
+    {"attack_time", &SynthetizerConfig::attack_time},
+    {"release_time", &SynthetizerConfig::release_time},
+    {"filter_cutoff", &SynthetizerConfig::filter_cutoff},
+    {"filter_resonance", &SynthetizerConfig::filter_resonance},
+    {"filter_auto_amount", &SynthetizerConfig::filter_auto_amount},
+    {"lfo1_rate", &SynthetizerConfig::lfo1_rate},
+    {"lfo2_rate", &SynthetizerConfig::lfo2_rate},
+    {"bend_range", &SynthetizerConfig::bend_range},
+    {"pressure_to_cutoff", &SynthetizerConfig::pressure_to_cutoff},
+    {"timbre_to_cutoff", &SynthetizerConfig::timbre_to_cutoff},
+    {"volume", &SynthetizerConfig::volume},
+};
+
+// Older names, read but no longer written
+static const PatchField<float> legacyFloatFields[] = {
+    // The filter's built-in LFO is LFO 1 now
+    {"filter_auto_freq", &SynthetizerConfig::lfo1_rate},
+};
+
+static const PatchSlotField<int> intSlotFields[] = {
+    {"source", &SynthetizerConfig::mod_source},
+    {"destination", &SynthetizerConfig::mod_destination},
+};
+
+static const PatchSlotField<float> floatSlotFields[] = {
+    {"amount", &SynthetizerConfig::mod_amount},
+};
+
+static std::string slotKey(int slot, const char* suffix) {
+    return "mod" + std::to_string(slot + 1) + "_" + suffix;
+}
+
+template <typename T, size_t N>
+static bool parseField(const PatchField<T> (&fields)[N], const std::string& key,
+                       std::istringstream& value, SynthetizerConfig& config) {
+    for (const auto& field : fields) {
+        if (key == field.name) {
+            T parsed{};
+            value >> parsed;
+            (config.*field.member).store(parsed);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T, size_t N>
+static bool parseSlotField(const PatchSlotField<T> (&fields)[N], const std::string& key,
+                           std::istringstream& value, SynthetizerConfig& config) {
+    for (const auto& field : fields) {
+        for (int slot = 0; slot < MOD_SLOTS; ++slot) {
+            if (key == slotKey(slot, field.suffix)) {
+                T parsed{};
+                value >> parsed;
+                (config.*field.member)[slot].store(parsed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool loadPatch(const std::string& path, SynthetizerConfig& config) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Cannot open patch " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        size_t equals = line.find('=');
+        if (line.empty() || line[0] == '#' || equals == std::string::npos) {
+            continue;
+        }
+        std::istringstream keyStream(line.substr(0, equals));
+        std::string key;
+        keyStream >> key;
+        std::istringstream value(line.substr(equals + 1));
+
+        if (!parseField(boolFields, key, value, config)
+            && !parseField(intFields, key, value, config)
+            && !parseField(floatFields, key, value, config)
+            && !parseField(legacyFloatFields, key, value, config)
+            && !parseSlotField(intSlotFields, key, value, config)
+            && !parseSlotField(floatSlotFields, key, value, config)) {
+            std::cerr << path << ":" << lineNumber << ": unknown patch key " << key << std::endl;
+        }
+    }
+
+    // A synced oscillator plays one copy: unison is switched off rather than silently ignored
+    const std::pair<std::atomic<bool>*, std::atomic<int>*> syncedUnisons[] = {
+        {&config.osc2_sync, &config.osc2_unison}, {&config.osc3_sync, &config.osc3_unison}};
+    for (int i = 0; i < 2; ++i) {
+        if (syncedUnisons[i].first->load() && syncedUnisons[i].second->load() > 1) {
+            std::cerr << path << ": osc" << i + 2 << "_unison is off while osc" << i + 2
+                      << "_sync is on, set to 1" << std::endl;
+            syncedUnisons[i].second->store(1);
+        }
+    }
+    return true;
+}
+
+bool savePatch(const std::string& path, const SynthetizerConfig& config) {
+    std::ofstream file(path);
+    if (!file) {
+        std::cerr << "Cannot write patch " << path << std::endl;
+        return false;
+    }
+    for (const auto& field : boolFields) {
+        file << field.name << " = " << (config.*field.member).load() << "\n";
+    }
+    for (const auto& field : intFields) {
+        file << field.name << " = " << (config.*field.member).load() << "\n";
+    }
+    file.precision(9);
+    for (const auto& field : floatFields) {
+        file << field.name << " = " << (config.*field.member).load() << "\n";
+    }
+    // Only the slots in use, so simple patches stay short
+    for (int slot = 0; slot < MOD_SLOTS; ++slot) {
+        if (config.mod_source[slot].load() == 0 && config.mod_destination[slot].load() == 0) {
+            continue;
+        }
+        for (const auto& field : intSlotFields) {
+            file << slotKey(slot, field.suffix) << " = " << (config.*field.member)[slot].load() << "\n";
+        }
+        for (const auto& field : floatSlotFields) {
+            file << slotKey(slot, field.suffix) << " = " << (config.*field.member)[slot].load() << "\n";
+        }
+    }
+    return true;
+}
+
+void copyPatch(const SynthetizerConfig& from, SynthetizerConfig& to) {
+    for (const auto& field : boolFields) {
+        (to.*field.member).store((from.*field.member).load());
+    }
+    for (const auto& field : intFields) {
+        (to.*field.member).store((from.*field.member).load());
+    }
+    for (const auto& field : floatFields) {
+        (to.*field.member).store((from.*field.member).load());
+    }
+    for (int slot = 0; slot < MOD_SLOTS; ++slot) {
+        for (const auto& field : intSlotFields) {
+            (to.*field.member)[slot].store((from.*field.member)[slot].load());
+        }
+        for (const auto& field : floatSlotFields) {
+            (to.*field.member)[slot].store((from.*field.member)[slot].load());
+        }
+    }
+}
@@ -0,0 +1,133 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/SampleData.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+static uint32_t read32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8
+         | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static uint16_t read16(const unsigned char* p) {
+    return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+static int bytesPerSample(SampleFormat format) {
+    return format == SampleFormat::INT16 ? 2 : format == SampleFormat::INT24 ? 3 : 4;
+}
+
+bool SampleData::setLayout(size_t dataOffset, size_t dataBytes, SampleFormat format, int channels, int sampleRate) {
+    if (channels < 1 || channels > 2 || sampleRate <= 0) {
+        std::cerr << "Unsupported sample layout: " << channels << " channels at " << sampleRate << " Hz" << std::endl;
+        return false;
+    }
+    this->format = format;
+    this->channels = channels;
+    this->sampleRate = sampleRate;
+    bytesPerFrame = static_cast<size_t>(bytesPerSample(format)) * channels;
+    dataBytes = std::min(dataBytes, file.size() - dataOffset);
+    frames = dataBytes / bytesPerFrame;
+    frameData = file.data() + dataOffset;
+    return frames > 0;
+}
+
+bool SampleData::prefault(float seconds) {
+    size_t count = std::min(frames, static_cast<size_t>(seconds * sampleRate)) * bytesPerFrame;
+    return file.prefault(static_cast<size_t>(frameData - file.data()), count);
+}
+
+template <SampleFormat Format>
+static void decodeFrames(const unsigned char* p, size_t count, size_t stride, size_t rightOffset, float* stereo) {
+    for (size_t i = 0; i < count; ++i, p += stride) {
+        stereo[i * 2] = decodeSample<Format>(p);
+        stereo[i * 2 + 1] = decodeSample<Format>(p + rightOffset);
+    }
+}
+
+void SampleData::readFrames(size_t first, size_t count, float* stereo) const {
+    const unsigned char* p = frameData + first * bytesPerFrame;
+    const size_t rightOffset = channels == 2 ? bytesPerFrame / 2 : 0;
+    switch (format) {
+        case SampleFormat::INT16: decodeFrames<SampleFormat::INT16>(p, count, bytesPerFrame, rightOffset, stereo); break;
+        case SampleFormat::INT24: decodeFrames<SampleFormat::INT24>(p, count, bytesPerFrame, rightOffset, stereo); break;
+        case SampleFormat::FLOAT32: decodeFrames<SampleFormat::FLOAT32>(p, count, bytesPerFrame, rightOffset, stereo); break;
+    }
+}
+
+std::shared_ptr<SampleData> SampleData::loadWav(const std::string& path) {
+    auto sample = std::make_shared<SampleData>();
+    if (!sample->file.open(path)) {
+        return nullptr;
+    }
+    const unsigned char* bytes = sample->file.data();
+    const size_t size = sample->file.size();
+    if (size < 12 || std::memcmp(bytes, "RIFF", 4) != 0 || std::memcmp(bytes + 8, "WAVE", 4) != 0) {
+        std::cerr << path << " is not a WAV file" << std::endl;
+        return nullptr;
+    }
+
+    // Walk the chunks, only the header bytes are touched here, not the audio
+    int formatTag = 0, channels = 0, sampleRate = 0, bits = 0;
+    size_t dataOffset = 0, dataBytes = 0;
+    for (size_t offset = 12; offset + 8 <= size;) {
+        const unsigned char* chunk = bytes + offset;
+        size_t chunkSize = read32(chunk + 4);
+        const unsigned char* body = chunk + 8;
+        size_t available = size - offset - 8;
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16) {
+            formatTag = read16(body);
+            channels = read16(body + 2);
+            sampleRate = static_cast<int>(read32(body + 4));
+            bits = read16(body + 14);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of its sub-format GUID
+            if (formatTag == 0xFFFE && available >= 26) {
+                formatTag = read16(body + 24);
+            }
+        } else if (std::memcmp(chunk, "smpl", 4) == 0 && available >= 16) {
+            sample->rootNote = static_cast<int>(read32(body + 12));
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            dataOffset = offset + 8;
+            dataBytes = std::min(chunkSize, available);
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    SampleFormat format;
+    if (formatTag == 1 && bits == 16) {
+        format = SampleFormat::INT16;
+    } else if (formatTag == 1 && bits == 24) {
+        format = SampleFormat::INT24;
+    } else if (formatTag == 3 && bits == 32) {
+        format = SampleFormat::FLOAT32;
+    } else {
+        std::cerr << path << ": unsupported WAV encoding (format " << formatTag << ", " << bits << " bits)" << std::endl;
+        return nullptr;
+    }
+    if (dataOffset == 0 || !sample->setLayout(dataOffset, dataBytes, format, channels, sampleRate)) {
+        std::cerr << path << " has no audio data" << std::endl;
+        return nullptr;
+    }
+    sample->rootNote = std::clamp(sample->rootNote, 0, 127);
+    sample->prefault(SAMPLE_PREFAULT_SECONDS);
+    return sample;
+}
+
+std::shared_ptr<SampleData> SampleData::loadRaw(const std::string& path, const RawSampleInfo& info) {
+    auto sample = std::make_shared<SampleData>();
+    if (!sample->file.open(path)) {
+        return nullptr;
+    }
+    if (!sample->setLayout(0, sample->file.size(), info.format, info.channels, info.sampleRate)) {
+        std::cerr << path << " has no audio data" << std::endl;
+        return nullptr;
+    }
+    sample->rootNote = std::clamp(info.rootNote, 0, 127);
+    sample->prefault(SAMPLE_PREFAULT_SECONDS);
+    return sample;
+}
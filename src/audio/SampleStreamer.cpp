@@ -0,0 +1,183 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/SampleStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+static constexpr int GENERATION_SHIFT = 40;
+static constexpr uint64_t FRAME_MASK = (uint64_t{1} << GENERATION_SHIFT) - 1;
+static constexpr uint32_t GENERATION_MASK = (1u << (64 - GENERATION_SHIFT)) - 1;
+
+static int nextPowerOfTwo(int value) {
+    int power = 1;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+StreamVoice::StreamVoice(std::shared_ptr<const SampleData> sample, std::shared_ptr<const std::vector<float>> head,
+                         int ringFrames)
+    : sample(sample),
+      head(head),
+      frames(static_cast<long long>(sample->getFrames())),
+      headFrames(static_cast<long long>(head->size() / 2)),
+      ring(static_cast<size_t>(ringFrames) * 2, 0.0f),
+      ringFrames(ringFrames),
+      ringMask(ringFrames - 1) {}
+
+void StreamVoice::retrigger() {
+    lowestNeeded.store(0, std::memory_order_relaxed);
+    playing.store(true, std::memory_order_relaxed);
+    // Publishes the two stores above to the I/O thread with the new generation
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+long long StreamVoice::readyFrames() const {
+    uint64_t state = published.load(std::memory_order_acquire);
+    uint32_t current = generation.load(std::memory_order_relaxed);
+    // Frames written for an earlier note are never read, only the head is valid until the refill starts
+    if (static_cast<uint32_t>(state >> GENERATION_SHIFT) != (current & GENERATION_MASK)) {
+        return headFrames;
+    }
+    return std::max(headFrames, static_cast<long long>(state & FRAME_MASK));
+}
+
+void StreamVoice::release(long long lowestNeeded, float framesPerSecond, bool stillPlaying) {
+    this->framesPerSecond.store(framesPerSecond, std::memory_order_relaxed);
+    this->lowestNeeded.store(lowestNeeded, std::memory_order_release);
+    if (!stillPlaying) {
+        playing.store(false, std::memory_order_relaxed);
+    }
+}
+
+void StreamVoice::countUnderrun(bool newUnderrun) {
+    underrunFrames.fetch_add(1, std::memory_order_relaxed);
+    if (newUnderrun) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SampleStreamer::SampleStreamer(int ringFrames, float headSeconds)
+    : ringFrames(nextPowerOfTwo(std::max(ringFrames, STREAM_CHUNK_FRAMES * 2))),
+      headSeconds(headSeconds) {}
+
+SampleStreamer::~SampleStreamer() {
+    stop();
+}
+
+StreamVoice* SampleStreamer::createVoice(std::shared_ptr<const SampleData> sample) {
+    std::shared_ptr<const std::vector<float>>& head = heads[sample.get()];
+    if (!head) {
+        size_t headFrames = std::min(sample->getFrames(), static_cast<size_t>(headSeconds * sample->getSampleRate()));
+        auto decoded = std::make_shared<std::vector<float>>(headFrames * 2);
+        sample->readFrames(0, headFrames, decoded->data());
+        head = decoded;
+    }
+    int size = std::max(ringFrames, nextPowerOfTwo(static_cast<int>(head->size() / 2) + STREAM_CHUNK_FRAMES * 2));
+    voices.push_back(std::make_unique<StreamVoice>(sample, head, size));
+    return voices.back().get();
+}
+
+void SampleStreamer::start() {
+    startTime = std::chrono::steady_clock::now();
+    running = true;
+    thread = std::thread(&SampleStreamer::run, this);
+}
+
+void SampleStreamer::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+        stoppedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+}
+
+// Refills the voice with the least buffered time first: a voice pitched up drains its ring faster
+// than one at its root note, so frames alone would pick the wrong voice.
+void SampleStreamer::run() {
+    while (running.load(std::memory_order_relaxed)) {
+        StreamVoice* neediest = nullptr;
+        double soonest = std::numeric_limits<double>::infinity();
+
+        for (auto& voice : voices) {
+            uint32_t generation = voice->generation.load(std::memory_order_acquire);
+            if (generation != voice->fetchGeneration) {
+                // New note: stream on from the end of the head
+                voice->fetchGeneration = generation;
+                voice->fetchFrame = voice->headFrames;
+            }
+            if (!voice->playing.load(std::memory_order_relaxed) || voice->fetchFrame >= voice->frames) {
+                continue;
+            }
+            long long needed = voice->lowestNeeded.load(std::memory_order_acquire);
+            if (voice->fetchFrame + STREAM_CHUNK_FRAMES > needed + voice->ringFrames) {
+                continue;   // ring full
+            }
+            double rate = std::max(voice->framesPerSecond.load(std::memory_order_relaxed), 1.0f);
+            double starvesIn = (voice->fetchFrame - needed) / rate;
+            if (starvesIn < soonest) {
+                soonest = starvesIn;
+                neediest = voice.get();
+            }
+        }
+
+        if (!neediest || !refill(*neediest)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+bool SampleStreamer::refill(StreamVoice& voice) {
+    auto start = std::chrono::steady_clock::now();
+    long long count = std::min<long long>(STREAM_CHUNK_FRAMES, voice.frames - voice.fetchFrame);
+    if (count <= 0) {
+        return false;
+    }
+    // Split where the chunk wraps around the end of the ring
+    long long done = 0;
+    while (done < count) {
+        long long frame = voice.fetchFrame + done;
+        long long slot = frame & voice.ringMask;
+        long long run = std::min(count - done, voice.ringFrames - slot);
+        voice.sample->readFrames(static_cast<size_t>(frame), static_cast<size_t>(run), voice.ring.data() + slot * 2);
+        done += run;
+    }
+    voice.fetchFrame += count;
+
+    // The tag is the generation seen before copying: if the note restarted meanwhile, the audio thread
+    // ignores this publication and the next pass starts over
+    uint64_t tag = static_cast<uint64_t>(voice.fetchGeneration & GENERATION_MASK) << GENERATION_SHIFT;
+    voice.published.store(tag | static_cast<uint64_t>(voice.fetchFrame), std::memory_order_release);
+
+    bytesRead.fetch_add(static_cast<uint64_t>(count) * voice.sample->getBytesPerFrame(), std::memory_order_relaxed);
+    double busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    busySeconds.store(busySeconds.load(std::memory_order_relaxed) + busy, std::memory_order_relaxed);
+    return true;
+}
+
+StreamStats SampleStreamer::getStats() const {
+    StreamStats stats;
+    for (const auto& voice : voices) {
+        stats.underruns += voice->underruns.load(std::memory_order_relaxed);
+        stats.underrunFrames += voice->underrunFrames.load(std::memory_order_relaxed);
+    }
+    stats.bytesRead = bytesRead.load(std::memory_order_relaxed);
+    stats.busySeconds = busySeconds.load(std::memory_order_relaxed);
+    stats.seconds = running.load(std::memory_order_relaxed)
+        ? std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count()
+        : stoppedSeconds;
+    return stats;
+}
+
+void printStreamStats(const StreamStats& stats) {
+    double megabytes = stats.bytesRead / 1.0e6;
+    std::cout << "Sample streaming: " << megabytes << " MB read in " << stats.seconds << " s ("
+              << (stats.busySeconds > 0.0 ? megabytes / stats.busySeconds : 0.0) << " MB/s while reading), "
+              << stats.underruns << " underruns (" << stats.underrunFrames << " frames late)" << std::endl;
+}
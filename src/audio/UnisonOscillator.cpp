@@ -0,0 +1,96 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/UnisonOscillator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../../include/audio/Simd.h"
+
+// Starting phases of the copies, multiples of the golden ratio so no two copies start together
+// (in phase copies would sweep like a flanger) and the first copy starts like a single oscillator
+constexpr float UNISON_PHASE_STEP = 0.618034f;
+
+void UnisonOscillator::prepare(float sampleRate) {
+    this->sampleRate = sampleRate;
+    reset();
+}
+
+void UnisonOscillator::reset() {
+    for (int k = 0; k < MAX_UNISON; ++k) {
+        float phase = static_cast<float>(k) * UNISON_PHASE_STEP;
+        phases[k] = phase - std::floor(phase);
+    }
+}
+
+void UnisonOscillator::setShape(int copies, float detune, float spread) {
+    copies = std::clamp(copies, 1, MAX_UNISON);
+    spread = std::clamp(spread, 0.0f, 1.0f);
+    if (copies == this->copies && detune == this->detune && spread == this->spread) {
+        return;
+    }
+    this->copies = copies;
+    this->detune = detune;
+    this->spread = spread;
+    lanes = (copies + 3) / 4 * 4;
+
+    // Copies evenly spaced from -detune to +detune, the lowest on the left; the sum keeps about the
+    // loudness of one copy since detuned copies add up in power
+    const float gain = 1.0f / std::sqrt(static_cast<float>(copies));
+    for (int k = 0; k < MAX_UNISON; ++k) {
+        if (k >= copies) {
+            ratios[k] = 1.0f;
+            leftGains[k] = rightGains[k] = 0.0f;
+            continue;
+        }
+        float position = copies == 1 ? 0.0f : 2.0f * k / (copies - 1) - 1.0f;
+        float pan = spread * position;
+        ratios[k] = std::exp2(detune * position / 12.0f);
+        leftGains[k] = gain * std::min(1.0f, 1.0f - pan);
+        rightGains[k] = gain * std::min(1.0f, 1.0f + pan);
+    }
+}
+
+void UnisonOscillator::generateBuffer(float* buffer, int numFrames, WaveformType waveform,
+                                      float startFrequency, float endFrequency) {
+    std::fill_n(buffer, numFrames * 2, 0.0f);
+    switch (waveform) {
+        case WaveformType::TRIANGLE: render<WaveformType::TRIANGLE>(buffer, numFrames, startFrequency, endFrequency); break;
+        case WaveformType::SAW: render<WaveformType::SAW>(buffer, numFrames, startFrequency, endFrequency); break;
+        default: break;
+    }
+}
+
+// One pass over the buffer per group of four copies, their state held in registers for the whole block
+template <WaveformType Waveform>
+void UnisonOscillator::render(float* buffer, int numFrames, float startFrequency, float endFrequency) {
+    const Float4 one = Float4::broadcast(1.0f);
+    const Float4 half = Float4::broadcast(0.5f);
+    const Float4 two = Float4::broadcast(2.0f);
+    const Float4 startIncrement = Float4::broadcast(startFrequency / sampleRate);
+    const Float4 incrementStep = Float4::broadcast((endFrequency - startFrequency) / sampleRate / numFrames);
+
+    for (int group = 0; group < lanes; group += 4) {
+        const Float4 ratio = Float4::load(ratios.data() + group);
+        const Float4 leftGain = Float4::load(leftGains.data() + group);
+        const Float4 rightGain = Float4::load(rightGains.data() + group);
+        const Float4 steps = incrementStep * ratio;
+        Float4 increment = startIncrement * ratio;
+        Float4 phase = Float4::load(phases.data() + group);
+
+        for (int i = 0; i < numFrames * 2; i += 2) {
+            Float4 wave = Waveform == WaveformType::SAW
+                ? phase - half
+                : half - two * abs(phase - half);
+            buffer[i] += (wave * leftGain).sum();
+            buffer[i + 1] += (wave * rightGain).sum();
+
+            phase += increment;
+            phase = phase - step(one, phase);
+            increment += steps;
+        }
+        phase.store(phases.data() + group);
+    }
+}
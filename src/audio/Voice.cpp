@@ -0,0 +1,272 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/Voice.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../../include/audio/Pitch.h"
+#include "../../include/audio/VoiceKernels.h"
+
+// Share of the remaining distance covered per control block, about 2 ms to settle at 48 kHz
+constexpr float EXPRESSION_SMOOTHING = 0.3f;
+// Closer than this the expression snaps to its target and the voice renders unsplit again
+constexpr float EXPRESSION_EPSILON = 1e-4f;
+
+// In the order renderSpan() fills them
+void Voice::allocate(DspArena& arena, int maxChainFrames) {
+    masterBuffer = arena.allocate<float>(maxChainFrames * 2);
+    masterWraps = arena.allocate<float>(maxChainFrames);
+    oscBuffer = arena.allocate<float>(maxChainFrames * 2);
+    voiceBuffer = arena.allocate<float>(maxChainFrames * 2);
+}
+
+void Voice::prepare(float chainRate) {
+    envelope.prepare(chainRate);
+    setChainRate(chainRate);
+    note = -1;
+    held = false;
+}
+
+void Voice::setChainRate(float chainRate) {
+    this->chainRate = chainRate;
+    for (auto& osc : oscillators) {
+        osc.prepare(chainRate);
+    }
+    for (auto& unison : unisons) {
+        unison.prepare(chainRate);
+    }
+    envelope.setSampleRate(chainRate);
+    filter.prepare(chainRate);
+}
+
+void Voice::setSeed(uint32_t seed) {
+    for (size_t i = 0; i < oscillators.size(); ++i) {
+        oscillators[i].setSeed(seed + static_cast<uint32_t>(i));
+    }
+    for (size_t i = 0; i < lfos.size(); ++i) {
+        lfos[i].setSeed((seed + 1) * 7919u + static_cast<uint32_t>(i));
+    }
+}
+
+void Voice::setSample(const SampleData* sample) {
+    for (auto& osc : oscillators) {
+        osc.setSample(sample);
+    }
+}
+
+void Voice::setStream(int oscillator, StreamVoice* stream) {
+    oscillators[oscillator].setStream(stream);
+}
+
+void Voice::noteOn(int note, int channel, float pitch, float velocity, uint64_t age,
+                   const VoiceExpression& expression) {
+    this->note = note;
+    this->channel = channel;
+    this->pitch = pitch;
+    this->velocity = velocity;
+    this->age = age;
+    target = expression;
+    current = expression;
+    modulationReset = true;
+    held = true;
+    for (auto& osc : oscillators) {
+        osc.retrigger();
+    }
+    for (auto& unison : unisons) {
+        unison.reset();
+    }
+    for (auto& lfo : lfos) {
+        lfo.reset();
+    }
+    // A stolen voice glides on from its current level rather than clicking to zero
+    envelope.noteOn();
+}
+
+void Voice::noteOff() {
+    held = false;
+    envelope.noteOff();
+}
+
+// Modulation a fraction t of the way from a to b
+static VoiceModulation interpolate(const VoiceModulation& a, const VoiceModulation& b, float t) {
+    return {a.pitch + (b.pitch - a.pitch) * t,
+            a.cutoff + (b.cutoff - a.cutoff) * t,
+            a.cutoffHz + (b.cutoffHz - a.cutoffHz) * t,
+            a.resonance + (b.resonance - a.resonance) * t,
+            a.amplitude + (b.amplitude - a.amplitude) * t,
+            a.pan + (b.pan - a.pan) * t};
+}
+
+void Voice::render(const SynthetizerConfig& params, float* mix, int chainFrames, int controlFrames,
+                   const VoiceModulation& modulation, const float* fm) {
+    const VoiceModulation start = modulationReset ? modulation : this->modulation;
+    modulationReset = false;
+
+    int done = 0;
+    while (done < chainFrames) {
+        // Settled expression renders the rest in one go, a moving one one control block at a time
+        int frames = chainFrames - done;
+        if (current != target) {
+            stepExpression();
+            frames = std::min(frames, controlFrames);
+        }
+        renderSpan(params, mix + done * 2, frames,
+                   interpolate(start, modulation, static_cast<float>(done) / chainFrames),
+                   interpolate(start, modulation, static_cast<float>(done + frames) / chainFrames),
+                   fm ? fm + done : nullptr);
+        done += frames;
+    }
+    this->modulation = modulation;
+}
+
+void Voice::stepExpression() {
+    auto step = [](float& value, float goal) {
+        value += (goal - value) * EXPRESSION_SMOOTHING;
+        if (std::abs(goal - value) < EXPRESSION_EPSILON) {
+            value = goal;
+        }
+    };
+    step(current.bend, target.bend);
+    step(current.pressure, target.pressure);
+    step(current.timbre, target.timbre);
+}
+
+void Voice::renderSpan(const SynthetizerConfig& params, float* mix, int chainFrames,
+                       const VoiceModulation& from, const VoiceModulation& to, const float* fm) {
+    const std::atomic<bool>* enabled[] = {&params.osc1_enabled, &params.osc2_enabled, &params.osc3_enabled};
+    const std::atomic<int>* waveforms[] = {&params.osc1_waveform, &params.osc2_waveform, &params.osc3_waveform};
+    const std::atomic<float>* offsets[] = {&params.osc1_freq_offset, &params.osc2_freq_offset, &params.osc3_freq_offset};
+    const std::atomic<float>* fines[] = {&params.osc1_fine, &params.osc2_fine, &params.osc3_fine};
+    const std::atomic<int>* unisonCopies[] = {&params.osc1_unison, &params.osc2_unison, &params.osc3_unison};
+    const std::atomic<float>* unisonDetunes[] = {&params.osc1_unison_detune, &params.osc2_unison_detune,
+                                                 &params.osc3_unison_detune};
+    const std::atomic<float>* unisonSpreads[] = {&params.osc1_unison_spread, &params.osc2_unison_spread,
+                                                 &params.osc3_unison_spread};
+    // Everything adds up in semitones; each oscillator converts to Hz once per end of the span
+    const float bentPitch = pitch + current.bend * params.bend_range.load();
+    const float startPitch = bentPitch + from.pitch;
+    const float endPitch = bentPitch + to.pitch;
+    const float cutoffOctaves = current.pressure * params.pressure_to_cutoff.load()
+                              + current.timbre * params.timbre_to_cutoff.load();
+
+    bool on[3];
+    WaveformType waveform[3];
+    int copies[3];
+    float startFrequency[3] = {};
+    float endFrequency[3] = {};
+    const bool sync[3] = {false, params.osc2_sync.load(), params.osc3_sync.load()};
+    const bool ring[3] = {false, params.osc2_ring.load(), params.osc3_ring.load()};
+    bool unison = false;
+    for (int i = 0; i < 3; ++i) {
+        on[i] = enabled[i]->load();
+    }
+    // Oscillator 1 also runs, plain, as the sync and ring source of the other two
+    const bool master = (on[1] && (sync[1] || ring[1])) || (on[2] && (sync[2] || ring[2]));
+    for (int i = 0; i < 3; ++i) {
+        waveform[i] = static_cast<WaveformType>(waveforms[i]->load());
+        copies[i] = unisonCopies[i]->load();
+        if (!on[i] && !(i == 0 && master)) {
+            continue;
+        }
+        const float detune = offsets[i]->load() + fines[i]->load() * 0.01f;
+        startFrequency[i] = semitonesToFrequency(startPitch + detune);
+        endFrequency[i] = endPitch == startPitch ? startFrequency[i] : semitonesToFrequency(endPitch + detune);
+        unison = unison || (copies[i] > 1 && UnisonOscillator::supports(waveform[i]));
+    }
+
+    // Triangles and saws without unison: one loop compiled for exactly this combination
+    VoiceKernel kernel = unison || master ? nullptr : findVoiceKernel(on, waveform);
+    if (kernel) {
+        VoiceKernelState state;
+        for (int i = 0; i < 3; ++i) {
+            state.phases[i] = oscillators[i].getPhase();
+            state.increments[i] = startFrequency[i] / chainRate;
+            state.incrementSteps[i] = (endFrequency[i] - startFrequency[i]) / chainRate / chainFrames;
+        }
+        kernel(state, voiceBuffer.data(), chainFrames);
+        for (int i = 0; i < 3; ++i) {
+            if (on[i]) {
+                oscillators[i].setPhase(state.phases[i]);
+            }
+        }
+    } else {
+        std::fill_n(voiceBuffer.begin(), chainFrames * 2, 0.0f);
+        // The plain oscillator 1 is the sync clock and ring source; its unison copies, when it has
+        // them, are what is heard
+        const bool masterAudible = on[0] && !(copies[0] > 1 && UnisonOscillator::supports(waveform[0]));
+        if (master) {
+            oscillators[0].generateBuffer(masterBuffer.data(), chainFrames, waveform[0],
+                                          startFrequency[0], endFrequency[0], masterWraps.data());
+            if (masterAudible) {
+                std::copy_n(masterBuffer.begin(), chainFrames * 2, voiceBuffer.begin());
+            }
+        }
+        for (int i = 0; i < 3; ++i) {
+            if (!on[i] || (i == 0 && master && masterAudible)) {
+                continue;
+            }
+            // A synced oscillator plays a single copy, its unison setting is ignored (and shown so in the UI)
+            if (sync[i]) {
+                oscillators[i].generateSynced(oscBuffer.data(), chainFrames, waveform[i],
+                                              startFrequency[i], endFrequency[i], masterWraps.data());
+            } else if (copies[i] > 1 && UnisonOscillator::supports(waveform[i])) {
+                unisons[i].setShape(copies[i], unisonDetunes[i]->load(), unisonSpreads[i]->load());
+                unisons[i].generateBuffer(oscBuffer.data(), chainFrames, waveform[i],
+                                          startFrequency[i], endFrequency[i]);
+            } else {
+                oscillators[i].generateBuffer(oscBuffer.data(), chainFrames, waveform[i],
+                                              startFrequency[i], endFrequency[i]);
+            }
+            if (ring[i]) {
+                // Both at +-0.5: twice the product keeps the ring output at the same level
+                for (int s = 0; s < chainFrames * 2; ++s) {
+                    oscBuffer[s] *= 2.0f * masterBuffer[s];
+                }
+            }
+            for (int s = 0; s < chainFrames * 2; ++s) {
+                voiceBuffer[s] += oscBuffer[s];
+            }
+        }
+    }
+
+    if (fm) {
+        for (int s = 0; s < chainFrames; ++s) {
+            voiceBuffer[s * 2] += fm[s];
+            voiceBuffer[s * 2 + 1] += fm[s];
+        }
+    }
+
+    envelope.setAttackTime(params.attack_time.load());
+    envelope.setReleaseTime(params.release_time.load());
+    envelope.processBuffer(voiceBuffer.data(), chainFrames);
+
+    const float cutoff = params.filter_cutoff.load();
+    filter.processBuffer(
+        voiceBuffer.data(), chainFrames,
+        cutoff * std::exp2(cutoffOctaves + from.cutoff) + from.cutoffHz,
+        cutoff * std::exp2(cutoffOctaves + to.cutoff) + to.cutoffHz,
+        std::clamp(params.filter_resonance.load() + to.resonance, 0.0f, 1.0f)
+    );
+
+    // Amplitude and a balance pan (unity gain in the center), both gliding per sample
+    auto gains = [this](const VoiceModulation& m, float& left, float& right) {
+        float gain = velocity * std::max(0.0f, 1.0f + m.amplitude);
+        float pan = std::clamp(m.pan, -1.0f, 1.0f);
+        left = gain * std::min(1.0f, 1.0f - pan);
+        right = gain * std::min(1.0f, 1.0f + pan);
+    };
+    float left, right, endLeft, endRight;
+    gains(from, left, right);
+    gains(to, endLeft, endRight);
+    const float leftStep = (endLeft - left) / chainFrames;
+    const float rightStep = (endRight - right) / chainFrames;
+    for (int s = 0; s < chainFrames * 2; s += 2) {
+        mix[s] += voiceBuffer[s] * left;
+        mix[s + 1] += voiceBuffer[s + 1] * right;
+        left += leftStep;
+        right += rightStep;
+    }
+}
@@ -0,0 +1,87 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/audio/VoiceKernels.h"
+
+#include <array>
+#include <utility>
+
+// Waveforms a kernel is compiled for
+enum class KernelWave { OFF, TRIANGLE, SAW, COUNT };
+constexpr int KERNEL_WAVE_COUNT = static_cast<int>(KernelWave::COUNT);
+constexpr int VOICE_KERNEL_COUNT = KERNEL_WAVE_COUNT * KERNEL_WAVE_COUNT * KERNEL_WAVE_COUNT;
+
+// Same expressions as Oscillator::generateBuffer, so both paths render bit for bit alike
+template <KernelWave Wave>
+static inline void addOscillator(float& sum, float& phase, float& increment, float incrementStep) {
+    if constexpr (Wave == KernelWave::OFF) {
+        return;
+    } else {
+        float sample;
+        if constexpr (Wave == KernelWave::TRIANGLE) {
+            sample = phase < 0.5f ? 4.0f * phase - 1.0f : 3.0f - 4.0f * phase;
+            sample *= 0.5f;
+        } else {
+            sample = (2.0f * phase - 1.0f) * 0.5f;
+        }
+        sum += sample;
+        phase += increment;
+        if (phase >= 1.0f) {
+            phase -= 1.0f;
+        }
+        increment += incrementStep;
+    }
+}
+
+template <KernelWave Wave1, KernelWave Wave2, KernelWave Wave3>
+static void renderOscillators(VoiceKernelState& state, float* out, int numFrames) {
+    float phase1 = state.phases[0], phase2 = state.phases[1], phase3 = state.phases[2];
+    float increment1 = state.increments[0], increment2 = state.increments[1], increment3 = state.increments[2];
+    const float step1 = state.incrementSteps[0], step2 = state.incrementSteps[1], step3 = state.incrementSteps[2];
+    for (int i = 0; i < numFrames * 2; i += 2) {
+        float sum = 0.0f;
+        addOscillator<Wave1>(sum, phase1, increment1, step1);
+        addOscillator<Wave2>(sum, phase2, increment2, step2);
+        addOscillator<Wave3>(sum, phase3, increment3, step3);
+        out[i] = sum;
+        out[i + 1] = sum;
+    }
+    state.phases[0] = phase1;
+    state.phases[1] = phase2;
+    state.phases[2] = phase3;
+    state.increments[0] = increment1;
+    state.increments[1] = increment2;
+    state.increments[2] = increment3;
+}
+
+// Table index w1 * 9 + w2 * 3 + w3
+template <size_t... I>
+static constexpr std::array<VoiceKernel, sizeof...(I)> makeKernels(std::index_sequence<I...>) {
+    constexpr int n = KERNEL_WAVE_COUNT;
+    return {&renderOscillators<static_cast<KernelWave>(I / (n * n)), static_cast<KernelWave>(I / n % n),
+                               static_cast<KernelWave>(I % n)>...};
+}
+
+static constexpr std::array<VoiceKernel, VOICE_KERNEL_COUNT> kernels =
+    makeKernels(std::make_index_sequence<VOICE_KERNEL_COUNT>{});
+
+VoiceKernel findVoiceKernel(const bool* enabled, const WaveformType* waveforms) {
+    int index = 0;
+    for (int i = 0; i < 3; ++i) {
+        KernelWave wave = KernelWave::OFF;
+        if (enabled[i]) {
+            switch (waveforms[i]) {
+                case WaveformType::TRIANGLE: wave = KernelWave::TRIANGLE; break;
+                case WaveformType::SAW: wave = KernelWave::SAW; break;
+                default: return nullptr;
+            }
+        }
+        index = index * KERNEL_WAVE_COUNT + static_cast<int>(wave);
+    }
+    return kernels[index];
+}
+
+int voiceKernelCount() {
+    return VOICE_KERNEL_COUNT;
+}
@@ -0,0 +1,154 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/backend/AlsaMidiInput.h"
+
+#ifdef SYNTH_HAVE_ALSA
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <poll.h>
+
+#include "../../include/backend/RealtimeThread.h"
+
+// How often the thread checks for stop() while no MIDI arrives
+constexpr int ALSA_MIDI_POLL_MS = 100;
+
+AlsaMidiInput::AlsaMidiInput(std::shared_ptr<MidiInputQueue> queue) : queue(std::move(queue)) {}
+
+AlsaMidiInput::~AlsaMidiInput() {
+    close();
+}
+
+bool AlsaMidiInput::open(const std::string& source) {
+    if (snd_seq_open(&sequencer, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0) {
+        std::cerr << "ALSA sequencer open failed" << std::endl;
+        sequencer = nullptr;
+        return false;
+    }
+    snd_seq_set_client_name(sequencer, "synth");
+    port = snd_seq_create_simple_port(sequencer, "midi_in",
+                                      SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE,
+                                      SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    if (port < 0) {
+        std::cerr << "ALSA sequencer port creation failed: " << snd_strerror(port) << std::endl;
+        close();
+        return false;
+    }
+
+    if (!source.empty()) {
+        snd_seq_addr_t address;
+        if (snd_seq_parse_address(sequencer, &address, source.c_str()) < 0) {
+            std::cerr << "Unknown ALSA MIDI source " << source << " (see aconnect -i)" << std::endl;
+            close();
+            return false;
+        }
+        int result = snd_seq_connect_from(sequencer, port, address.client, address.port);
+        if (result < 0) {
+            std::cerr << "ALSA MIDI connect from " << source << " failed: " << snd_strerror(result) << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    std::cout << "MIDI input: ALSA sequencer " << snd_seq_client_id(sequencer) << ":" << port
+              << (source.empty() ? "" : ", connected from " + source) << std::endl;
+    return true;
+}
+
+void AlsaMidiInput::start(const RealtimeOptions& realtime) {
+    if (!sequencer || running) {
+        return;
+    }
+    running = true;
+    thread = std::thread([this, realtime]() {
+        if (realtime.policy != RealtimePolicy::NONE) {
+            // Just below the audio thread, so a burst of MIDI cannot delay a period
+            RealtimeOptions options = realtime;
+            options.priority = std::max(1, realtime.priority - 1);
+            RealtimeReport report;
+            promoteCurrentThread(options, report);
+        }
+        run();
+    });
+}
+
+void AlsaMidiInput::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void AlsaMidiInput::close() {
+    stop();
+    if (sequencer) {
+        snd_seq_close(sequencer);
+        sequencer = nullptr;
+        port = -1;
+    }
+}
+
+void AlsaMidiInput::run() {
+    std::vector<pollfd> descriptors(snd_seq_poll_descriptors_count(sequencer, POLLIN));
+    snd_seq_poll_descriptors(sequencer, descriptors.data(), static_cast<unsigned int>(descriptors.size()), POLLIN);
+
+    while (running.load(std::memory_order_relaxed)) {
+        if (poll(descriptors.data(), descriptors.size(), ALSA_MIDI_POLL_MS) <= 0) {
+            continue;
+        }
+        // Drain everything that is pending, stamped as it is read
+        snd_seq_event_t* event = nullptr;
+        while (snd_seq_event_input(sequencer, &event) >= 0 && event) {
+            TimedMidiMessage message;
+            if (toMessage(*event, message)) {
+                message.nanoseconds = MidiInputQueue::now();
+                queue->push(message);
+            }
+        }
+    }
+}
+
+bool AlsaMidiInput::toMessage(const snd_seq_event_t& event, TimedMidiMessage& message) {
+    switch (event.type) {
+        case SND_SEQ_EVENT_NOTEON:
+        case SND_SEQ_EVENT_NOTEOFF:
+        case SND_SEQ_EVENT_KEYPRESS: {
+            uint8_t status = event.type == SND_SEQ_EVENT_NOTEON ? 0x90
+                           : event.type == SND_SEQ_EVENT_NOTEOFF ? 0x80 : 0xA0;
+            message.size = 3;
+            message.data[0] = static_cast<uint8_t>(status | (event.data.note.channel & 0x0F));
+            message.data[1] = event.data.note.note & 0x7F;
+            message.data[2] = event.data.note.velocity & 0x7F;
+            return true;
+        }
+        case SND_SEQ_EVENT_CONTROLLER:
+            message.size = 3;
+            message.data[0] = static_cast<uint8_t>(0xB0 | (event.data.control.channel & 0x0F));
+            message.data[1] = event.data.control.param & 0x7F;
+            message.data[2] = event.data.control.value & 0x7F;
+            return true;
+        case SND_SEQ_EVENT_PGMCHANGE:
+        case SND_SEQ_EVENT_CHANPRESS:
+            message.size = 2;
+            message.data[0] = static_cast<uint8_t>((event.type == SND_SEQ_EVENT_PGMCHANGE ? 0xC0 : 0xD0)
+                                                   | (event.data.control.channel & 0x0F));
+            message.data[1] = event.data.control.value & 0x7F;
+            return true;
+        case SND_SEQ_EVENT_PITCHBEND: {
+            // The sequencer gives -8192..8191, MIDI sends 14 bits centered on 8192
+            int value = std::clamp(event.data.control.value + 8192, 0, 16383);
+            message.size = 3;
+            message.data[0] = static_cast<uint8_t>(0xE0 | (event.data.control.channel & 0x0F));
+            message.data[1] = value & 0x7F;
+            message.data[2] = (value >> 7) & 0x7F;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+#endif //SYNTH_HAVE_ALSA
@@ -0,0 +1,29 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/backend/AudioBackend.h"
+
+void AudioBackend::setRealtimeOptions(const RealtimeOptions& options) {
+    realtimeOptions = options;
+}
+
+const RealtimeReport* AudioBackend::getRealtimeReport() const {
+    return realtimeReportReady.load(std::memory_order_acquire) ? &realtimeReport : nullptr;
+}
+
+void AudioBackend::resetRealtimePromotion() {
+    realtimeReportReady.store(false, std::memory_order_relaxed);
+    realtimeReport = RealtimeReport();
+    audioThreadPromoted = false;
+}
+
+void AudioBackend::promoteAudioThread() {
+    if (audioThreadPromoted) {
+        return;
+    }
+    audioThreadPromoted = true;
+    // A couple of syscalls once per stream start, nothing is printed from here
+    promoteCurrentThread(realtimeOptions, realtimeReport);
+    realtimeReportReady.store(true, std::memory_order_release);
+}
@@ -0,0 +1,35 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// Apart from AudioBackend.cpp so tools can link the backend base and NullBackend without PortAudio or JACK
+
+#include "../../include/backend/AudioBackend.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#include "../../include/backend/JackBackend.h"
+#include "../../include/backend/NullBackend.h"
+#include "../../include/backend/PortAudioBackend.h"
+
+std::unique_ptr<AudioBackend> createAudioBackend(AudioEngine& engine, const AudioSettings& settings) {
+    std::unique_ptr<AudioBackend> backend;
+    if (settings.backend == "portaudio") {
+        backend = std::make_unique<PortAudioBackend>(engine);
+    } else if (settings.backend == "null") {
+        backend = std::make_unique<NullBackend>(engine);
+    }
+#ifdef SYNTH_HAVE_JACK
+    else if (settings.backend == "jack") {
+        backend = std::make_unique<JackBackend>(engine);
+    }
+#endif
+
+    if (!backend) {
+        std::cerr << "Unknown or unavailable audio backend: " << settings.backend << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    backend->setRealtimeOptions(settings.realtime);
+    return backend;
+}
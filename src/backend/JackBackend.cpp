@@ -0,0 +1,181 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/backend/JackBackend.h"
+
+#ifdef SYNTH_HAVE_JACK
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <jack/midiport.h>
+
+JackBackend::JackBackend(AudioEngine& engine) : engine(engine) {}
+
+JackBackend::~JackBackend() {
+    close();
+}
+
+void JackBackend::open(const AudioSettings& settings) {
+    // JackNoStartServer: use the running server (real or "jackd -d dummy"), never spawn one
+    jack_status_t status;
+    client = jack_client_open("synth", JackNoStartServer, &status);
+    if (!client) {
+        std::cerr << "JACK client open failed (status 0x" << std::hex << status << std::dec
+                  << "), is the JACK server running?" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    // JACK decides the rate and period, the requested values are ignored
+    jack_nframes_t sampleRate = jack_get_sample_rate(client);
+    jack_nframes_t bufferSize = jack_get_buffer_size(client);
+    if (static_cast<int>(sampleRate) != settings.sampleRate) {
+        std::cout << "JACK runs at " << sampleRate << " Hz, ignoring --sample-rate" << std::endl;
+    }
+    // Prepared once: a later period change never touches the engine, and only a period above
+    // JACK_PREPARED_PERIOD regrows the output buffer
+    engine.prepare(static_cast<int>(sampleRate), static_cast<int>(bufferSize));
+    interleaved.assign(std::max(bufferSize, JACK_PREPARED_PERIOD) * 2, 0.0f);
+
+    outputPorts[0] = jack_port_register(client, "out_L", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    outputPorts[1] = jack_port_register(client, "out_R", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    midiInputPort = jack_port_register(client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    if (!outputPorts[0] || !outputPorts[1] || !midiInputPort) {
+        std::cerr << "JACK port registration failed" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    jack_set_process_callback(client, processCallback, this);
+    jack_set_buffer_size_callback(client, bufferSizeCallback, this);
+    jack_on_shutdown(client, shutdownCallback, this);
+
+    std::cout << "Output: JACK client \"" << jack_get_client_name(client) << "\", "
+              << sampleRate << " Hz, " << bufferSize << " frames, "
+              << (jack_is_realtime(client) ? "real-time server" : "server not real-time") << std::endl;
+}
+
+void JackBackend::start() {
+    resetRealtimePromotion();
+    if (jack_activate(client) != 0) {
+        std::cerr << "JACK activate failed" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    isActive = true;
+    connectToPlaybackPorts();
+
+    std::cout << "JACK output latency " << getOutputLatency() * 1000.0 << " ms" << std::endl;
+}
+
+void JackBackend::stop() {
+    if (client && isActive) {
+        jack_deactivate(client);
+        isActive = false;
+    }
+}
+
+void JackBackend::close() {
+    stop();
+    if (client) {
+        jack_client_close(client);
+        client = nullptr;
+    }
+}
+
+double JackBackend::getOutputLatency() const {
+    if (!client || !outputPorts[0]) {
+        return 0.0;
+    }
+    jack_latency_range_t range;
+    jack_port_get_latency_range(outputPorts[0], JackPlaybackLatency, &range);
+    return static_cast<double>(range.max) / jack_get_sample_rate(client);
+}
+
+// Connects out_L/out_R to the first two physical playback ports, if there are any
+void JackBackend::connectToPlaybackPorts() {
+    const char** playbackPorts = jack_get_ports(client, nullptr, JACK_DEFAULT_AUDIO_TYPE,
+                                                JackPortIsPhysical | JackPortIsInput);
+    if (!playbackPorts) {
+        return;
+    }
+    for (int channel = 0; channel < 2 && playbackPorts[channel]; ++channel) {
+        jack_connect(client, jack_port_name(outputPorts[channel]), playbackPorts[channel]);
+    }
+    jack_free(playbackPorts);
+}
+
+int JackBackend::processCallback(jack_nframes_t numFrames, void* arg) {
+    JackBackend* backend = static_cast<JackBackend*>(arg);
+    backend->promoteAudioThread();
+
+    auto* left = static_cast<float*>(jack_port_get_buffer(backend->outputPorts[0], numFrames));
+    auto* right = static_cast<float*>(jack_port_get_buffer(backend->outputPorts[1], numFrames));
+    // Sequentially consistent pair with bufferSizeCallback: either it sees rendering set and waits,
+    // or this sees resizing set and stays away from the buffer
+    backend->rendering.store(true);
+    if (backend->resizing.load() || numFrames * 2 > backend->interleaved.size()) {
+        backend->rendering.store(false);
+        std::fill_n(left, numFrames, 0.0f);
+        std::fill_n(right, numFrames, 0.0f);
+        return 0;
+    }
+
+    // Transport: publish the tempo when the timebase master provides bar/beat/tick info
+    jack_position_t position;
+    jack_transport_state_t state = jack_transport_query(backend->client, &position);
+    if (position.valid & JackPositionBBT) {
+        backend->engine.setTransportState(state == JackTransportRolling,
+                                          static_cast<float>(position.beats_per_minute));
+    }
+
+    // MIDI events of this period with their frame, JACK delivers them sorted
+    void* midiBuffer = jack_port_get_buffer(backend->midiInputPort, numFrames);
+    jack_nframes_t eventCount = jack_midi_get_event_count(midiBuffer);
+    size_t count = 0;
+    for (jack_nframes_t i = 0; i < eventCount && count < backend->midiEvents.size(); ++i) {
+        jack_midi_event_t event;
+        if (jack_midi_event_get(&event, midiBuffer, i) == 0 && event.size > 0 && event.size <= 3) {
+            MidiEvent& out = backend->midiEvents[count++];
+            out.frame = event.time;
+            out.size = static_cast<uint8_t>(event.size);
+            std::copy(event.buffer, event.buffer + event.size, out.data);
+        }
+    }
+
+    float* interleaved = backend->interleaved.data();
+    backend->engine.processAudio(interleaved, static_cast<int>(numFrames), backend->midiEvents.data(), count);
+
+    for (jack_nframes_t i = 0; i < numFrames; ++i) {
+        left[i] = interleaved[i * 2];
+        right[i] = interleaved[i * 2 + 1];
+    }
+    backend->rendering.store(false);
+    return 0;
+}
+
+// JACK calls this outside the process thread when the period changes. The engine renders any period
+// in chunks of the block it was prepared for, so only a period beyond the output buffer needs work:
+// the process thread is kept out of the buffer (silence) while it is regrown.
+int JackBackend::bufferSizeCallback(jack_nframes_t numFrames, void* arg) {
+    JackBackend* backend = static_cast<JackBackend*>(arg);
+    if (numFrames * 2 <= backend->interleaved.size()) {
+        return 0;
+    }
+    backend->resizing.store(true);
+    while (backend->rendering.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    backend->interleaved.assign(numFrames * 2, 0.0f);
+    backend->resizing.store(false);
+    return 0;
+}
+
+void JackBackend::shutdownCallback(void* arg) {
+    JackBackend* backend = static_cast<JackBackend*>(arg);
+    // The server is gone, only jack_client_close may still be called on the handle
+    backend->isActive = false;
+    std::cerr << "JACK server shut down" << std::endl;
+}
+
+#endif //SYNTH_HAVE_JACK
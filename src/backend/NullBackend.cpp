@@ -0,0 +1,126 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/backend/NullBackend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+void TimingStats::add(double value) {
+    min = count == 0 ? value : std::min(min, value);
+    max = count == 0 ? value : std::max(max, value);
+    sum += value;
+    sumSquares += value * value;
+    ++count;
+}
+
+double TimingStats::mean() const {
+    return count > 0 ? sum / count : 0.0;
+}
+
+double TimingStats::stddev() const {
+    if (count < 2) {
+        return 0.0;
+    }
+    double m = mean();
+    return std::sqrt(std::max(0.0, sumSquares / count - m * m));
+}
+
+NullBackend::NullBackend(AudioEngine& engine) : engine(engine) {}
+
+NullBackend::~NullBackend() {
+    close();
+}
+
+void NullBackend::open(const AudioSettings& settings) {
+    this->settings = settings;
+    engine.prepare(settings.sampleRate, settings.framesPerBuffer);
+    outputBuffer.assign(settings.framesPerBuffer * 2, 0.0f);
+
+    std::cout << "Output: null device, " << settings.sampleRate << " Hz, "
+              << settings.framesPerBuffer << " frames, "
+              << (settings.freeRun ? "free-running" : "real-time clock") << std::endl;
+}
+
+void NullBackend::start() {
+    renderTime = TimingStats();
+    wakeUpJitter = TimingStats();
+    renderedFrames = 0;
+    resetRealtimePromotion();
+
+    running = true;
+    renderThread = std::thread(&NullBackend::renderLoop, this);
+}
+
+void NullBackend::stop() {
+    running = false;
+    if (renderThread.joinable()) {
+        renderThread.join();
+        printReport();
+    }
+}
+
+void NullBackend::close() {
+    stop();
+}
+
+double NullBackend::getOutputLatency() const {
+    // Nothing is queued behind the block being rendered
+    return static_cast<double>(settings.framesPerBuffer) / settings.sampleRate;
+}
+
+void NullBackend::renderLoop() {
+    promoteAudioThread();
+
+    using Clock = std::chrono::steady_clock;
+    using Micros = std::chrono::duration<double, std::micro>;
+
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(static_cast<double>(settings.framesPerBuffer) / settings.sampleRate));
+
+    const auto startTime = Clock::now();
+    auto deadline = startTime;
+
+    while (running.load(std::memory_order_relaxed)) {
+        if (!settings.freeRun) {
+            std::this_thread::sleep_until(deadline);
+            wakeUpJitter.add(Micros(Clock::now() - deadline).count());
+        }
+
+        auto renderStart = Clock::now();
+        engine.processAudio(outputBuffer.data(), settings.framesPerBuffer);
+        renderTime.add(Micros(Clock::now() - renderStart).count());
+
+        renderedFrames += settings.framesPerBuffer;
+        deadline += period;
+    }
+
+    wallTime = Clock::now() - startTime;
+}
+
+void NullBackend::printReport() const {
+    double wallSeconds = std::chrono::duration<double>(wallTime).count();
+    double audioSeconds = static_cast<double>(renderedFrames) / settings.sampleRate;
+    double blockMicros = 1e6 * settings.framesPerBuffer / settings.sampleRate;
+
+    std::cout << "Null backend: " << renderTime.count << " blocks, "
+              << audioSeconds << " s of audio in " << wallSeconds << " s";
+    if (wallSeconds > 0.0) {
+        std::cout << " (" << audioSeconds / wallSeconds << "x real time)";
+    }
+    std::cout << std::endl;
+
+    std::cout << "  render time us: mean " << renderTime.mean()
+              << ", stddev " << renderTime.stddev()
+              << ", min " << renderTime.min
+              << ", max " << renderTime.max
+              << " (budget " << blockMicros << ")" << std::endl;
+
+    if (wakeUpJitter.count > 0) {
+        std::cout << "  wake-up jitter us: mean " << wakeUpJitter.mean()
+                  << ", stddev " << wakeUpJitter.stddev()
+                  << ", max " << wakeUpJitter.max << std::endl;
+    }
+}
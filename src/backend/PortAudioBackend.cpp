@@ -0,0 +1,173 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/backend/PortAudioBackend.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+
+PortAudioBackend::PortAudioBackend(AudioEngine& engine) : engine(engine) {}
+
+PortAudioBackend::~PortAudioBackend() {
+    close();
+}
+
+void PortAudioBackend::open(const AudioSettings& settings) {
+    // Initialize PortAudio
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        std::cerr << "PortAudio error in Pa_Initialize(): " << Pa_GetErrorText(err) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    isInitialized = true;
+
+    this->settings = settings;
+    engine.prepare(settings.sampleRate, settings.framesPerBuffer);
+
+    PaDeviceIndex device = selectOutputDevice();
+    const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(device);
+
+    PaStreamParameters outputParameters{};
+    outputParameters.device = device;
+    outputParameters.channelCount = 2;
+    outputParameters.sampleFormat = paFloat32;
+    outputParameters.suggestedLatency = settings.suggestedLatency > 0.0
+        ? settings.suggestedLatency
+        : deviceInfo->defaultLowOutputLatency;
+    outputParameters.hostApiSpecificStreamInfo = nullptr;
+
+    // Priming from the callback avoids starting the stream with a buffer of silence
+    err = Pa_OpenStream(&stream,
+                     nullptr,
+                     &outputParameters,
+                     settings.sampleRate,
+                     settings.framesPerBuffer,
+                     paPrimeOutputBuffersUsingStreamCallback,
+                     audioCallback,
+                     this);
+
+    if (err != paNoError) {
+        std::cerr << "PortAudio open failed: " << Pa_GetErrorText(err) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::cout << "Output: " << deviceInfo->name
+              << " (" << Pa_GetHostApiInfo(deviceInfo->hostApi)->name << "), "
+              << settings.sampleRate << " Hz, " << settings.framesPerBuffer << " frames, "
+              << "latency " << getOutputLatency() * 1000.0 << " ms" << std::endl;
+}
+
+void PortAudioBackend::start() {
+    resetRealtimePromotion();
+    PaError err = Pa_StartStream(stream);
+    if (err != paNoError) {
+        std::cerr << "PortAudio start failed: " << Pa_GetErrorText(err) << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+void PortAudioBackend::stop() {
+    if (stream && Pa_IsStreamActive(stream) == 1) {
+        Pa_StopStream(stream);
+    }
+}
+
+void PortAudioBackend::close() {
+    if (stream) {
+        Pa_CloseStream(stream);
+        stream = nullptr;
+    }
+    if (isInitialized) {
+        Pa_Terminate();
+        isInitialized = false;
+    }
+}
+
+// Picks the output device from the settings: explicit index, then host API default, then system default
+PaDeviceIndex PortAudioBackend::selectOutputDevice() const {
+    if (settings.deviceIndex >= 0) {
+        const PaDeviceInfo* info = Pa_GetDeviceInfo(settings.deviceIndex);
+        if (!info || info->maxOutputChannels < 2) {
+            std::cerr << "Device " << settings.deviceIndex << " is not a stereo output device" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        return settings.deviceIndex;
+    }
+
+    if (!settings.hostApi.empty()) {
+        auto toLower = [](std::string text) {
+            std::transform(text.begin(), text.end(), text.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            return text;
+        };
+        std::string wanted = toLower(settings.hostApi);
+
+        for (PaHostApiIndex i = 0; i < Pa_GetHostApiCount(); ++i) {
+            const PaHostApiInfo* api = Pa_GetHostApiInfo(i);
+            if (toLower(api->name).find(wanted) != std::string::npos
+                && api->defaultOutputDevice != paNoDevice) {
+                return api->defaultOutputDevice;
+            }
+        }
+        std::cerr << "Host API not found or without output device: " << settings.hostApi << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+
+    PaDeviceIndex device = Pa_GetDefaultOutputDevice();
+    if (device == paNoDevice) {
+        std::cerr << "No default output device" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return device;
+}
+
+double PortAudioBackend::getOutputLatency() const {
+    const PaStreamInfo* info = stream ? Pa_GetStreamInfo(stream) : nullptr;
+    return info ? info->outputLatency : 0.0;
+}
+
+void PortAudioBackend::listDevices() {
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        std::cerr << "PortAudio error in Pa_Initialize(): " << Pa_GetErrorText(err) << std::endl;
+        return;
+    }
+
+    for (PaHostApiIndex i = 0; i < Pa_GetHostApiCount(); ++i) {
+        const PaHostApiInfo* api = Pa_GetHostApiInfo(i);
+        std::cout << "Host API: " << api->name << std::endl;
+
+        for (int j = 0; j < api->deviceCount; ++j) {
+            PaDeviceIndex index = Pa_HostApiDeviceIndexToDeviceIndex(i, j);
+            const PaDeviceInfo* device = Pa_GetDeviceInfo(index);
+            if (device->maxOutputChannels <= 0) {
+                continue;
+            }
+            std::cout << "  [" << index << "] " << device->name
+                      << (index == api->defaultOutputDevice ? " (default)" : "")
+                      << " - " << device->maxOutputChannels << " ch, "
+                      << device->defaultSampleRate << " Hz, latency "
+                      << device->defaultLowOutputLatency * 1000.0 << " to "
+                      << device->defaultHighOutputLatency * 1000.0 << " ms" << std::endl;
+        }
+    }
+
+    Pa_Terminate();
+}
+
+int PortAudioBackend::audioCallback(const void* inputBuffer, void* outputBuffer,
+                              unsigned long framesPerBuffer,
+                              const PaStreamCallbackTimeInfo* timeInfo,
+                              PaStreamCallbackFlags statusFlags,
+                              void* userData) {
+    PortAudioBackend* backend = static_cast<PortAudioBackend*>(userData);
+    float* output = static_cast<float*>(outputBuffer);
+
+    backend->promoteAudioThread();
+
+    backend->engine.processAudio(output, framesPerBuffer);
+    return paContinue;
+}
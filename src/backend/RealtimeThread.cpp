@@ -0,0 +1,148 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/backend/RealtimeThread.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+static std::string describeError(int error) {
+    std::string text = std::strerror(error);
+    if (error == EPERM) {
+        text += " (needs CAP_SYS_NICE or an rtprio/memlock limit in /etc/security/limits.conf)";
+    }
+    return text;
+}
+
+static void applyPriority(const RealtimeOptions& options, RealtimeReport& report) {
+    if (options.policy == RealtimePolicy::NONE) {
+        return;
+    }
+    report.priorityRequested = true;
+    report.policy = options.policy;
+#if defined(_WIN32)
+    // No FIFO/RR classes on Windows, the closest is time-critical priority
+    report.priorityApplied = SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+    report.priorityError = report.priorityApplied ? 0 : static_cast<int>(GetLastError());
+#else
+    int policy = options.policy == RealtimePolicy::FIFO ? SCHED_FIFO : SCHED_RR;
+    sched_param param{};
+    param.sched_priority = std::clamp(options.priority,
+                                      sched_get_priority_min(policy),
+                                      sched_get_priority_max(policy));
+
+    int error = pthread_setschedparam(pthread_self(), policy, &param);
+    report.priorityApplied = error == 0;
+    report.priority = param.sched_priority;
+    report.priorityError = error;
+#endif
+}
+
+static void applyAffinity(const RealtimeOptions& options, RealtimeReport& report) {
+    if (options.cpus.empty()) {
+        return;
+    }
+    report.affinityRequested = true;
+    for (int cpu : options.cpus) {
+        if (cpu >= 0 && cpu < 64) {
+            report.cpuMask |= uint64_t(1) << cpu;
+        }
+    }
+
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : options.cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    report.affinityApplied = error == 0;
+    report.affinityError = error;
+#elif defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int cpu : options.cpus) {
+        if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+            mask |= DWORD_PTR(1) << cpu;
+        }
+    }
+    report.affinityApplied = SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+    report.affinityError = report.affinityApplied ? 0 : static_cast<int>(GetLastError());
+#else
+    report.affinitySupported = false;
+#endif
+}
+
+void promoteCurrentThread(const RealtimeOptions& options, RealtimeReport& report) {
+    applyPriority(options, report);
+    applyAffinity(options, report);
+}
+
+void lockProcessMemory(RealtimeReport& report) {
+    report.memoryLockRequested = true;
+#if defined(_WIN32)
+    report.memoryLockSupported = false;
+#else
+    report.memoryLocked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    report.memoryLockError = report.memoryLocked ? 0 : errno;
+#endif
+}
+
+static std::string describeCpus(uint64_t mask) {
+    std::string list;
+    for (int cpu = 0; cpu < 64; ++cpu) {
+        if ((mask >> cpu) & 1u) {
+            list += (list.empty() ? "" : ",") + std::to_string(cpu);
+        }
+    }
+    return list;
+}
+
+void printRealtimeReport(const RealtimeReport& report) {
+    std::string details;
+    if (report.priorityRequested) {
+#if defined(_WIN32)
+        details += report.priorityApplied
+            ? "priority: THREAD_PRIORITY_TIME_CRITICAL\n"
+            : "priority failed: SetThreadPriority error " + std::to_string(report.priorityError) + "\n";
+#else
+        std::string name = report.policy == RealtimePolicy::FIFO ? "SCHED_FIFO" : "SCHED_RR";
+        details += report.priorityApplied
+            ? "priority: " + name + " " + std::to_string(report.priority) + "\n"
+            : "priority " + name + " failed: " + describeError(report.priorityError)
+              + ", staying on the default scheduler\n";
+#endif
+    }
+    if (report.affinityRequested) {
+#if defined(_WIN32)
+        std::string failure = "SetThreadAffinityMask error " + std::to_string(report.affinityError);
+#else
+        std::string failure = describeError(report.affinityError);
+#endif
+        details += !report.affinitySupported ? "affinity: not supported on this platform\n"
+            : report.affinityApplied ? "affinity: CPUs " + describeCpus(report.cpuMask) + "\n"
+            : "affinity failed: " + failure + "\n";
+    }
+    if (report.memoryLockRequested) {
+        details += !report.memoryLockSupported ? "memory lock: not supported on this platform\n"
+            : report.memoryLocked ? "memory lock: all pages locked\n"
+            : "memory lock failed: " + describeError(report.memoryLockError) + "\n";
+    }
+    if (details.empty()) {
+        return;
+    }
+    std::cout << "Real-time setup of the audio path:" << std::endl << details;
+}
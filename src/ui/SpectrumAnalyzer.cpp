@@ -0,0 +1,156 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "../../include/ui/SpectrumAnalyzer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <imgui.h>
+
+SpectrumAnalyzer::SpectrumAnalyzer(std::shared_ptr<AudioTap> tap)
+    : tap(tap),
+      history(FFT_SIZE, 0.0f),
+      window(FFT_SIZE),
+      fftBuffer(FFT_SIZE),
+      bandLevels(NUM_BANDS, FLOOR_DB),
+      peakLevels(NUM_BANDS, FLOOR_DB),
+      peakAge(NUM_BANDS, 0),
+      scope(SCOPE_SIZE, 0.0f),
+      readBuffer(tap->ring.capacity()) {
+    float sum = 0.0f;
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        window[i] = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * i / (FFT_SIZE - 1));
+        sum += window[i];
+    }
+    // Amplitude of a full-scale sine reads 0 dB
+    windowGain = 2.0f / sum;
+}
+
+bool SpectrumAnalyzer::update() {
+    size_t count = tap->ring.pop(readBuffer.data(), readBuffer.size());
+    if (count == 0) {
+        return false;
+    }
+
+    bool silent = true;
+    for (size_t i = 0; i < count; ++i) {
+        float sample = readBuffer[i];
+        silent = silent && sample == 0.0f;
+
+        history[historyPos] = sample;
+        historyPos = (historyPos + 1) % FFT_SIZE;
+        if (++samplesSinceFft == HOP_SIZE) {
+            computeSpectrum();
+            samplesSinceFft = 0;
+        }
+    }
+
+    // Scope shows the most recent samples
+    size_t keep = std::min<size_t>(count, SCOPE_SIZE);
+    std::move(scope.begin() + keep, scope.end(), scope.begin());
+    std::copy(readBuffer.begin() + (count - keep), readBuffer.begin() + count, scope.end() - keep);
+
+    // Silence on an already empty display changes nothing, let the UI stay idle
+    bool changed = !(silent && displayAtFloor);
+    displayAtFloor = silent
+        && std::all_of(peakLevels.begin(), peakLevels.end(), [](float level) { return level <= FLOOR_DB; })
+        && std::all_of(scope.begin(), scope.end(), [](float sample) { return sample == 0.0f; });
+    return changed;
+}
+
+void SpectrumAnalyzer::computeSpectrum() {
+    // Oldest sample first
+    for (int i = 0; i < FFT_SIZE; ++i) {
+        fftBuffer[i] = {history[(historyPos + i) % FFT_SIZE] * window[i], 0.0f};
+    }
+    fft(fftBuffer);
+
+    float sampleRate = tap->sampleRate.load();
+    float binWidth = sampleRate / FFT_SIZE;
+    float lowFreq = 20.0f;
+    float highFreq = std::min(20000.0f, sampleRate * 0.5f);
+    int holdFfts = static_cast<int>(PEAK_HOLD_SECONDS * sampleRate / HOP_SIZE);
+
+    for (int band = 0; band < NUM_BANDS; ++band) {
+        // Log-spaced band edges, each band covers at least one bin
+        float f0 = lowFreq * std::pow(highFreq / lowFreq, static_cast<float>(band) / NUM_BANDS);
+        float f1 = lowFreq * std::pow(highFreq / lowFreq, static_cast<float>(band + 1) / NUM_BANDS);
+        int bin0 = std::clamp(static_cast<int>(f0 / binWidth), 1, FFT_SIZE / 2 - 1);
+        int bin1 = std::clamp(static_cast<int>(f1 / binWidth), bin0, FFT_SIZE / 2 - 1);
+
+        float magnitude = 0.0f;
+        for (int bin = bin0; bin <= bin1; ++bin) {
+            magnitude = std::max(magnitude, std::abs(fftBuffer[bin]));
+        }
+        float level = std::max(FLOOR_DB, 20.0f * std::log10(magnitude * windowGain + 1e-9f));
+        bandLevels[band] = level;
+
+        if (level >= peakLevels[band]) {
+            peakLevels[band] = level;
+            peakAge[band] = 0;
+        } else if (++peakAge[band] > holdFfts) {
+            peakLevels[band] = std::max(FLOOR_DB, peakLevels[band] - PEAK_FALL_DB);
+        }
+    }
+}
+
+// In-place iterative radix-2 FFT, size must be a power of two
+void SpectrumAnalyzer::fft(std::vector<std::complex<float>>& data) {
+    const size_t n = data.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+        float angle = -2.0f * static_cast<float>(M_PI) / length;
+        std::complex<float> step(std::cos(angle), std::sin(angle));
+        for (size_t start = 0; start < n; start += length) {
+            std::complex<float> twiddle(1.0f, 0.0f);
+            for (size_t k = 0; k < length / 2; ++k) {
+                std::complex<float> even = data[start + k];
+                std::complex<float> odd = data[start + k + length / 2] * twiddle;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                twiddle *= step;
+            }
+        }
+    }
+}
+
+void SpectrumAnalyzer::render() {
+    ImGui::PlotLines("##scope", scope.data(), SCOPE_SIZE, 0, "Output", -1.0f, 1.0f,
+                     ImVec2(ImGui::GetContentRegionAvail().x, 80.0f));
+
+    // Spectrum bars with peak hold markers, 0 dB at the top and FLOOR_DB at the bottom
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvail().x;
+    float height = 120.0f;
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height), IM_COL32(30, 30, 32, 255));
+
+    float barWidth = width / NUM_BANDS;
+    auto levelToY = [&](float level) {
+        return origin.y + height * (level / FLOOR_DB);
+    };
+    for (int band = 0; band < NUM_BANDS; ++band) {
+        float x0 = origin.x + band * barWidth;
+        float x1 = x0 + std::max(1.0f, barWidth - 1.0f);
+        drawList->AddRectFilled(ImVec2(x0, levelToY(bandLevels[band])), ImVec2(x1, origin.y + height),
+                                IM_COL32(200, 150, 50, 255));
+        float peakY = levelToY(peakLevels[band]);
+        drawList->AddLine(ImVec2(x0, peakY), ImVec2(x1, peakY), IM_COL32(240, 240, 240, 255));
+    }
+    ImGui::Dummy(ImVec2(width, height));
+
+    if (size_t dropped = tap->ring.droppedCount()) {
+        ImGui::Text("Analyzer dropped %zu samples", dropped);
+    }
+}
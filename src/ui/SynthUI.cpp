@@ -1,15 +1,50 @@
 #include "../../include/ui/SynthUI.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <ctime>
 #include <imgui_impl_sdl3.h>
 #include <iostream>
+#include <string>
+#include <thread>
 #include "imgui_impl_sdlrenderer3.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// CPU time consumed by the calling thread, in seconds
+static double threadCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    auto toSeconds = [](const FILETIME& time) {
+        return ((static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7;
+    };
+    return toSeconds(kernel) + toSeconds(user);
+#else
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+static double wallSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // Using shared_ptr to share ownership of the same SynthetizerConfig
 // between UI and audio engine. The object is automatically destroyed
 // when no shared_ptr instances reference it anymore.
-SynthUI::SynthUI(std::shared_ptr<SynthetizerConfig> synthParams)
-    : window(nullptr), renderer(nullptr), params(synthParams), currentOctave(0) {
+SynthUI::SynthUI(std::shared_ptr<SynthetizerConfig> synthParams, const UiOptions& options,
+                 std::shared_ptr<AudioTap> audioTap, std::shared_ptr<OutputMeters> meters)
+    : window(nullptr), renderer(nullptr), params(synthParams), currentOctave(0), options(options),
+      meters(meters) {
+    if (audioTap) {
+        analyzer = std::make_unique<SpectrumAnalyzer>(audioTap);
+    }
     // Initialize all 13 key states (physical/virtual keyboard keys) to "not pressed" (false)
     std::fill(keyStates, keyStates + 13, false);
 }
@@ -37,6 +72,10 @@ void SynthUI::initialize() {
         std::exit(EXIT_FAILURE);
     }
 
+    if (options.vsync && !SDL_SetRenderVSync(renderer, 1)) {
+        std::cerr << "VSync not available, relying on the FPS cap: " << SDL_GetError() << std::endl;
+    }
+
     // Setup ImGui
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -72,14 +111,24 @@ void SynthUI::render() {
     // every component of the app
     renderOscillatorControls();
     ImGui::Separator();
+    renderFmControls();
+    ImGui::Separator();
     renderEnvelopeControls();
     ImGui::Separator();
     renderFilterControls();
     ImGui::Separator();
+    renderLfoControls();
+    ImGui::Separator();
+    renderModulationControls();
+    ImGui::Separator();
 
     renderVolumeControl();
     renderOctaveControl();
     renderVirtualKeyboard();
+    ImGui::Separator();
+    renderMeters();
+    renderAnalyzer();
+    renderUiStats();
 
     ImGui::End();
 
@@ -117,6 +166,8 @@ bool SynthUI::handleEvents() {
     // gets every event
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
+        framesToRedraw = 3;
+
         // give sdl event to imgui
         ImGui_ImplSDL3_ProcessEvent(&event);
 
@@ -178,16 +229,45 @@ void SynthUI::renderOscillatorControls() {
         }
 
         int osc1_wave = params->osc1_waveform.load();
-        const char* waveforms[] = {"TRIANGLE", "SAW", "NOISE"};
-        if (ImGui::Combo("OSC1 Waveform", &osc1_wave, waveforms, 3)) {
+        const char* waveforms[] = {"TRIANGLE", "SAW", "NOISE", "SAMPLE"};
+        // Copies, detune and stereo spread; unison plays on triangle and saw only, and not on a synced
+        // oscillator (one copy follows oscillator 1's clock)
+        auto unisonControls = [](const char* name, std::atomic<int>& copies, std::atomic<float>& detune,
+                                 std::atomic<float>& spread, bool synced = false) {
+            std::string prefix = std::string(name) + " ";
+            ImGui::BeginDisabled(synced);
+            int unison = copies.load();
+            if (ImGui::SliderInt((prefix + "Unison").c_str(), &unison, 1, MAX_UNISON)) {
+                copies = unison;
+            }
+            float unisonDetune = detune.load();
+            if (ImGui::SliderFloat((prefix + "Unison detune").c_str(), &unisonDetune, 0.0f, 1.0f, "%.2f st")) {
+                detune = unisonDetune;
+            }
+            float unisonSpread = spread.load();
+            if (ImGui::SliderFloat((prefix + "Unison spread").c_str(), &unisonSpread, 0.0f, 1.0f)) {
+                spread = unisonSpread;
+            }
+            ImGui::EndDisabled();
+            if (synced) {
+                ImGui::TextDisabled("%s unison is off while synced", name);
+            }
+        };
+        if (ImGui::Combo("OSC1 Waveform", &osc1_wave, waveforms, 4)) {
             params->osc1_waveform = osc1_wave;
         }
 
         float osc1_offset = params->osc1_freq_offset.load();
-        if (ImGui::SliderFloat("OSC1 Frequency Offset", &osc1_offset, -5.0f, 5.0f)) {
+        if (ImGui::SliderFloat("OSC1 Pitch", &osc1_offset, -24.0f, 24.0f, "%.0f st")) {
             params->osc1_freq_offset = osc1_offset;
         }
 
+        float osc1_fine = params->osc1_fine.load();
+        if (ImGui::SliderFloat("OSC1 Fine", &osc1_fine, -100.0f, 100.0f, "%.0f cents")) {
+            params->osc1_fine = osc1_fine;
+        }
+        unisonControls("OSC1", params->osc1_unison, params->osc1_unison_detune, params->osc1_unison_spread);
+
         // Oscillator 2
         bool osc2_enabled = params->osc2_enabled.load();
         if (ImGui::Checkbox("Oscillator 2", &osc2_enabled)) {
@@ -195,15 +275,32 @@ void SynthUI::renderOscillatorControls() {
         }
 
         int osc2_wave = params->osc2_waveform.load();
-        if (ImGui::Combo("OSC2 Waveform", &osc2_wave, waveforms, 3)) {
+        if (ImGui::Combo("OSC2 Waveform", &osc2_wave, waveforms, 4)) {
             params->osc2_waveform = osc2_wave;
         }
 
         float osc2_offset = params->osc2_freq_offset.load();
-        if (ImGui::SliderFloat("OSC2 Frequency Offset", &osc2_offset, -5.0f, 5.0f)) {
+        if (ImGui::SliderFloat("OSC2 Pitch", &osc2_offset, -24.0f, 24.0f, "%.0f st")) {
             params->osc2_freq_offset = osc2_offset;
         }
 
+        float osc2_fine = params->osc2_fine.load();
+        if (ImGui::SliderFloat("OSC2 Fine", &osc2_fine, -100.0f, 100.0f, "%.0f cents")) {
+            params->osc2_fine = osc2_fine;
+        }
+        unisonControls("OSC2", params->osc2_unison, params->osc2_unison_detune, params->osc2_unison_spread,
+                       params->osc2_sync.load());
+
+        bool osc2_sync = params->osc2_sync.load();
+        if (ImGui::Checkbox("OSC2 Sync to OSC1", &osc2_sync)) {
+            params->osc2_sync = osc2_sync;
+        }
+
+        bool osc2_ring = params->osc2_ring.load();
+        if (ImGui::Checkbox("OSC2 Ring with OSC1", &osc2_ring)) {
+            params->osc2_ring = osc2_ring;
+        }
+
         // Oscillator 3
         bool osc3_enabled = params->osc3_enabled.load();
         if (ImGui::Checkbox("Oscillator 3", &osc3_enabled)) {
@@ -211,16 +308,72 @@ void SynthUI::renderOscillatorControls() {
         }
 
         int osc3_wave = params->osc3_waveform.load();
-        if (ImGui::Combo("OSC3 Waveform", &osc3_wave, waveforms, 3)) {
+        if (ImGui::Combo("OSC3 Waveform", &osc3_wave, waveforms, 4)) {
             params->osc3_waveform = osc3_wave;
         }
 
         float osc3_offset = params->osc3_freq_offset.load();
-        if (ImGui::SliderFloat("OSC3 Frequency Offset", &osc3_offset, -5.0f, 5.0f)) {
+        if (ImGui::SliderFloat("OSC3 Pitch", &osc3_offset, -24.0f, 24.0f, "%.0f st")) {
             params->osc3_freq_offset = osc3_offset;
         }
+
+        float osc3_fine = params->osc3_fine.load();
+        if (ImGui::SliderFloat("OSC3 Fine", &osc3_fine, -100.0f, 100.0f, "%.0f cents")) {
+            params->osc3_fine = osc3_fine;
+        }
+        unisonControls("OSC3", params->osc3_unison, params->osc3_unison_detune, params->osc3_unison_spread,
+                       params->osc3_sync.load());
+
+        bool osc3_sync = params->osc3_sync.load();
+        if (ImGui::Checkbox("OSC3 Sync to OSC1", &osc3_sync)) {
+            params->osc3_sync = osc3_sync;
+        }
+
+        bool osc3_ring = params->osc3_ring.load();
+        if (ImGui::Checkbox("OSC3 Ring with OSC1", &osc3_ring)) {
+            params->osc3_ring = osc3_ring;
+        }
+    }
+
+void SynthUI::renderFmControls() {
+    if (!ImGui::CollapsingHeader("FM")) {
+        return;
+    }
+
+    const char* algorithms[FM_ALGORITHM_COUNT];
+    for (int i = 0; i < FM_ALGORITHM_COUNT; ++i) {
+        algorithms[i] = fmAlgorithmName(static_cast<FmAlgorithm>(i));
+    }
+    int algorithm = params->fm_algorithm.load();
+    if (ImGui::Combo("Algorithm", &algorithm, algorithms, FM_ALGORITHM_COUNT)) {
+        params->fm_algorithm = algorithm;
     }
 
+    // One row per operator the algorithm uses: frequency ratio, level
+    std::atomic<float>* ratios[] = {&params->fm_op1_ratio, &params->fm_op2_ratio, &params->fm_op3_ratio,
+                                    &params->fm_op4_ratio, &params->fm_op5_ratio, &params->fm_op6_ratio};
+    std::atomic<float>* levels[] = {&params->fm_op1_level, &params->fm_op2_level, &params->fm_op3_level,
+                                    &params->fm_op4_level, &params->fm_op5_level, &params->fm_op6_level};
+    const int operators = algorithm >= 0 && algorithm < FM_ALGORITHM_COUNT
+        ? fmOperatorCount(static_cast<FmAlgorithm>(algorithm)) : 0;
+    for (int op = 0; op < operators; ++op) {
+        ImGui::PushID(op);
+        ImGui::Text("Op %d", op + 1);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(150.0f);
+        float ratio = ratios[op]->load();
+        if (ImGui::SliderFloat("##ratio", &ratio, 0.25f, 16.0f, "x%.2f")) {
+            *ratios[op] = ratio;
+        }
+        ImGui::SameLine();
+        float level = levels[op]->load();
+        if (ImGui::SliderFloat("##level", &level, 0.0f, 1.0f, "level %.2f")) {
+            *levels[op] = level;
+        }
+        ImGui::PopID();
+    }
+}
+
 void SynthUI::renderEnvelopeControls() {
         float attack = params->attack_time.load();
         if (ImGui::SliderFloat("Attack", &attack, 0.0f, 1.0f)) {
@@ -245,16 +398,122 @@ void SynthUI::renderFilterControls() {
         }
 
         float autoAmount = params->filter_auto_amount.load();
-        if (ImGui::SliderFloat("Filter LFO amount", &autoAmount, 0.0f, 1.0f)) {
+        if (ImGui::SliderFloat("LFO 1 to cutoff", &autoAmount, 0.0f, 1.0f)) {
             params->filter_auto_amount = autoAmount;
         }
 
-        float autoFreq = params->filter_auto_freq.load();
-        if (ImGui::SliderFloat("Filter LFO frequency", &autoFreq, 1.0f, 20.0f)) {
-            params->filter_auto_freq = autoFreq;
+        // 0 = 1x, 1 = 2x, 2 = 4x
+        const char* factors[] = {"1x", "2x", "4x"};
+        int oversamplingIndex = params->oversampling.load() >= 4 ? 2 : params->oversampling.load() >= 2 ? 1 : 0;
+        if (ImGui::Combo("Oversampling", &oversamplingIndex, factors, 3)) {
+            params->oversampling = 1 << oversamplingIndex;
+        }
+
+        int polyphony = params->polyphony.load();
+        if (ImGui::SliderInt("Polyphony", &polyphony, 1, MAX_VOICES)) {
+            params->polyphony = polyphony;
         }
+
+        float bendRange = params->bend_range.load();
+        if (ImGui::SliderFloat("Pitch bend range", &bendRange, 0.0f, 48.0f, "%.0f st")) {
+            params->bend_range = bendRange;
+        }
+
+        float pressureToCutoff = params->pressure_to_cutoff.load();
+        if (ImGui::SliderFloat("Pressure to cutoff", &pressureToCutoff, -4.0f, 4.0f, "%.1f oct")) {
+            params->pressure_to_cutoff = pressureToCutoff;
+        }
+
+        float timbreToCutoff = params->timbre_to_cutoff.load();
+        if (ImGui::SliderFloat("Timbre to cutoff", &timbreToCutoff, -4.0f, 4.0f, "%.1f oct")) {
+            params->timbre_to_cutoff = timbreToCutoff;
+        }
+    }
+
+void SynthUI::renderLfoControls() {
+    const char* shapes[LFO_SHAPE_COUNT];
+    for (int i = 0; i < LFO_SHAPE_COUNT; ++i) {
+        shapes[i] = lfoShapeName(static_cast<LfoShape>(i));
+    }
+    const char* syncs[LFO_SYNC_COUNT];
+    for (int i = 0; i < LFO_SYNC_COUNT; ++i) {
+        syncs[i] = lfoSyncName(i);
     }
 
+    struct LfoParams {
+        const char* label;
+        std::atomic<int>& shape;
+        std::atomic<float>& rate;
+        std::atomic<int>& sync;
+        std::atomic<bool>& perVoice;
+    };
+    LfoParams lfos[NUM_LFOS] = {
+        {"LFO 1", params->lfo1_shape, params->lfo1_rate, params->lfo1_sync, params->lfo1_per_voice},
+        {"LFO 2", params->lfo2_shape, params->lfo2_rate, params->lfo2_sync, params->lfo2_per_voice},
+    };
+    for (LfoParams& lfo : lfos) {
+        ImGui::PushID(lfo.label);
+        ImGui::TextUnformatted(lfo.label);
+        int shape = lfo.shape.load();
+        if (ImGui::Combo("Shape", &shape, shapes, LFO_SHAPE_COUNT)) {
+            lfo.shape = shape;
+        }
+        int sync = lfo.sync.load();
+        if (ImGui::Combo("Tempo sync", &sync, syncs, LFO_SYNC_COUNT)) {
+            lfo.sync = sync;
+        }
+        // The free rate only applies without sync
+        if (sync == 0) {
+            float rate = lfo.rate.load();
+            if (ImGui::SliderFloat("Rate", &rate, 0.05f, 20.0f, "%.2f Hz")) {
+                lfo.rate = rate;
+            }
+        }
+        bool perVoice = lfo.perVoice.load();
+        if (ImGui::Checkbox("Per voice", &perVoice)) {
+            lfo.perVoice = perVoice;
+        }
+        ImGui::PopID();
+    }
+}
+
+void SynthUI::renderModulationControls() {
+    if (!ImGui::CollapsingHeader("Modulation matrix")) {
+        return;
+    }
+
+    const char* sources[MOD_SOURCE_COUNT];
+    for (int i = 0; i < MOD_SOURCE_COUNT; ++i) {
+        sources[i] = modSourceName(static_cast<ModSource>(i));
+    }
+    const char* destinations[MOD_DESTINATION_COUNT];
+    for (int i = 0; i < MOD_DESTINATION_COUNT; ++i) {
+        destinations[i] = modDestinationName(static_cast<ModDestination>(i));
+    }
+
+    // One row per slot: source, destination, amount
+    for (int slot = 0; slot < MOD_SLOTS; ++slot) {
+        ImGui::PushID(slot);
+        ImGui::SetNextItemWidth(110.0f);
+        int source = params->mod_source[slot].load();
+        if (ImGui::Combo("##source", &source, sources, MOD_SOURCE_COUNT)) {
+            params->mod_source[slot] = source;
+        }
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(110.0f);
+        int destination = params->mod_destination[slot].load();
+        if (ImGui::Combo("##destination", &destination, destinations, MOD_DESTINATION_COUNT)) {
+            params->mod_destination[slot] = destination;
+        }
+        ImGui::SameLine();
+        float amount = params->mod_amount[slot].load();
+        if (ImGui::SliderFloat("##amount", &amount, -12.0f, 12.0f, "%.2f")) {
+            params->mod_amount[slot] = amount;
+        }
+        ImGui::PopID();
+    }
+}
+
 void SynthUI::renderVolumeControl() {
         float volume = params->volume.load();
         if (ImGui::SliderFloat("Volume", &volume, 0.0f, 1.0f)) {
@@ -345,10 +604,142 @@ void SynthUI::renderVirtualKeyboard() {
     ImGui::Text("Physical keys: S E D R F G Y H U J I K L");
 }
 
+void SynthUI::renderMeters() {
+    if (!meters) {
+        return;
+    }
+    // Bars span -60 to 0 dBFS
+    auto meterBar = [](const char* label, float peak, float rms) {
+        auto toFraction = [](float level) {
+            float db = level > 0.0f ? 20.0f * std::log10(level) : -60.0f;
+            return std::clamp((db + 60.0f) / 60.0f, 0.0f, 1.0f);
+        };
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "%s peak %.1f dB  rms %.1f dB", label,
+                      peak > 0.0f ? 20.0f * std::log10(peak) : -INFINITY,
+                      rms > 0.0f ? 20.0f * std::log10(rms) : -INFINITY);
+        ImGui::ProgressBar(toFraction(peak), ImVec2(-1.0f, 0.0f), overlay);
+    };
+    meterBar("L", meters->peakLeft.load(std::memory_order_relaxed), meters->rmsLeft.load(std::memory_order_relaxed));
+    meterBar("R", meters->peakRight.load(std::memory_order_relaxed), meters->rmsRight.load(std::memory_order_relaxed));
+
+    // One small bar per voice, filled to its envelope level
+    int activeVoices = 0;
+    ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(2.0f, ImGui::GetStyle().ItemSpacing.y));
+    for (int i = 0; i < MAX_VOICES; ++i) {
+        float level = meters->voiceLevels[i].load(std::memory_order_relaxed);
+        activeVoices += level > 0.0f ? 1 : 0;
+        ImGui::ProgressBar(level, ImVec2(10.0f, 0.0f), "");
+        ImGui::SameLine();
+    }
+    ImGui::PopStyleVar();
+    ImGui::Text("%2d voices", activeVoices);
+    ImGui::SameLine();
+    ImGui::Text("LUFS M %.1f  S %.1f  I %.1f",
+                meters->momentaryLufs.load(std::memory_order_relaxed),
+                meters->shortTermLufs.load(std::memory_order_relaxed),
+                meters->integratedLufs.load(std::memory_order_relaxed));
+
+    // Latched clip light, click to clear
+    bool clipping = meters->clipping.load(std::memory_order_relaxed);
+    if (clipping) {
+        ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0.8f, 0.1f, 0.1f, 1.0f));
+    }
+    char clipLabel[48];
+    std::snprintf(clipLabel, sizeof(clipLabel), "CLIP %llu###clip",
+                  meters->clippedSamples.load(std::memory_order_relaxed));
+    if (ImGui::Button(clipLabel)) {
+        meters->clipping.store(false, std::memory_order_relaxed);
+    }
+    if (clipping) {
+        ImGui::PopStyleColor();
+    }
+    ImGui::Separator();
+}
+
+void SynthUI::renderAnalyzer() {
+    if (analyzer) {
+        analyzer->render();
+        ImGui::Separator();
+    }
+}
+
+void SynthUI::renderUiStats() {
+    ImGui::Text("UI: %.0f fps, %.1f%% CPU", framesPerSecond, cpuPercent);
+}
+
+// Something to draw: recent input, ImGui still animating, or new data from the audio side
+bool SynthUI::needsRedraw() {
+    // Always drain the tap, even when the frame is skipped
+    bool analyzerChanged = analyzer && analyzer->update();
+    if (!options.idleWhenUnchanged || analyzerChanged) {
+        return true;
+    }
+    unsigned displayVersion = params->display_version.load(std::memory_order_relaxed);
+    if (displayVersion != lastDisplayVersion) {
+        lastDisplayVersion = displayVersion;
+        return true;
+    }
+    if (framesToRedraw > 0) {
+        --framesToRedraw;
+        return true;
+    }
+    return false;
+}
+
+void SynthUI::updateCpuUsage() {
+    double now = wallSeconds();
+    double elapsed = now - cpuWindowStart;
+    if (elapsed < 1.0) {
+        return;
+    }
+    double cpu = threadCpuSeconds();
+    cpuPercent = static_cast<float>(100.0 * (cpu - cpuAtWindowStart) / elapsed);
+    framesPerSecond = static_cast<float>(framesInWindow / elapsed);
+    cpuWindowStart = now;
+    cpuAtWindowStart = cpu;
+    framesInWindow = 0;
+    // Show the new numbers
+    framesToRedraw = std::max(framesToRedraw, 1);
+}
+
 void SynthUI::run() {
+    using Clock = std::chrono::steady_clock;
+    const auto framePeriod = options.maxFps > 0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.maxFps))
+        : Clock::duration::zero();
+    // While idle, wake up at the frame rate to check for new audio-side data
+    const int idleTimeoutMs = options.maxFps > 0 ? 1000 / options.maxFps : 16;
+
+    runStart = cpuWindowStart = wallSeconds();
+    cpuAtRunStart = cpuAtWindowStart = threadCpuSeconds();
+    framesToRedraw = 3;
+
     bool running = true;
     while (running) {
+        auto frameStart = Clock::now();
+
+        if (options.idleWhenUnchanged && framesToRedraw == 0) {
+            // Leaves the event in the queue for handleEvents()
+            SDL_WaitEventTimeout(nullptr, idleTimeoutMs);
+        }
         running = handleEvents();
-        render();
+
+        if (needsRedraw()) {
+            render();
+            ++framesInWindow;
+            // Cap the frame rate when vsync is off or unavailable
+            if (framePeriod > Clock::duration::zero()) {
+                std::this_thread::sleep_until(frameStart + framePeriod);
+            }
+        }
+        updateCpuUsage();
+    }
+
+    double elapsed = wallSeconds() - runStart;
+    if (elapsed > 0.0) {
+        std::cout << "UI thread CPU usage: "
+                  << 100.0 * (threadCpuSeconds() - cpuAtRunStart) / elapsed << "% over "
+                  << elapsed << " s" << std::endl;
     }
 }
@@ -0,0 +1,20 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// Aliasing checks of the oscillator features that cut discontinuities into a waveform (hard sync) or
+// resample (sample playback transposed up): each case is rendered long enough for a fine spectrum, and
+// the energy between the harmonics (aliases folded back from above Nyquist) is reported against the
+// harmonics' energy.
+//   synth_render --alias-check -20      exit code is non-zero when a case is above its limit or -20 dB
+
+#ifndef ALIASCHECKS_H
+#define ALIASCHECKS_H
+#pragma once
+
+// Prints every case with its naive (uncorrected) level for reference; fails when a corrected case's
+// alias-to-signal ratio is above its own limit (set at the measured level, so losing the correction
+// fails every case) or above maxAliasDb
+bool checkAliasing(double maxAliasDb);
+
+#endif //ALIASCHECKS_H
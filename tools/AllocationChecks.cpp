@@ -0,0 +1,303 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "AllocationChecks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "../include/audio/AudioEngine.h"
+#include "../include/audio/FmBank.h"
+#include "../include/audio/Lfo.h"
+#include "../include/audio/MidiFile.h"
+#include "../include/audio/ModMatrix.h"
+#include "../include/backend/NullBackend.h"
+
+namespace {
+
+constexpr int CHECK_SAMPLE_RATE = 48000;
+constexpr int CHECK_BLOCK = 256;
+// Length of the looping MIDI file, in seconds
+constexpr double CHECK_LOOP_SECONDS = 4.0;
+
+std::atomic<long long> allocations{0};
+std::atomic<long long> frees{0};
+// Set on the render thread while it is measured; static TLS, reading it never allocates
+thread_local bool counting = false;
+// Set while a backend runs: every thread but the checking one counts, the backend's own thread included
+std::atomic<bool> countingOtherThreads{false};
+thread_local bool checkingThread = false;
+
+bool isCounted() {
+    return counting || (countingOtherThreads.load(std::memory_order_relaxed) && !checkingThread);
+}
+
+void noteAllocation() {
+    if (isCounted()) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void noteFree(void* pointer) {
+    if (pointer && isCounted()) {
+        frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+}
+
+#if defined(__GLIBC__)
+
+// glibc: operator new and every other allocation end in these, and the executable's definitions take
+// precedence over the C library's
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+
+void* malloc(size_t size) noexcept {
+    noteAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+    noteAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept {
+    noteAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    noteAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    noteAllocation();
+    void* memory = __libc_memalign(alignment, size);
+    if (!memory) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+void free(void* pointer) noexcept {
+    noteFree(pointer);
+    __libc_free(pointer);
+}
+}
+
+#else
+
+// Elsewhere only operator new can be replaced portably; direct malloc calls go uncounted
+void* operator new(size_t size) {
+    noteAllocation();
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    noteFree(pointer);
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+#endif
+
+namespace {
+
+// Notes on four MPE channels with bend, pressure and timbre moving every 10 ms, more notes than voices
+std::vector<MidiFileEvent> expressionLoop() {
+    std::vector<MidiFileEvent> events;
+    auto add = [&](double seconds, uint8_t status, uint8_t data1, uint8_t data2) {
+        events.push_back({seconds, 3, {status, data1, data2}});
+    };
+    int note = 0;
+    for (double t = 0.0; t < CHECK_LOOP_SECONDS - 1.0; t += 0.0625, ++note) {
+        const uint8_t channel = static_cast<uint8_t>(note % 4);
+        const uint8_t key = static_cast<uint8_t>(48 + (note * 7) % 24);
+        add(t, 0x90 | channel, key, static_cast<uint8_t>(40 + note % 80));
+        add(t + 0.9, 0x80 | channel, key, 0);
+    }
+    for (int step = 0; step * 0.01 < CHECK_LOOP_SECONDS; ++step) {
+        const double t = step * 0.01;
+        const uint8_t channel = static_cast<uint8_t>(step % 4);
+        const int bend = 8192 + static_cast<int>(4000.0 * ((step % 50) / 25.0 - 1.0));
+        add(t, 0xE0 | channel, static_cast<uint8_t>(bend & 0x7F), static_cast<uint8_t>(bend >> 7));
+        add(t, 0xD0 | channel, static_cast<uint8_t>(step % 128), 0);
+        add(t, 0xB0 | channel, 74, static_cast<uint8_t>((step * 3) % 128));
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const MidiFileEvent& a, const MidiFileEvent& b) { return a.seconds < b.seconds; });
+    return events;
+}
+
+std::shared_ptr<SynthetizerConfig> checkPatch() {
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->osc1_enabled.store(true);
+    params->osc2_enabled.store(true);
+    params->osc3_enabled.store(true);
+    params->osc1_waveform.store(static_cast<int>(WaveformType::SAW));
+    params->osc1_unison.store(7);
+    params->osc2_waveform.store(static_cast<int>(WaveformType::SAW));
+    params->osc2_freq_offset.store(7.0f);
+    params->osc3_waveform.store(static_cast<int>(WaveformType::NOISE));
+    params->osc3_ring.store(true);
+    params->fm_algorithm.store(static_cast<int>(FmAlgorithm::SIX_OP_STACK));
+    params->lfo2_per_voice.store(true);
+    params->lfo2_shape.store(static_cast<int>(LfoShape::SMOOTH_RANDOM));
+    params->mod_source[0].store(static_cast<int>(ModSource::LFO1));
+    params->mod_destination[0].store(static_cast<int>(ModDestination::CUTOFF));
+    params->mod_amount[0].store(1.0f);
+    params->mod_source[1].store(static_cast<int>(ModSource::LFO2));
+    params->mod_destination[1].store(static_cast<int>(ModDestination::PITCH));
+    params->mod_amount[1].store(0.3f);
+    params->mod_source[2].store(static_cast<int>(ModSource::PRESSURE));
+    params->mod_destination[2].store(static_cast<int>(ModDestination::PAN));
+    params->mod_amount[2].store(0.5f);
+    params->pressure_to_cutoff.store(1.0f);
+    params->timbre_to_cutoff.store(1.0f);
+    params->bend_range.store(48.0f);
+    params->attack_time.store(0.01f);
+    params->release_time.store(0.2f);
+    params->filter_resonance.store(0.5f);
+    params->polyphony.store(MAX_VOICES);
+    return params;
+}
+
+// Patch edits from the UI move the render through the other paths
+void editPatch(SynthetizerConfig& params, long long step) {
+    params.oversampling.store(1 << (step % 3));
+    params.osc2_sync.store(step % 2 == 0);
+    params.osc1_unison.store(step % 4 == 3 ? 1 : 7);
+    params.fm_algorithm.store(static_cast<int>(step % FM_ALGORITHM_COUNT));
+}
+
+// The engine driven directly from a thread of our own, with keyboard events split into every block
+bool checkDirectRender(double seconds) {
+    auto params = checkPatch();
+    AudioEngine engine(params);
+    engine.prepare(CHECK_SAMPLE_RATE, CHECK_BLOCK);
+    engine.setNoiseSeed(1);
+    engine.setMidiPlayer(std::make_shared<MidiPlayer>(expressionLoop(), true));
+    std::vector<float> output(CHECK_BLOCK * 2);
+    const long long blocks = static_cast<long long>(seconds * CHECK_SAMPLE_RATE / CHECK_BLOCK);
+    const int blocksPerSecond = CHECK_SAMPLE_RATE / CHECK_BLOCK;
+
+    // The engine is prepared on this thread and rendered on another, like a driver does
+    std::thread audio([&] {
+        counting = true;
+        for (long long block = 0; block < blocks; ++block) {
+            if (block % blocksPerSecond == 0) {
+                editPatch(*params, block / blocksPerSecond);
+            }
+            // Keyboard notes between the file's, split at their frame
+            const MidiEvent events[] = {
+                {CHECK_BLOCK / 3, 3, {0x90, static_cast<uint8_t>(60 + block % 12), 100}},
+                {CHECK_BLOCK * 2 / 3, 3, {0x80, static_cast<uint8_t>(60 + (block + 6) % 12), 0}},
+            };
+            engine.processAudio(output.data(), CHECK_BLOCK, events, std::size(events));
+        }
+        counting = false;
+    });
+    audio.join();
+
+    const long long allocated = allocations.load();
+    const long long freed = frees.load();
+    const bool pass = allocated == 0 && freed == 0;
+    std::cout << (pass ? "PASS " : "FAIL ") << blocks << " blocks of " << CHECK_BLOCK << " frames ("
+              << static_cast<double>(blocks) * CHECK_BLOCK / CHECK_SAMPLE_RATE << " s), peak "
+              << engine.getPeakVoices() << " voices, " << engine.getVoiceSteals() << " steals: " << allocated
+              << " allocations and " << freed << " frees on the audio thread" << std::endl;
+    std::cout << "DSP arena: " << engine.getArenaSize() << " bytes, "
+              << (engine.isArenaLocked() ? "locked in RAM" : "not locked (RLIMIT_MEMLOCK)") << std::endl;
+    return pass;
+}
+
+// The same patch through NullBackend on the real-time clock: its thread from the first callback on,
+// the real-time promotion included, while this thread edits the patch like the UI does. Not free-running,
+// a SCHED_FIFO thread rendering back to back would starve this one on a single CPU.
+bool checkNullBackend(double seconds) {
+    auto params = checkPatch();
+    AudioEngine engine(params);
+    engine.setNoiseSeed(1);
+    engine.setMidiPlayer(std::make_shared<MidiPlayer>(expressionLoop(), true));
+
+    AudioSettings settings;
+    settings.backend = "null";
+    settings.sampleRate = CHECK_SAMPLE_RATE;
+    settings.framesPerBuffer = CHECK_BLOCK;
+    // Applied or refused (no privileges), either way the report is filled on the audio thread
+    settings.realtime.policy = RealtimePolicy::FIFO;
+    settings.realtime.cpus = {0};
+
+    NullBackend backend(engine);
+    backend.setRealtimeOptions(settings.realtime);
+    backend.open(settings);
+
+    allocations.store(0);
+    frees.store(0);
+    checkingThread = true;
+    countingOtherThreads.store(true);
+    backend.start();
+    const auto editPeriod = std::chrono::milliseconds(100);
+    for (long long step = 0; step * editPeriod.count() < seconds * 1000.0; ++step) {
+        editPatch(*params, step);
+        std::this_thread::sleep_for(editPeriod);
+    }
+    // Taken while the backend still renders: its thread frees its own state once stop() ends it
+    const long long allocated = allocations.load();
+    const long long freed = frees.load();
+    countingOtherThreads.store(false);
+    backend.stop();
+    checkingThread = false;
+
+    if (const RealtimeReport* report = backend.getRealtimeReport()) {
+        printRealtimeReport(*report);
+    }
+    const bool pass = allocated == 0 && freed == 0;
+    std::cout << (pass ? "PASS " : "FAIL ") << "NullBackend, " << seconds << " s: " << allocated
+              << " allocations and " << freed << " frees on the audio thread" << std::endl;
+    return pass;
+}
+
+}
+
+bool checkAudioThreadAllocations(double seconds) {
+    const bool direct = checkDirectRender(seconds);
+    // In real time, so a tenth of the length; the direct run already covers the long render
+    const bool backend = checkNullBackend(std::clamp(seconds / 10.0, 0.5, 5.0));
+    return direct && backend;
+}
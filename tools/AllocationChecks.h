@@ -0,0 +1,20 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// Real-time safety check: a long render on its own thread, as an audio driver runs the engine, then a
+// shorter one through NullBackend, with the allocator hooked so every allocation and free made on the
+// audio thread is counted.
+//   synth_render --alloc-check 60      exit code is non-zero when the render allocated or freed
+
+#ifndef ALLOCATIONCHECKS_H
+#define ALLOCATIONCHECKS_H
+#pragma once
+
+// Renders seconds of a patch using every voice feature (unison, sync, ring, FM, oversampling switches,
+// MPE expression, a looping MIDI player, voice stealing), then seconds / 10 (0.5 to 5) of it through
+// NullBackend with real-time scheduling requested; fails unless the audio threads made no allocation
+// and no free after prepare()
+bool checkAudioThreadAllocations(double seconds);
+
+#endif //ALLOCATIONCHECKS_H
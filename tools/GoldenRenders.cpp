@@ -0,0 +1,460 @@
+//
+// Created by pc on 19-10-26.
+//
+
+#include "GoldenRenders.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "../include/audio/AudioEngine.h"
+#include "../include/audio/Envelope.h"
+#include "../include/audio/Filter.h"
+#include "../include/audio/Lfo.h"
+#include "../include/audio/ModMatrix.h"
+#include "../include/audio/OfflineRenderer.h"
+#include "../include/audio/Oscillator.h"
+#include "../include/audio/SampleData.h"
+#include "../include/audio/VoiceKernels.h"
+
+namespace {
+
+constexpr int GOLDEN_SAMPLE_RATE = 44100;
+constexpr int GOLDEN_BLOCK = 64;
+constexpr int GOLDEN_FRAMES = 8192;
+
+struct GoldenCase {
+    const char* name;
+    std::function<std::vector<float>()> render;
+    // Another case whose file this one must match instead of having its own: two paths held to one render
+    const char* reference = nullptr;
+};
+
+// Runs a stage block by block like the engine does, so per-block state (phase, LFO) is exercised
+std::vector<float> renderBlocks(int frames, const std::function<void(float*, int, int)>& block) {
+    std::vector<float> output(frames * 2, 0.0f);
+    for (int frame = 0; frame < frames; frame += GOLDEN_BLOCK) {
+        int n = std::min(GOLDEN_BLOCK, frames - frame);
+        block(output.data() + frame * 2, n, frame);
+    }
+    return output;
+}
+
+std::vector<float> renderOscillator(WaveformType waveform, float frequency) {
+    Oscillator oscillator;
+    oscillator.prepare(GOLDEN_SAMPLE_RATE);
+    oscillator.setSeed(1);
+    return renderBlocks(GOLDEN_FRAMES, [&](float* out, int frames, int) {
+        oscillator.generateBuffer(out, frames, waveform, frequency);
+    });
+}
+
+// The voice's oscillator stage for every combination of off / triangle / saw, 512 frames each, through
+// the kernel compiled for it or the generic path (generateBuffer per oscillator, then a sum). With glide
+// the pitch sweeps three octaves and every block glides linearly across its part, as a modulated voice does.
+std::vector<float> renderOscillatorStage(bool kernel, bool glide) {
+    constexpr int COMBINATION_FRAMES = 512;
+    const float frequencies[3] = {220.0f, 331.5f, 467.3f};
+    std::vector<float> output;
+    std::vector<float> oscBuffer(GOLDEN_BLOCK * 2);
+    for (int combination = 1; combination < 27; ++combination) {
+        bool enabled[3];
+        WaveformType waveforms[3];
+        for (int i = 0, rest = combination; i < 3; ++i, rest /= 3) {
+            enabled[i] = rest % 3 != 0;
+            waveforms[i] = rest % 3 == 1 ? WaveformType::TRIANGLE : WaveformType::SAW;
+        }
+        Oscillator oscillators[3];
+        for (Oscillator& oscillator : oscillators) {
+            oscillator.prepare(GOLDEN_SAMPLE_RATE);
+        }
+        const VoiceKernel voiceKernel = findVoiceKernel(enabled, waveforms);
+
+        std::vector<float> part = renderBlocks(COMBINATION_FRAMES, [&](float* out, int frames, int start) {
+            auto frequency = [&](int i, int frame) {
+                return glide ? frequencies[i] * std::exp2(3.0f * frame / COMBINATION_FRAMES - 1.0f) : frequencies[i];
+            };
+            if (kernel) {
+                VoiceKernelState state;
+                for (int i = 0; i < 3; ++i) {
+                    state.phases[i] = oscillators[i].getPhase();
+                    state.increments[i] = frequency(i, start) / GOLDEN_SAMPLE_RATE;
+                    state.incrementSteps[i] =
+                        (frequency(i, start + frames) - frequency(i, start)) / GOLDEN_SAMPLE_RATE / frames;
+                }
+                voiceKernel(state, out, frames);
+                for (int i = 0; i < 3; ++i) {
+                    oscillators[i].setPhase(state.phases[i]);
+                }
+                return;
+            }
+            std::fill_n(out, frames * 2, 0.0f);
+            for (int i = 0; i < 3; ++i) {
+                if (!enabled[i]) {
+                    continue;
+                }
+                oscillators[i].generateBuffer(oscBuffer.data(), frames, waveforms[i], frequency(i, start),
+                                              frequency(i, start + frames));
+                for (int s = 0; s < frames * 2; ++s) {
+                    out[s] += oscBuffer[s];
+                }
+            }
+        });
+        output.insert(output.end(), part.begin(), part.end());
+    }
+    return output;
+}
+
+std::vector<float> renderEnvelope() {
+    Envelope envelope;
+    envelope.prepare(GOLDEN_SAMPLE_RATE);
+    envelope.setAttackTime(0.05f);
+    envelope.setReleaseTime(0.08f);
+    envelope.noteOn();
+    return renderBlocks(GOLDEN_FRAMES, [&](float* out, int frames, int start) {
+        if (start == GOLDEN_FRAMES / 2) {
+            envelope.noteOff();
+        }
+        std::fill(out, out + frames * 2, 1.0f);
+        envelope.processBuffer(out, frames);
+    });
+}
+
+std::vector<float> renderFilter(float autoAmount, float resonance) {
+    Oscillator source;
+    source.prepare(GOLDEN_SAMPLE_RATE);
+    source.setSeed(7);
+    Filter filter;
+    filter.prepare(GOLDEN_SAMPLE_RATE);
+    // A 3 Hz sine LFO at control rate, the cutoff gliding between its values
+    Lfo lfo;
+    LfoSettings sine{LfoShape::SINE, 3.0f, false};
+    return renderBlocks(GOLDEN_FRAMES, [&](float* out, int frames, int) {
+        source.generateBuffer(out, frames, WaveformType::NOISE, 0.0f);
+        for (int done = 0; done < frames; done += CONTROL_BLOCK_FRAMES) {
+            int span = std::min(CONTROL_BLOCK_FRAMES, frames - done);
+            float from = 1200.0f + lfo.getValue() * autoAmount * FILTER_LFO_DEPTH_HZ;
+            float to = 1200.0f + lfo.advance(sine, span, GOLDEN_SAMPLE_RATE) * autoAmount * FILTER_LFO_DEPTH_HZ;
+            filter.processBuffer(out + done * 2, span, from, to, resonance);
+        }
+    });
+}
+
+int processId() {
+#if defined(_WIN32)
+    return _getpid();
+#else
+    return static_cast<int>(getpid());
+#endif
+}
+
+// A generated stereo sample written to a temporary WAV, mapped back and played a fifth up. The file is
+// named after the process so parallel runs (ctest -j) do not overwrite each other's, and removed after.
+std::vector<float> renderSample() {
+    std::vector<float> source(GOLDEN_FRAMES * 2);
+    for (int i = 0; i < GOLDEN_FRAMES; ++i) {
+        float t = static_cast<float>(i) / GOLDEN_SAMPLE_RATE;
+        source[i * 2] = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 261.63f * t);
+        source[i * 2 + 1] = 0.25f * std::sin(2.0f * static_cast<float>(M_PI) * 523.25f * t);
+    }
+    const std::filesystem::path path = std::filesystem::temp_directory_path()
+        / ("synth_golden_sample_" + std::to_string(processId()) + ".wav");
+    writeWav(path.string(), source, GOLDEN_SAMPLE_RATE);
+    std::shared_ptr<SampleData> sample = SampleData::loadWav(path.string());
+
+    std::vector<float> output;
+    if (sample) {
+        Oscillator oscillator;
+        oscillator.prepare(GOLDEN_SAMPLE_RATE);
+        oscillator.setSample(sample.get());
+        output = renderBlocks(GOLDEN_FRAMES, [&](float* out, int frames, int) {
+            oscillator.generateBuffer(out, frames, WaveformType::SAMPLE, 392.0f);
+        });
+    }
+    // Unmapped first, Windows cannot remove a mapped file
+    sample.reset();
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    return output;
+}
+
+// A short phrase through the whole engine: three oscillators, one voice so the second note takes over the first
+std::vector<float> renderEngine(int oversampling) {
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->osc1_enabled.store(true);
+    params->osc2_enabled.store(true);
+    params->osc3_enabled.store(true);
+    params->attack_time.store(0.02f);
+    params->release_time.store(0.05f);
+    params->filter_cutoff.store(3000.0f);
+    params->filter_resonance.store(0.4f);
+    params->filter_auto_amount.store(0.3f);
+    params->oversampling.store(oversampling);
+    params->polyphony.store(1);
+
+    AudioEngine engine(params);
+    engine.prepare(GOLDEN_SAMPLE_RATE, GOLDEN_BLOCK);
+    engine.setNoiseSeed(3);
+
+    const int noteChange = GOLDEN_FRAMES / 4;
+    const int noteOff = GOLDEN_FRAMES * 5 / 8;
+    engine.noteOn(3, 0.8f);
+    return renderBlocks(GOLDEN_FRAMES, [&](float* out, int frames, int start) {
+        if (start == noteChange) {
+            engine.noteOn(10, 1.0f);
+        } else if (start == noteOff) {
+            engine.noteOff();
+        }
+        engine.processAudio(out, frames);
+    });
+}
+
+// Renders the engine, handing each block the events (frames counted from the start) that fall in it;
+// beforeBlock, when given, runs first with the block's start frame
+std::vector<float> renderEvents(AudioEngine& engine, const std::vector<MidiEvent>& events,
+                                const std::function<void(int)>& beforeBlock = {}) {
+    size_t next = 0;
+    std::vector<MidiEvent> block;
+    return renderBlocks(GOLDEN_FRAMES, [&](float* out, int frames, int start) {
+        if (beforeBlock) {
+            beforeBlock(start);
+        }
+        block.clear();
+        while (next < events.size() && events[next].frame < static_cast<uint32_t>(start + frames)) {
+            block.push_back(events[next++]);
+            block.back().frame -= start;
+        }
+        engine.processAudio(out, frames, block.data(), block.size());
+    });
+}
+
+// A chord on three voices, a fourth note stealing the oldest, then release of everything
+std::vector<float> renderPolyphony() {
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->osc1_enabled.store(true);
+    params->osc2_enabled.store(true);
+    params->attack_time.store(0.01f);
+    params->release_time.store(0.03f);
+    params->polyphony.store(3);
+
+    AudioEngine engine(params);
+    engine.prepare(GOLDEN_SAMPLE_RATE, GOLDEN_BLOCK);
+    engine.setNoiseSeed(5);
+
+    // Events land inside blocks, so this also covers sample-accurate splitting
+    return renderEvents(engine, {
+        {100, 3, {0x90, 60, 100}}, {700, 3, {0x90, 64, 90}}, {1301, 3, {0x90, 67, 80}},
+        {3000, 3, {0x90, 72, 127}}, {4500, 3, {0x80, 64, 0}}, {5000, 3, {0xB0, 123, 0}},
+    });
+}
+
+// Triangle and saws on the voice kernel path, their pitch gliding with LFO 1 through the matrix
+std::vector<float> renderKernelGlide() {
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->osc1_enabled.store(true);
+    params->osc2_enabled.store(true);
+    params->osc3_enabled.store(true);
+    params->osc1_waveform.store(static_cast<int>(WaveformType::TRIANGLE));
+    params->osc2_waveform.store(static_cast<int>(WaveformType::SAW));
+    params->osc2_freq_offset.store(7.0f);
+    params->osc3_waveform.store(static_cast<int>(WaveformType::SAW));
+    params->osc3_freq_offset.store(-12.0f);
+    params->attack_time.store(0.005f);
+    params->release_time.store(0.03f);
+    params->lfo1_rate.store(6.0f);
+    params->mod_source[0].store(static_cast<int>(ModSource::LFO1));
+    params->mod_destination[0].store(static_cast<int>(ModDestination::PITCH));
+    params->mod_amount[0].store(2.0f);
+    params->polyphony.store(2);
+
+    AudioEngine engine(params);
+    engine.prepare(GOLDEN_SAMPLE_RATE, GOLDEN_BLOCK);
+    engine.setNoiseSeed(9);
+
+    return renderEvents(engine, {
+        {50, 3, {0x90, 57, 100}}, {2100, 3, {0x90, 64, 90}}, {5000, 3, {0x80, 57, 0}}, {6000, 3, {0xB0, 123, 0}},
+    });
+}
+
+// Unison on the sync and ring source and on a ring-modulated oscillator, beside a synced one
+std::vector<float> renderUnisonSync() {
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->osc1_enabled.store(true);
+    params->osc2_enabled.store(true);
+    params->osc3_enabled.store(true);
+    params->osc1_waveform.store(static_cast<int>(WaveformType::SAW));
+    params->osc1_unison.store(7);
+    params->osc1_unison_detune.store(0.3f);
+    params->osc1_unison_spread.store(0.8f);
+    params->osc2_waveform.store(static_cast<int>(WaveformType::SAW));
+    params->osc2_freq_offset.store(7.0f);
+    params->osc2_sync.store(true);
+    params->osc3_waveform.store(static_cast<int>(WaveformType::TRIANGLE));
+    params->osc3_freq_offset.store(12.0f);
+    params->osc3_unison.store(5);
+    params->osc3_unison_detune.store(0.2f);
+    params->osc3_ring.store(true);
+    params->attack_time.store(0.005f);
+    params->release_time.store(0.03f);
+    params->polyphony.store(2);
+
+    AudioEngine engine(params);
+    engine.prepare(GOLDEN_SAMPLE_RATE, GOLDEN_BLOCK);
+    engine.setNoiseSeed(11);
+
+    return renderEvents(engine, {
+        {30, 3, {0x90, 52, 100}}, {3000, 3, {0x90, 59, 90}}, {5500, 3, {0x80, 52, 0}}, {6500, 3, {0xB0, 123, 0}},
+    });
+}
+
+// MPE notes with bend, pressure and timbre in the same blocks as their note events, before and after
+// them. The filter LFO comes in halfway, so both of renderBlock's paths apply the queued expression.
+std::vector<float> renderExpression() {
+    auto params = std::make_shared<SynthetizerConfig>();
+    params->osc1_enabled.store(true);
+    params->osc2_enabled.store(true);
+    params->osc2_waveform.store(static_cast<int>(WaveformType::TRIANGLE));
+    params->attack_time.store(0.005f);
+    params->release_time.store(0.03f);
+    params->filter_cutoff.store(1500.0f);
+    params->filter_resonance.store(0.5f);
+    params->bend_range.store(12.0f);
+    params->pressure_to_cutoff.store(1.0f);
+    params->timbre_to_cutoff.store(1.0f);
+    params->polyphony.store(4);
+
+    AudioEngine engine(params);
+    engine.prepare(GOLDEN_SAMPLE_RATE, GOLDEN_BLOCK);
+    engine.setNoiseSeed(7);
+
+    std::vector<MidiEvent> events = {
+        // Note, then its bend and pressure later in the same block
+        {100, 3, {0x91, 60, 100}}, {110, 3, {0xE1, 0x00, 0x50}}, {120, 2, {0xD1, 90, 0}},
+        // Pressure and timbre on a channel, then a note on it in the same block that starts with them
+        {1000, 2, {0xD2, 40, 0}}, {1001, 3, {0xB2, 74, 100}}, {1020, 3, {0x92, 67, 80}},
+    };
+    // A bend sweep on both channels, not on the control grid, with a note in the middle of it
+    for (uint32_t frame = 1500; frame < 6000; frame += 37) {
+        const int bend = 8192 + static_cast<int>((frame % 1000) * 6) - 3000;
+        const uint8_t status = frame % 2 ? 0xE1 : 0xE2;
+        events.push_back({frame, 3, {status, static_cast<uint8_t>(bend & 0x7F), static_cast<uint8_t>(bend >> 7)}});
+        if (frame == 3537) {
+            events.push_back({frame + 5, 3, {0x91, 64, 70}});
+        }
+    }
+    events.push_back({6500, 3, {0xB0, 123, 0}});
+
+    return renderEvents(engine, events, [&](int start) {
+        params->filter_auto_amount.store(start >= GOLDEN_FRAMES / 2 ? 0.4f : 0.0f);
+    });
+}
+
+const std::vector<GoldenCase>& goldenCases() {
+    static const std::vector<GoldenCase> cases = {
+        {"osc_triangle", [] { return renderOscillator(WaveformType::TRIANGLE, 440.0f); }},
+        {"osc_saw", [] { return renderOscillator(WaveformType::SAW, 1234.5f); }},
+        {"osc_noise", [] { return renderOscillator(WaveformType::NOISE, 0.0f); }},
+        {"osc_sample", [] { return renderSample(); }},
+        {"envelope", [] { return renderEnvelope(); }},
+        {"filter_static", [] { return renderFilter(0.0f, 0.7f); }},
+        {"filter_lfo", [] { return renderFilter(0.5f, 0.3f); }},
+        {"engine_1x", [] { return renderEngine(1); }},
+        {"engine_4x", [] { return renderEngine(4); }},
+        {"engine_poly", [] { return renderPolyphony(); }},
+        {"engine_expression", [] { return renderExpression(); }},
+        {"engine_kernel_glide", [] { return renderKernelGlide(); }},
+        {"engine_unison_sync", [] { return renderUnisonSync(); }},
+        {"voice_kernels", [] { return renderOscillatorStage(true, false); }},
+        {"voice_generic", [] { return renderOscillatorStage(false, false); }, "voice_kernels"},
+        {"voice_kernels_glide", [] { return renderOscillatorStage(true, true); }},
+        {"voice_generic_glide", [] { return renderOscillatorStage(false, true); }, "voice_kernels_glide"},
+    };
+    return cases;
+}
+
+// Distance between two floats counted in representable values, 0 for identical bits
+uint32_t ulpDistance(float a, float b) {
+    auto ordered = [](float value) {
+        int32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        // Negative floats are stored as sign + magnitude, fold them below zero
+        return bits < 0 ? static_cast<int64_t>(INT32_MIN) - bits : static_cast<int64_t>(bits);
+    };
+    int64_t distance = ordered(a) - ordered(b);
+    return static_cast<uint32_t>(std::min<int64_t>(std::abs(distance), UINT32_MAX));
+}
+
+std::string goldenPath(const std::string& dir, const GoldenCase& goldenCase) {
+    return dir + "/" + (goldenCase.reference ? goldenCase.reference : goldenCase.name) + ".wav";
+}
+
+}
+
+bool writeGoldenRenders(const std::string& dir) {
+    bool ok = true;
+    for (const GoldenCase& goldenCase : goldenCases()) {
+        if (goldenCase.reference) {
+            continue;
+        }
+        ok = writeWav(goldenPath(dir, goldenCase), goldenCase.render(), GOLDEN_SAMPLE_RATE) && ok;
+        std::cout << "wrote " << goldenPath(dir, goldenCase) << std::endl;
+    }
+    return ok;
+}
+
+bool checkGoldenRenders(const std::string& dir, uint32_t maxUlps) {
+    int failed = 0;
+    for (const GoldenCase& goldenCase : goldenCases()) {
+        std::vector<float> expected;
+        int sampleRate = 0;
+        if (!readWav(goldenPath(dir, goldenCase), expected, sampleRate)) {
+            ++failed;
+            continue;
+        }
+        std::vector<float> actual = goldenCase.render();
+
+        uint32_t worst = 0;
+        size_t worstIndex = 0;
+        size_t mismatches = 0;
+        const size_t common = std::min(expected.size(), actual.size());
+        for (size_t i = 0; i < common; ++i) {
+            uint32_t distance = ulpDistance(expected[i], actual[i]);
+            if (distance > maxUlps) {
+                ++mismatches;
+            }
+            if (distance > worst) {
+                worst = distance;
+                worstIndex = i;
+            }
+        }
+
+        bool pass = mismatches == 0 && expected.size() == actual.size() && sampleRate == GOLDEN_SAMPLE_RATE;
+        std::cout << (pass ? "PASS " : "FAIL ") << goldenCase.name;
+        if (expected.size() != actual.size() || sampleRate != GOLDEN_SAMPLE_RATE) {
+            std::cout << ": golden has " << expected.size() / 2 << " frames at " << sampleRate
+                      << " Hz, render has " << actual.size() / 2 << " at " << GOLDEN_SAMPLE_RATE;
+        } else if (worst > 0) {
+            std::cout << ": " << mismatches << " samples over " << maxUlps << " ulp, worst " << worst
+                      << " ulp at frame " << worstIndex / 2 << " (" << expected[worstIndex] << " vs "
+                      << actual[worstIndex] << ")";
+        }
+        std::cout << std::endl;
+        failed += pass ? 0 : 1;
+    }
+    std::cout << goldenCases().size() - failed << "/" << goldenCases().size() << " golden renders match" << std::endl;
+    return failed == 0;
+}
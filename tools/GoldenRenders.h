@@ -0,0 +1,25 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// Golden renders: fixed, seeded renders of each DSP stage compared against stored WAV files,
+// so a change that alters the output (an optimization, a refactor) shows up as a failing case.
+//   synth_render --golden-write golden      regenerate after an intended change of sound
+//   synth_render --golden-check golden      exit code is non-zero when any case differs
+
+#ifndef GOLDENRENDERS_H
+#define GOLDENRENDERS_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Writes every case to <dir>/<case>.wav, except the cases held to another case's file (the generic
+// oscillator path to the voice kernels' render), which are only checked
+bool writeGoldenRenders(const std::string& dir);
+// Renders every case again and compares it with <dir>/<case>.wav. Samples may differ by at most
+// maxUlps units in the last place (0 = bit-exact), which absorbs libm and FMA differences between
+// hosts while still catching any real change.
+bool checkGoldenRenders(const std::string& dir, uint32_t maxUlps);
+
+#endif //GOLDENRENDERS_H
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs the JACK backend against a private dummy JACK server and changes its period while it plays:
+# up past JACK_PREPARED_PERIOD (the output buffer regrows, the process thread outputs silence meanwhile)
+# and back down. Fails when synth crashes or exits with an error.
+#   tools/jack_dummy_test.sh <synth> <jackd> <jack_bufsize>
+set -u
+
+SYNTH=$1
+JACKD=$2
+JACK_BUFSIZE=$3
+
+# Own server name per run, so parallel ctest runs and a running desktop server are left alone
+JACK_DEFAULT_SERVER="synth_test_$$"
+export JACK_DEFAULT_SERVER
+
+"$JACKD" -n "$JACK_DEFAULT_SERVER" -d dummy -r 48000 -p 64 >/dev/null 2>&1 &
+JACKD_PID=$!
+trap 'kill "$JACKD_PID" 2>/dev/null; wait "$JACKD_PID" 2>/dev/null' EXIT
+sleep 1
+
+"$SYNTH" --backend jack --headless 4 &
+SYNTH_PID=$!
+sleep 1
+"$JACK_BUFSIZE" 8192 || exit 1
+sleep 1
+"$JACK_BUFSIZE" 128 || exit 1
+
+wait "$SYNTH_PID"
@@ -0,0 +1,144 @@
+//
+// Created by pc on 19-10-26.
+//
+
+// Offline renderer: renders batches of (patch, note, velocity) to WAV files without an audio device.
+//   synth_render --batch jobs.txt --out renders [--threads N] [--sample-rate R] [--buffer-size B]
+//   synth_render --midi song.mid --out song.wav [--patch p.txt] [--polyphony N] [--sample-rate R] [--buffer-size B]
+//   synth_render --golden-check golden [--ulp N]  |  --golden-write golden
+//   synth_render --alias-check <max dB>
+//   synth_render --alloc-check <seconds>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../include/audio/BatchRenderer.h"
+#include "../include/audio/Patch.h"
+#include "AliasChecks.h"
+#include "AllocationChecks.h"
+#include "GoldenRenders.h"
+
+// Renders a MIDI file to one WAV, e.g. to load-test the engine with real repertoire
+static int renderMidi(const std::string& midiPath, const std::string& patchPath, int polyphony,
+                      const RenderFormat& format, const std::string& outputPath) {
+    std::vector<MidiFileEvent> events;
+    MidiFileInfo info;
+    if (!loadMidiFile(midiPath, events, &info)) {
+        return EXIT_FAILURE;
+    }
+    SynthetizerConfig patch;
+    patch.osc1_enabled = true;
+    if (!patchPath.empty() && !loadPatch(patchPath, patch)) {
+        return EXIT_FAILURE;
+    }
+    if (polyphony > 0) {
+        patch.polyphony = polyphony;
+    }
+    std::cout << midiPath << ": format " << info.format << ", " << info.tracks << " tracks, " << info.notes
+              << " notes, " << info.seconds << " s, up to " << info.maxPolyphony << " notes at once" << std::endl;
+
+    MidiRenderStats stats;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<float> audio = renderMidiFile(patch, events, format, 1.0, &stats);
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double audioSeconds = audio.size() / 2.0 / format.sampleRate;
+
+    std::cout << audioSeconds << " s of audio in " << wallSeconds << " s, " << audioSeconds / wallSeconds
+              << " audio-seconds per wall-second; peak " << stats.peakVoices << " of " << patch.polyphony.load()
+              << " voices, " << stats.voiceSteals << " steals" << std::endl;
+    return writeWav(outputPath, audio, format.sampleRate) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int usage() {
+    std::cerr << "usage: synth_render --batch <jobs.txt> --out <dir> [--threads N] "
+                 "[--sample-rate R] [--buffer-size B]\n"
+                 "       synth_render --midi <song.mid> --out <file.wav> [--patch <file>] [--polyphony N] "
+                 "[--sample-rate R] [--buffer-size B]\n"
+                 "       synth_render --golden-check <dir> [--ulp N] | --golden-write <dir>\n"
+                 "       synth_render --alias-check <max dB>\n"
+                 "       synth_render --alloc-check <seconds>" << std::endl;
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+    std::string jobFile;
+    // Directory of the batch renders, or the WAV file of a MIDI render
+    std::string output;
+    int threads = 0;
+    RenderFormat format;
+    std::string goldenCheckDir;
+    std::string goldenWriteDir;
+    uint32_t maxUlps = 0;
+    std::string midiPath;
+    std::string patchPath;
+    int polyphony = 0;
+    bool aliasCheck = false;
+    double maxAliasDb = 0.0;
+    double allocCheckSeconds = 0.0;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--batch") {
+            jobFile = argv[i + 1];
+        } else if (arg == "--out") {
+            output = argv[i + 1];
+        } else if (arg == "--threads") {
+            threads = std::stoi(argv[i + 1]);
+        } else if (arg == "--sample-rate") {
+            format.sampleRate = std::stoi(argv[i + 1]);
+        } else if (arg == "--buffer-size") {
+            format.blockSize = std::stoi(argv[i + 1]);
+        } else if (arg == "--golden-check") {
+            goldenCheckDir = argv[i + 1];
+        } else if (arg == "--golden-write") {
+            goldenWriteDir = argv[i + 1];
+        } else if (arg == "--midi") {
+            midiPath = argv[i + 1];
+        } else if (arg == "--patch") {
+            patchPath = argv[i + 1];
+        } else if (arg == "--polyphony") {
+            polyphony = std::stoi(argv[i + 1]);
+        } else if (arg == "--alias-check") {
+            aliasCheck = true;
+            maxAliasDb = std::stod(argv[i + 1]);
+        } else if (arg == "--alloc-check") {
+            allocCheckSeconds = std::stod(argv[i + 1]);
+        } else if (arg == "--ulp") {
+            maxUlps = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+        } else {
+            return usage();
+        }
+    }
+    if (!goldenWriteDir.empty()) {
+        return writeGoldenRenders(goldenWriteDir) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (!goldenCheckDir.empty()) {
+        return checkGoldenRenders(goldenCheckDir, maxUlps) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (aliasCheck) {
+        return checkAliasing(maxAliasDb) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (allocCheckSeconds > 0.0) {
+        return checkAudioThreadAllocations(allocCheckSeconds) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (!midiPath.empty()) {
+        if (format.sampleRate <= 0 || format.blockSize <= 0) {
+            return usage();
+        }
+        return renderMidi(midiPath, patchPath, polyphony, format, output.empty() ? "render.wav" : output);
+    }
+    if (jobFile.empty() || format.sampleRate <= 0 || format.blockSize <= 0) {
+        return usage();
+    }
+
+    const std::string outputDir = output.empty() ? "renders" : output;
+    std::vector<BatchJob> jobs = loadBatchJobs(jobFile, outputDir);
+    std::vector<BatchResult> results;
+    BatchReport report = runBatch(jobs, format, threads, outputDir, results);
+
+    std::cout << report.jobs << " renders (" << report.failed << " failed) on " << report.threads
+              << " threads: " << report.audioSeconds << " s of audio in " << report.wallSeconds << " s, "
+              << report.audioSeconds / report.wallSeconds << " audio-seconds per wall-second" << std::endl;
+    return report.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}